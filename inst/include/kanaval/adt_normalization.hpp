@@ -3,6 +3,8 @@
 
 #include "H5Cpp.h"
 #include "utils.hpp"
+#include "streaming.hpp"
+#include <limits>
 
 /**
  * @file adt_normalization.hpp
@@ -36,7 +38,18 @@ inline void validate_parameters(const H5::Group& handle) {
 inline void validate_results(const H5::Group& handle, size_t num_cells, bool adt_in_use) {
     auto rhandle = utils::check_and_open_group(handle, "results");
     if (adt_in_use) {
-        utils::check_and_open_dataset(rhandle, "size_factors", H5T_FLOAT, { num_cells });
+        auto shandle = utils::check_and_open_dataset(rhandle, "size_factors", H5T_FLOAT, { num_cells });
+
+        const double max_factor = std::numeric_limits<double>::max();
+        streaming::for_each_block<double>(shandle, 65536, [&](hsize_t, hsize_t len, const double* ptr) -> void {
+            int bad = 0;
+            for (hsize_t i = 0; i < len; ++i) {
+                bad |= !((ptr[i] > 0) & (ptr[i] <= max_factor)); // also catches NaNs.
+            }
+            if (bad) {
+                throw std::runtime_error("'size_factors' should contain positive and finite values");
+            }
+        });
     }
     return;
 }
@@ -60,6 +73,7 @@ inline void validate_results(const H5::Group& handle, size_t num_cells, bool adt
  * If `adt_in_use = true`, `results` should contain:
  *
  * - `size_factors`, a float dataset of length equal to the number of cells, containing the size factor for each cell.
+ *   Values should be positive and finite.
  *
  * <HR>
  * @param handle An open HDF5 file handle.
@@ -0,0 +1,328 @@
+#ifndef KANAVAL_ANIMATION_HPP
+#define KANAVAL_ANIMATION_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "utils.hpp"
+#include "streaming.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @file animation.hpp
+ *
+ * @brief Store, validate and replay the intermediate frames of a t-SNE or UMAP animation.
+ */
+
+namespace kanaval {
+
+namespace animation {
+
+/**
+ * Add quantized deltas to the coordinates of the previous frame.
+ * This uses SSE2 instructions where available, as decoding is dominated by the conversion of the deltas to floating-point.
+ *
+ * @param delta Pointer to an array of `n` quantized deltas.
+ * @param n Number of cells.
+ * @param scale Scaling factor to convert the deltas to coordinates.
+ * @param[in,out] values Pointer to an array of `n` coordinates from the previous frame.
+ * On output, this contains the coordinates of the current frame.
+ */
+inline void accumulate(const int16_t* delta, size_t n, double scale, double* values) {
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128d s = _mm_set1_pd(scale);
+    for (; i + 8 <= n; i += 8) {
+        __m128i d16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(delta + i));
+
+        // Sign-extending each half of the 16-bit values to 32 bits, then converting pairs to doubles.
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(d16, d16), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(d16, d16), 16);
+        __m128d d0 = _mm_cvtepi32_pd(lo);
+        __m128d d1 = _mm_cvtepi32_pd(_mm_shuffle_epi32(lo, 0x4E));
+        __m128d d2 = _mm_cvtepi32_pd(hi);
+        __m128d d3 = _mm_cvtepi32_pd(_mm_shuffle_epi32(hi, 0x4E));
+
+        _mm_storeu_pd(values + i,     _mm_add_pd(_mm_loadu_pd(values + i),     _mm_mul_pd(d0, s)));
+        _mm_storeu_pd(values + i + 2, _mm_add_pd(_mm_loadu_pd(values + i + 2), _mm_mul_pd(d1, s)));
+        _mm_storeu_pd(values + i + 4, _mm_add_pd(_mm_loadu_pd(values + i + 4), _mm_mul_pd(d2, s)));
+        _mm_storeu_pd(values + i + 6, _mm_add_pd(_mm_loadu_pd(values + i + 6), _mm_mul_pd(d3, s)));
+    }
+#endif
+    for (; i < n; ++i) {
+        values[i] += static_cast<double>(delta[i]) * scale;
+    }
+}
+
+/**
+ * @cond
+ */
+inline double quantize(const double* target, size_t n, const double* previous, int16_t* delta) {
+    double maxabs = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!std::isfinite(target[i])) {
+            throw std::runtime_error("animation coordinates should be finite");
+        }
+        maxabs = std::max(maxabs, std::abs(target[i] - previous[i]));
+    }
+
+    if (maxabs == 0) {
+        std::fill(delta, delta + n, 0);
+        return 0;
+    }
+
+    double scale = maxabs / 32767;
+    for (size_t i = 0; i < n; ++i) {
+        double q = std::round((target[i] - previous[i]) / scale);
+        delta[i] = static_cast<int16_t>(std::max(-32767.0, std::min(32767.0, q)));
+    }
+    return scale;
+}
+/**
+ * @endcond
+ */
+
+/**
+ * @brief Append the intermediate frames of an animation to the results of the `tsne` or `umap` step.
+ *
+ * Each frame is stored as the difference from the previous frame (or from zero, for the first frame), quantized to 16-bit integers with a per-frame scaling factor for each axis.
+ * Differences are computed from the decoded coordinates of the previous frame rather than its original coordinates,
+ * so quantization errors do not accumulate across frames and each decoded coordinate is within half a quantization step of its original value.
+ * As the embedding converges, consecutive frames become similar and the deltas are small, so they compress well.
+ *
+ * Frames are appended as they are produced, so the full animation never needs to be held in memory.
+ */
+class Writer {
+public:
+    /**
+     * @param results Handle to the `results` group of the `tsne` or `umap` step.
+     * @param num_cells Number of cells in the embedding.
+     * This should be positive; the `animation` group is optional, so callers should skip it for an empty embedding.
+     * @param compression Deflate compression level.
+     */
+    Writer(const H5::Group& results, hsize_t num_cells, int compression = 6) :
+        handle(create_group(results, num_cells)),
+        iterations(streaming::RowWriter::append(handle, "iterations", H5::PredType::NATIVE_INT32, 0, compression)),
+        scale(streaming::RowWriter::append(handle, "scale", H5::PredType::NATIVE_DOUBLE, 2, compression)),
+        x(streaming::RowWriter::append(handle, "x", H5::PredType::NATIVE_INT16, num_cells, compression, 1)),
+        y(streaming::RowWriter::append(handle, "y", H5::PredType::NATIVE_INT16, num_cells, compression, 1)),
+        num_cells(num_cells),
+        current_x(num_cells),
+        current_y(num_cells),
+        delta(num_cells)
+    {}
+
+    /**
+     * Append a frame to the animation.
+     *
+     * @param iteration Iteration (or epoch) at which the frame was captured.
+     * This should be positive and greater than that of the previous frame.
+     * @param xptr Pointer to an array of length equal to the number of cells, containing the x-coordinates of the frame.
+     * @param yptr Pointer to an array of length equal to the number of cells, containing the y-coordinates of the frame.
+     */
+    void add(int iteration, const double* xptr, const double* yptr) {
+        if (iteration <= last_iteration) {
+            throw std::runtime_error("animation iterations should be positive and increasing");
+        }
+        last_iteration = iteration;
+        iterations.write(&iteration, 1);
+
+        double scales[2];
+        scales[0] = quantize(xptr, num_cells, current_x.data(), delta.data());
+        x.write(delta.data(), 1);
+        accumulate(delta.data(), num_cells, scales[0], current_x.data());
+
+        scales[1] = quantize(yptr, num_cells, current_y.data(), delta.data());
+        y.write(delta.data(), 1);
+        accumulate(delta.data(), num_cells, scales[1], current_y.data());
+
+        scale.write(scales, 1);
+    }
+
+    /**
+     * @return Number of frames added so far.
+     */
+    hsize_t num_frames() const {
+        return iterations.filled();
+    }
+
+    /**
+     * Check that all datasets contain the same number of frames.
+     * This should be called after the last frame has been added.
+     */
+    void finalize() const {
+        hsize_t nframes = iterations.filled();
+        iterations.finalize(nframes);
+        scale.finalize(nframes);
+        x.finalize(nframes);
+        y.finalize(nframes);
+    }
+
+private:
+    static H5::Group create_group(const H5::Group& results, hsize_t num_cells) {
+        // Otherwise, the row writers would create 1-dimensional datasets for 'x' and 'y'.
+        if (num_cells == 0) {
+            throw std::runtime_error("animation should contain at least one cell");
+        }
+        return results.createGroup("animation");
+    }
+
+    H5::Group handle;
+    streaming::RowWriter iterations, scale, x, y;
+    hsize_t num_cells;
+    int last_iteration = 0;
+    std::vector<double> current_x, current_y;
+    std::vector<int16_t> delta;
+};
+
+/**
+ * @brief Decode the frames of an animation in order, without loading the full animation into memory.
+ *
+ * Only the deltas for the current frame and the decoded coordinates are held in memory at any time.
+ */
+class Reader {
+public:
+    /**
+     * @param results Handle to the `results` group of the `tsne` or `umap` step, containing an `animation` group.
+     */
+    Reader(const H5::Group& results) {
+        auto handle = utils::check_and_open_group(results, "animation");
+        iterations = utils::load_integer_vector(handle, "iterations");
+
+        auto shandle = utils::check_and_open_dataset(handle, "scale", H5T_FLOAT, { iterations.size(), 2 });
+        scales.resize(iterations.size() * 2);
+        if (!scales.empty()) {
+            shandle.read(scales.data(), H5::PredType::NATIVE_DOUBLE);
+        }
+
+        xhandle = utils::check_and_open_dataset(handle, "x", H5T_INTEGER);
+        yhandle = utils::check_and_open_dataset(handle, "y", H5T_INTEGER);
+        auto dims = utils::get_dimensions(xhandle);
+        if (dims.size() != 2 || dims[0] != iterations.size() || utils::get_dimensions(yhandle) != dims) {
+            throw std::runtime_error("'x' and 'y' should be 2-dimensional datasets with one row per frame");
+        }
+
+        num_cells = dims[1];
+        current_x.resize(num_cells);
+        current_y.resize(num_cells);
+        delta.resize(num_cells);
+    }
+
+    /**
+     * @return Number of frames in the animation.
+     */
+    hsize_t num_frames() const {
+        return iterations.size();
+    }
+
+    /**
+     * @return Number of cells in each frame.
+     */
+    hsize_t size() const {
+        return num_cells;
+    }
+
+    /**
+     * Decode the next frame.
+     *
+     * @param[out] xptr Pointer to an array of length equal to the number of cells.
+     * On output, this contains the x-coordinates of the next frame.
+     * @param[out] yptr Pointer to an array of length equal to the number of cells.
+     * On output, this contains the y-coordinates of the next frame.
+     *
+     * @return Iteration at which the next frame was captured, or -1 if all frames have already been decoded (in which case `xptr` and `yptr` are not modified).
+     */
+    int next(double* xptr, double* yptr) {
+        if (position == iterations.size()) {
+            return -1;
+        }
+
+        streaming::read_block(xhandle, position, 1, num_cells, delta.data());
+        accumulate(delta.data(), num_cells, scales[2 * position], current_x.data());
+        streaming::read_block(yhandle, position, 1, num_cells, delta.data());
+        accumulate(delta.data(), num_cells, scales[2 * position + 1], current_y.data());
+
+        std::copy(current_x.begin(), current_x.end(), xptr);
+        std::copy(current_y.begin(), current_y.end(), yptr);
+        return iterations[position++];
+    }
+
+private:
+    std::vector<int> iterations;
+    std::vector<double> scales;
+    H5::DataSet xhandle, yhandle;
+    hsize_t num_cells = 0;
+    hsize_t position = 0;
+    std::vector<double> current_x, current_y;
+    std::vector<int16_t> delta;
+};
+
+/**
+ * Check the optional `animation` group in the results of the `tsne` or `umap` step.
+ * If present, `animation` should contain:
+ *
+ * - `iterations`: an integer dataset of length equal to the number of frames, containing the iteration (or epoch) at which each frame was captured.
+ *   Values should be positive, strictly increasing and no greater than the total number of iterations.
+ * - `scale`: a float dataset with one row per frame and 2 columns, containing the non-negative scaling factors for the x- and y-deltas, respectively.
+ * - `x`: a 16-bit integer dataset with one row per frame and one column per cell, containing the quantized differences in the x-coordinates from the previous frame.
+ *   For the first frame, the differences are taken from zero.
+ * - `y`: same as `x` for the y-coordinates.
+ *
+ * The coordinates for each frame are defined by adding the product of `x` (or `y`) and the corresponding `scale` to the coordinates of the previous frame.
+ * See `Writer` and `Reader` for details.
+ *
+ * @param results Handle to the `results` group.
+ * @param num_cells Number of cells in the dataset after any quality filtering is applied.
+ * @param max_iterations Total number of iterations (or epochs) of the embedding.
+ *
+ * @return If the format is invalid, an error is raised.
+ */
+inline void validate(const H5::Group& results, int num_cells, int max_iterations) {
+    if (!results.exists("animation")) {
+        return;
+    }
+    auto handle = utils::check_and_open_group(results, "animation");
+
+    auto iterations = utils::load_integer_vector(handle, "iterations");
+    int last = 0;
+    for (auto i : iterations) {
+        if (i <= last) {
+            throw std::runtime_error("'iterations' should contain positive and strictly increasing values");
+        }
+        if (i > max_iterations) {
+            throw std::runtime_error("'iterations' should not be greater than the total number of iterations");
+        }
+        last = i;
+    }
+
+    size_t nframes = iterations.size();
+    auto shandle = utils::check_and_open_dataset(handle, "scale", H5T_FLOAT, { nframes, 2 });
+    std::vector<double> scales(nframes * 2);
+    if (nframes) {
+        shandle.read(scales.data(), H5::PredType::NATIVE_DOUBLE);
+    }
+    for (auto s : scales) {
+        if (!std::isfinite(s) || s < 0) {
+            throw std::runtime_error("'scale' should contain non-negative finite values");
+        }
+    }
+
+    for (std::string axis : { "x", "y" }) {
+        auto dhandle = utils::check_and_open_dataset(handle, axis, H5T_INTEGER, { nframes, static_cast<size_t>(num_cells) });
+        if (dhandle.getDataType().getSize() > 2) {
+            throw std::runtime_error("'" + axis + "' should contain 16-bit integers");
+        }
+    }
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,449 @@
+#ifndef KANAVAL_ANNOTATIONS_HPP
+#define KANAVAL_ANNOTATIONS_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include "utils.hpp"
+#include "write_utils.hpp"
+#include "embedded.hpp"
+#include "interning.hpp"
+
+/**
+ * @file annotations.hpp
+ *
+ * @brief Parse per-cell annotation files into typed columns.
+ */
+
+namespace kanaval {
+
+namespace annotations {
+
+/**
+ * @brief A column of per-cell annotations.
+ *
+ * Numeric columns are stored as doubles where missing values are represented by NaNs.
+ * All other columns are dictionary-encoded, i.e., stored as integer codes into a vector of unique levels, where missing values are represented by -1.
+ */
+struct Column {
+    /**
+     * Name of the column.
+     */
+    std::string name;
+
+    /**
+     * Whether the column is numeric.
+     */
+    bool numeric = false;
+
+    /**
+     * Values of a numeric column.
+     * Empty for categorical columns.
+     */
+    std::vector<double> numbers;
+
+    /**
+     * Codes of a categorical column, indexing into `levels`.
+     * Empty for numeric columns.
+     */
+    std::vector<int> codes;
+
+    /**
+     * Unique levels of a categorical column, in order of their first appearance.
+     */
+    std::vector<std::string> levels;
+};
+
+/**
+ * @brief Per-cell annotations.
+ */
+struct Table {
+    /**
+     * Number of rows, i.e., cells.
+     */
+    size_t num_rows = 0;
+
+    /**
+     * Annotation columns.
+     */
+    std::vector<Column> columns;
+};
+
+/**
+ * @brief Options for `parse()`.
+ */
+struct ParseOptions {
+    /**
+     * Number of threads to use.
+     */
+    int num_threads = 1;
+
+    /**
+     * Field delimiter.
+     */
+    char delimiter = '\t';
+};
+
+/**
+ * @cond
+ */
+inline bool is_missing(std::string_view field) {
+    return field.empty() || field == "NA";
+}
+
+inline bool parse_number(std::string_view field, double& output) {
+    if (field.size() >= 64) {
+        return false;
+    }
+    char buffer[64];
+    std::copy(field.begin(), field.end(), buffer);
+    buffer[field.size()] = '\0';
+    char* end;
+    output = std::strtod(buffer, &end);
+    return end == buffer + field.size();
+}
+
+inline std::string_view strip(std::string_view field) {
+    if (!field.empty() && field.back() == '\r') {
+        field.remove_suffix(1);
+    }
+    if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+        field = field.substr(1, field.size() - 2);
+    }
+    return field;
+}
+
+inline std::vector<std::string_view> split_line(std::string_view line, char delim) {
+    std::vector<std::string_view> fields;
+    size_t pos = 0;
+    while (true) {
+        size_t next = line.find(delim, pos);
+        if (next == std::string_view::npos) {
+            fields.push_back(strip(line.substr(pos)));
+            break;
+        }
+        fields.push_back(strip(line.substr(pos, next - pos)));
+        pos = next + 1;
+    }
+    return fields;
+}
+
+struct Chunk {
+    size_t start = 0, end = 0;
+    size_t num_rows = 0;
+    std::vector<std::vector<std::string_view> > fields; // column-major.
+    std::vector<unsigned char> numeric;
+    std::string error;
+};
+
+inline void tokenize(std::string_view contents, Chunk& chunk, size_t ncols, char delim) {
+    chunk.fields.resize(ncols);
+    chunk.numeric.assign(ncols, 1);
+    size_t pos = chunk.start;
+    double dummy;
+
+    while (pos < chunk.end) {
+        size_t next = contents.find('\n', pos);
+        if (next == std::string_view::npos || next > chunk.end) {
+            next = chunk.end;
+        }
+
+        auto line = contents.substr(pos, next - pos);
+        pos = next + 1;
+        if (line.empty() || line == "\r") {
+            continue;
+        }
+
+        auto fields = split_line(line, delim);
+        if (fields.size() != ncols) {
+            chunk.error = "number of fields in line '" + std::string(line) + "' is not equal to the number of columns";
+            return;
+        }
+
+        for (size_t c = 0; c < ncols; ++c) {
+            chunk.fields[c].push_back(fields[c]);
+            if (chunk.numeric[c] && !is_missing(fields[c]) && !parse_number(fields[c], dummy)) {
+                chunk.numeric[c] = 0;
+            }
+        }
+        ++chunk.num_rows;
+    }
+}
+
+template<class Function>
+void run_parallel(size_t njobs, Function fun) {
+    if (njobs == 1) {
+        fun(0);
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(njobs);
+    for (size_t j = 0; j < njobs; ++j) {
+        workers.emplace_back(fun, j);
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Parse the contents of a per-cell annotation file, i.e., the `annotations` file for `"MatrixMarket"` inputs (see `inputs::validate()`).
+ * The first line is treated as the header containing the column names, and each subsequent non-empty line corresponds to a cell.
+ *
+ * The body is split into contiguous ranges of lines that are tokenized in parallel.
+ * A column is considered to be numeric if all of its non-missing values (i.e., not empty or `NA`) can be parsed as numbers; otherwise it is dictionary-encoded.
+ * Each thread builds a dictionary for its range of lines, and the dictionaries are merged such that levels are ordered by their first appearance in the file.
+ *
+ * @param contents Contents of the annotation file, after any decompression.
+ * @param options Further options.
+ *
+ * @return The parsed annotations.
+ */
+inline Table parse(std::string_view contents, const ParseOptions& options = ParseOptions()) {
+    size_t header_end = contents.find('\n');
+    if (header_end == std::string_view::npos) {
+        header_end = contents.size();
+    }
+    auto names = split_line(contents.substr(0, header_end), options.delimiter);
+    size_t ncols = names.size();
+
+    // Splitting the body into ranges at line boundaries.
+    size_t body_start = std::min(header_end + 1, contents.size());
+    size_t body_len = contents.size() - body_start;
+    size_t nthreads = std::max(1, options.num_threads);
+    nthreads = std::max<size_t>(1, std::min(nthreads, body_len / 65536 + 1));
+
+    std::vector<Chunk> chunks(nthreads);
+    size_t last = body_start;
+    for (size_t t = 0; t < nthreads; ++t) {
+        auto& chunk = chunks[t];
+        chunk.start = last;
+        if (t + 1 == nthreads) {
+            chunk.end = contents.size();
+        } else {
+            size_t target = std::max(last, body_start + (body_len * (t + 1)) / nthreads);
+            size_t next = contents.find('\n', target);
+            chunk.end = (next == std::string_view::npos ? contents.size() : next);
+        }
+        last = std::min(contents.size(), chunk.end + 1);
+    }
+
+    run_parallel(nthreads, [&](size_t t) -> void {
+        tokenize(contents, chunks[t], ncols, options.delimiter);
+    });
+
+    Table output;
+    std::vector<size_t> row_offsets(nthreads);
+    for (size_t t = 0; t < nthreads; ++t) {
+        if (!chunks[t].error.empty()) {
+            throw std::runtime_error(chunks[t].error);
+        }
+        row_offsets[t] = output.num_rows;
+        output.num_rows += chunks[t].num_rows;
+    }
+
+    output.columns.resize(ncols);
+    for (size_t c = 0; c < ncols; ++c) {
+        auto& col = output.columns[c];
+        col.name = std::string(names[c]);
+        col.numeric = true;
+        for (const auto& chunk : chunks) {
+            if (!chunk.numeric[c]) {
+                col.numeric = false;
+                break;
+            }
+        }
+        if (col.numeric) {
+            col.numbers.resize(output.num_rows);
+        } else {
+            col.codes.resize(output.num_rows);
+        }
+    }
+
+    // Converting each range into numbers or local codes, along with the local dictionaries.
+    std::vector<std::vector<interning::Dictionary> > local_levels(nthreads, std::vector<interning::Dictionary>(ncols));
+    run_parallel(nthreads, [&](size_t t) -> void {
+        const auto& chunk = chunks[t];
+        for (size_t c = 0; c < ncols; ++c) {
+            auto& col = output.columns[c];
+            const auto& fields = chunk.fields[c];
+            size_t offset = row_offsets[t];
+
+            if (col.numeric) {
+                for (size_t r = 0; r < fields.size(); ++r) {
+                    double& current = col.numbers[offset + r];
+                    if (is_missing(fields[r])) {
+                        current = std::numeric_limits<double>::quiet_NaN();
+                    } else {
+                        parse_number(fields[r], current);
+                    }
+                }
+            } else {
+                auto& dictionary = local_levels[t][c];
+                for (size_t r = 0; r < fields.size(); ++r) {
+                    col.codes[offset + r] = (is_missing(fields[r]) ? -1 : dictionary.intern(fields[r]));
+                }
+            }
+        }
+    });
+
+    // Merging the dictionaries in order, and remapping the local codes.
+    std::vector<std::vector<std::vector<int> > > remapping(nthreads, std::vector<std::vector<int> >(ncols));
+    for (size_t c = 0; c < ncols; ++c) {
+        auto& col = output.columns[c];
+        if (col.numeric) {
+            continue;
+        }
+        interning::Dictionary dictionary;
+        for (size_t t = 0; t < nthreads; ++t) {
+            const auto& local = local_levels[t][c];
+            auto& remap = remapping[t][c];
+            for (size_t l = 0; l < local.size(); ++l) {
+                remap.push_back(dictionary.intern(local.get(l)));
+            }
+        }
+        col.levels = dictionary.levels();
+    }
+
+    run_parallel(nthreads, [&](size_t t) -> void {
+        size_t offset = row_offsets[t];
+        for (size_t c = 0; c < ncols; ++c) {
+            auto& col = output.columns[c];
+            if (col.numeric) {
+                continue;
+            }
+            const auto& remap = remapping[t][c];
+            auto start = col.codes.begin() + offset;
+            for (auto it = start, end = start + chunks[t].num_rows; it != end; ++it) {
+                if (*it >= 0) {
+                    *it = remap[*it];
+                }
+            }
+        }
+    });
+
+    return output;
+}
+
+/**
+ * Read and parse an embedded annotation file.
+ *
+ * @param location Location of the (possibly Gzip-compressed) annotation file, usually from `embedded::locate_in_kana()` or `embedded::locate_in_directory()`.
+ * @param options Further options.
+ *
+ * @return The parsed annotations.
+ */
+inline Table read(const embedded::Location& location, const ParseOptions& options = ParseOptions()) {
+    auto contents = embedded::read_text(location);
+    return parse(contents, options);
+}
+
+/**
+ * Save parsed annotations into a HDF5 group, e.g., inside the state file.
+ * This creates a group at `name` that contains one child per column, named by the column's position (i.e., `"0"`, `"1"`, etc.) in the annotation file:
+ *
+ * - Numeric columns are saved as float datasets.
+ * - Categorical columns are saved as groups containing `codes`, an integer dataset of codes (-1 for missing values); and `levels`, a string dataset of levels.
+ *
+ * The column names are stored in the `columns` attribute of the group.
+ * They are not used as the names of the children, as the header may contain empty, duplicated or otherwise invalid names for HDF5 objects.
+ *
+ * @param handle Parent group.
+ * @param name Name of the group to create.
+ * @param table Parsed annotations.
+ */
+inline void save(const H5::Group& handle, const std::string& name, const Table& table) {
+    auto ghandle = handle.createGroup(name);
+
+    std::vector<std::string> colnames;
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+        const auto& col = table.columns[c];
+        colnames.push_back(col.name);
+        auto child = std::to_string(c);
+        if (col.numeric) {
+            utils::write_float_vector(ghandle, child, col.numbers);
+        } else {
+            auto chandle = ghandle.createGroup(child);
+            utils::write_integer_vector(chandle, "codes", col.codes);
+            utils::write_string_vector(chandle, "levels", col.levels);
+        }
+    }
+
+    std::vector<const char*> ptrs;
+    for (const auto& n : colnames) {
+        ptrs.push_back(n.c_str());
+    }
+    hsize_t ncols = ptrs.size();
+    auto stype = utils::utf8_string_type();
+    auto ahandle = ghandle.createAttribute("columns", stype, H5::DataSpace(1, &ncols));
+    if (ncols) {
+        ahandle.write(stype, ptrs.data());
+    }
+}
+
+/**
+ * @param handle Parent group.
+ * @param name Name of the group created by `save()`.
+ *
+ * @return The annotations.
+ */
+inline Table load(const H5::Group& handle, const std::string& name) {
+    auto ghandle = utils::check_and_open_group(handle, name);
+    auto ahandle = ghandle.openAttribute("columns");
+    hsize_t ncols = 0;
+    ahandle.getSpace().getSimpleExtentDims(&ncols);
+
+    std::vector<std::string> colnames;
+    if (ncols) {
+        std::vector<char*> buffer(ncols);
+        auto stype = ahandle.getStrType();
+        ahandle.read(stype, buffer.data());
+        for (auto b : buffer) {
+            colnames.emplace_back(b);
+        }
+        H5Dvlen_reclaim(stype.getId(), ahandle.getSpace().getId(), H5P_DEFAULT, buffer.data());
+    }
+
+    Table output;
+    for (size_t c = 0; c < colnames.size(); ++c) {
+        Column col;
+        col.name = colnames[c];
+        auto child = std::to_string(c);
+        if (ghandle.exists(child) && ghandle.childObjType(child) == H5O_TYPE_DATASET) {
+            col.numeric = true;
+            auto dhandle = utils::check_and_open_dataset(ghandle, child, H5T_FLOAT);
+            auto dims = utils::get_dimensions(dhandle);
+            col.numbers.resize(dims.empty() ? 0 : dims[0]);
+            dhandle.read(col.numbers.data(), H5::PredType::NATIVE_DOUBLE);
+        } else {
+            auto chandle = utils::check_and_open_group(ghandle, child);
+            col.codes = utils::load_integer_vector<int>(chandle, "codes");
+            col.levels = utils::load_string_vector(chandle, "levels");
+        }
+
+        size_t nrows = (col.numeric ? col.numbers.size() : col.codes.size());
+        if (c == 0) {
+            output.num_rows = nrows;
+        } else if (nrows != output.num_rows) {
+            throw std::runtime_error("column '" + col.name + "' has a different number of rows");
+        }
+        output.columns.push_back(std::move(col));
+    }
+
+    return output;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,492 @@
+#ifndef KANAVAL_ARROW_IPC_HPP
+#define KANAVAL_ARROW_IPC_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+/**
+ * @file arrow_ipc.hpp
+ *
+ * @brief Minimal writer for the Arrow IPC file format.
+ */
+
+namespace kanaval {
+
+namespace arrow_ipc {
+
+/**
+ * Types of columns that can be written.
+ */
+enum class Type { INT8, INT32, FLOAT64, BOOL, UTF8 };
+
+/**
+ * @brief Description of a column in the schema.
+ */
+struct Column {
+    /**
+     * @param n Name of the column.
+     * @param t Type of the column.
+     * @param nl Whether the column may contain missing values.
+     */
+    Column(std::string n, Type t, bool nl = false) : name(std::move(n)), type(t), nullable(nl) {}
+
+    /**
+     * Name of the column.
+     */
+    std::string name;
+
+    /**
+     * Type of the column.
+     */
+    Type type;
+
+    /**
+     * Whether the column may contain missing values.
+     */
+    bool nullable;
+};
+
+/**
+ * @brief Contents of a column in a record batch.
+ */
+struct ColumnData {
+    /**
+     * Pointer to the values.
+     * For `Type::BOOL`, this should be a bit-packed array in least-significant-bit order.
+     * For `Type::UTF8`, this should contain the concatenated characters of all strings.
+     */
+    const void* values = NULL;
+
+    /**
+     * For `Type::UTF8`, pointer to an array of length equal to the number of rows plus 1.
+     * The characters of row `i` are stored in `values` from `offsets[i]` to `offsets[i + 1]`, where `offsets[0]` should be zero.
+     * Ignored for all other types.
+     */
+    const int32_t* offsets = NULL;
+
+    /**
+     * Pointer to a bit-packed validity bitmap where set bits indicate non-missing values.
+     * This may be NULL if there are no missing values.
+     */
+    const uint8_t* validity = NULL;
+
+    /**
+     * Number of missing values.
+     */
+    int64_t null_count = 0;
+};
+
+/**
+ * @cond
+ */
+inline int64_t pad8(int64_t x) {
+    return (x + 7) / 8 * 8;
+}
+
+inline int64_t value_bytes(Type t, int64_t n) {
+    switch (t) {
+        case Type::INT8: return n;
+        case Type::INT32: return n * 4;
+        case Type::FLOAT64: return n * 8;
+        case Type::BOOL: return (n + 7) / 8;
+        case Type::UTF8: return (n + 1) * 4; // offsets only, the characters are handled separately.
+    }
+    return 0;
+}
+
+/*
+ * Tiny front-to-back FlatBuffers serializer, sufficient for the Arrow
+ * metadata. Each table is emitted as [vtable][table][children], so that all
+ * unsigned offsets point forward and the vtable precedes its table.
+ */
+class FlatBuilder {
+public:
+    struct Field {
+        enum Kind { U8, I16, I32, I64, BOOL, OFFSET };
+        Field(int i, Kind k, int64_t v) : id(i), kind(k), scalar(v) {}
+        Field(int i, std::function<size_t(FlatBuilder&)> c) : id(i), kind(OFFSET), child(std::move(c)) {}
+        int id;
+        Kind kind;
+        int64_t scalar = 0;
+        std::function<size_t(FlatBuilder&)> child;
+    };
+
+    std::vector<uint8_t> buffer;
+
+    void align(size_t n) {
+        while (buffer.size() % n) {
+            buffer.push_back(0);
+        }
+    }
+
+    template<typename T>
+    size_t put(T val) {
+        size_t pos = buffer.size();
+        buffer.resize(pos + sizeof(T));
+        std::memcpy(buffer.data() + pos, &val, sizeof(T));
+        return pos;
+    }
+
+    template<typename T>
+    void set(size_t pos, T val) {
+        std::memcpy(buffer.data() + pos, &val, sizeof(T));
+    }
+
+    void link(size_t from, size_t to) {
+        set<uint32_t>(from, static_cast<uint32_t>(to - from));
+    }
+
+    static size_t field_size(Field::Kind k) {
+        switch (k) {
+            case Field::U8: case Field::BOOL: return 1;
+            case Field::I16: return 2;
+            case Field::I32: case Field::OFFSET: return 4;
+            case Field::I64: return 8;
+        }
+        return 0;
+    }
+
+    size_t table(std::vector<Field> fields) {
+        // Largest fields first, so that everything is naturally aligned after the 4-byte vtable offset.
+        std::stable_sort(fields.begin(), fields.end(), [](const Field& a, const Field& b) -> bool {
+            return field_size(a.kind) > field_size(b.kind);
+        });
+
+        int max_id = -1;
+        for (const auto& f : fields) {
+            max_id = std::max(max_id, f.id);
+        }
+
+        std::vector<uint16_t> voffsets(max_id + 1);
+        size_t tsize = 4;
+        for (const auto& f : fields) {
+            size_t s = field_size(f.kind);
+            tsize = (tsize + s - 1) / s * s;
+            voffsets[f.id] = tsize;
+            tsize += s;
+        }
+        tsize = (tsize + 3) / 4 * 4;
+
+        // Placing the vtable so that the table itself starts on an 8-byte boundary.
+        size_t vsize = 4 + 2 * voffsets.size();
+        align(2);
+        while ((buffer.size() + vsize) % 8) {
+            buffer.push_back(0);
+        }
+        size_t vpos = put<uint16_t>(vsize);
+        put<uint16_t>(tsize);
+        for (auto v : voffsets) {
+            put<uint16_t>(v);
+        }
+
+        size_t tpos = buffer.size();
+        buffer.resize(tpos + tsize);
+        set<int32_t>(tpos, static_cast<int32_t>(tpos - vpos));
+
+        for (const auto& f : fields) {
+            size_t fpos = tpos + voffsets[f.id];
+            switch (f.kind) {
+                case Field::U8: case Field::BOOL: set<uint8_t>(fpos, f.scalar); break;
+                case Field::I16: set<int16_t>(fpos, f.scalar); break;
+                case Field::I32: set<int32_t>(fpos, f.scalar); break;
+                case Field::I64: set<int64_t>(fpos, f.scalar); break;
+                default: break;
+            }
+        }
+
+        for (const auto& f : fields) {
+            if (f.kind == Field::OFFSET) {
+                size_t fpos = tpos + voffsets[f.id];
+                link(fpos, f.child(*this));
+            }
+        }
+
+        return tpos;
+    }
+
+    size_t string(const std::string& s) {
+        align(4);
+        size_t pos = put<uint32_t>(s.size());
+        buffer.insert(buffer.end(), s.begin(), s.end());
+        buffer.push_back(0);
+        return pos;
+    }
+
+    size_t table_vector(const std::vector<std::function<size_t(FlatBuilder&)> >& children) {
+        align(4);
+        size_t pos = put<uint32_t>(children.size());
+        std::vector<size_t> slots;
+        for (size_t i = 0; i < children.size(); ++i) {
+            slots.push_back(put<uint32_t>(0));
+        }
+        for (size_t i = 0; i < children.size(); ++i) {
+            link(slots[i], children[i](*this));
+        }
+        return pos;
+    }
+
+    // Vector of structs composed of 8-byte members, so elements must be 8-byte aligned.
+    size_t struct_vector(const std::vector<std::vector<int64_t> >& elements) {
+        align(4);
+        if (buffer.size() % 8 == 0) {
+            put<uint32_t>(0);
+        }
+        size_t pos = put<uint32_t>(elements.size());
+        for (const auto& e : elements) {
+            for (auto x : e) {
+                put<int64_t>(x);
+            }
+        }
+        return pos;
+    }
+
+    std::vector<uint8_t> finish(std::function<size_t(FlatBuilder&)> root) {
+        buffer.clear();
+        put<uint32_t>(0);
+        link(0, root(*this));
+        align(8);
+        return std::move(buffer);
+    }
+};
+
+inline size_t write_field(FlatBuilder& fb, const Column& col) {
+    using F = FlatBuilder::Field;
+    uint8_t type_id = 0;
+    std::function<size_t(FlatBuilder&)> type_table;
+
+    switch (col.type) {
+        case Type::INT8: case Type::INT32:
+            type_id = 2; // Int
+            type_table = [&col](FlatBuilder& b) -> size_t {
+                return b.table({ F(0, F::I32, col.type == Type::INT8 ? 8 : 32), F(1, F::BOOL, 1) });
+            };
+            break;
+        case Type::FLOAT64:
+            type_id = 3; // FloatingPoint
+            type_table = [](FlatBuilder& b) -> size_t {
+                return b.table({ F(0, F::I16, 2) }); // DOUBLE
+            };
+            break;
+        case Type::BOOL:
+            type_id = 6; // Bool
+            type_table = [](FlatBuilder& b) -> size_t {
+                return b.table({});
+            };
+            break;
+        case Type::UTF8:
+            type_id = 5; // Utf8
+            type_table = [](FlatBuilder& b) -> size_t {
+                return b.table({});
+            };
+            break;
+    }
+
+    return fb.table({
+        F(0, [&col](FlatBuilder& b) -> size_t { return b.string(col.name); }),
+        F(1, F::BOOL, col.nullable),
+        F(2, F::U8, type_id),
+        F(3, type_table),
+        F(5, [](FlatBuilder& b) -> size_t { return b.table_vector({}); })
+    });
+}
+
+inline size_t write_schema(FlatBuilder& fb, const std::vector<Column>& columns) {
+    using F = FlatBuilder::Field;
+    std::vector<std::function<size_t(FlatBuilder&)> > fields;
+    for (const auto& col : columns) {
+        fields.push_back([&col](FlatBuilder& b) -> size_t { return write_field(b, col); });
+    }
+    return fb.table({
+        F(0, F::I16, 0), // Little-endian.
+        F(1, [&fields](FlatBuilder& b) -> size_t { return b.table_vector(fields); })
+    });
+}
+/**
+ * @endcond
+ */
+
+/**
+ * @brief Write a table to an Arrow IPC file.
+ *
+ * The table is written as a series of record batches, each of which is written column by column.
+ * This allows callers to stream through their data without holding the entire table in memory.
+ * Only non-nested fixed-width types and UTF-8 strings are currently supported.
+ */
+class FileWriter {
+public:
+    /**
+     * @param path Path to the output file.
+     * @param cols Description of the columns.
+     */
+    FileWriter(const std::string& path, std::vector<Column> cols) : output(path, std::ios::binary | std::ios::trunc), columns(std::move(cols)) {
+        if (!output) {
+            throw std::runtime_error("failed to open '" + path + "' for writing");
+        }
+        output.write("ARROW1\0\0", 8);
+        position = 8;
+
+        FlatBuilder fb;
+        auto meta = fb.finish([&](FlatBuilder& b) -> size_t {
+            using F = FlatBuilder::Field;
+            return b.table({
+                F(0, F::I16, 4), // V5.
+                F(1, F::U8, 1), // Schema.
+                F(2, [&](FlatBuilder& b2) -> size_t { return write_schema(b2, columns); }),
+                F(3, F::I64, 0)
+            });
+        });
+        write_message(meta);
+    }
+
+    /**
+     * Write a record batch.
+     *
+     * @param length Number of rows in the batch.
+     * @param data Contents of each column, in the same order as the columns supplied in the constructor.
+     */
+    void write_batch(int64_t length, const std::vector<ColumnData>& data) {
+        if (data.size() != columns.size()) {
+            throw std::runtime_error("number of columns in the record batch is not consistent with the schema");
+        }
+
+        std::vector<std::vector<int64_t> > nodes, buffers;
+        int64_t body = 0;
+        for (size_t c = 0; c < columns.size(); ++c) {
+            const auto& d = data[c];
+            if (d.null_count && !columns[c].nullable) {
+                throw std::runtime_error("column '" + columns[c].name + "' should not contain missing values");
+            }
+            nodes.push_back({ length, d.null_count });
+
+            int64_t vlen = (d.null_count ? (length + 7) / 8 : 0);
+            buffers.push_back({ body, vlen });
+            body += pad8(vlen);
+
+            int64_t dlen = value_bytes(columns[c].type, length);
+            buffers.push_back({ body, dlen });
+            body += pad8(dlen);
+
+            if (columns[c].type == Type::UTF8) {
+                if (d.offsets == NULL || d.offsets[0] != 0) {
+                    throw std::runtime_error("offsets for string column '" + columns[c].name + "' should start from zero");
+                }
+                int64_t clen = d.offsets[length];
+                buffers.push_back({ body, clen });
+                body += pad8(clen);
+            }
+        }
+
+        FlatBuilder fb;
+        auto meta = fb.finish([&](FlatBuilder& b) -> size_t {
+            using F = FlatBuilder::Field;
+            return b.table({
+                F(0, F::I16, 4),
+                F(1, F::U8, 3), // RecordBatch.
+                F(2, [&](FlatBuilder& b2) -> size_t {
+                    return b2.table({
+                        F(0, F::I64, length),
+                        F(1, [&](FlatBuilder& b3) -> size_t { return b3.struct_vector(nodes); }),
+                        F(2, [&](FlatBuilder& b3) -> size_t { return b3.struct_vector(buffers); })
+                    });
+                }),
+                F(3, F::I64, body)
+            });
+        });
+
+        int64_t offset = position;
+        int32_t meta_len = write_message(meta);
+
+        for (size_t c = 0; c < columns.size(); ++c) {
+            const auto& d = data[c];
+            if (d.null_count) {
+                write_padded(d.validity, (length + 7) / 8);
+            }
+            if (columns[c].type == Type::UTF8) {
+                write_padded(d.offsets, value_bytes(columns[c].type, length));
+                write_padded(d.values, d.offsets[length]);
+            } else {
+                write_padded(d.values, value_bytes(columns[c].type, length));
+            }
+        }
+
+        blocks.push_back({ offset, meta_len, body });
+    }
+
+    /**
+     * Finish writing the file.
+     * This should be called exactly once after all batches have been written.
+     */
+    void close() {
+        uint32_t eos[2] = { 0xFFFFFFFF, 0 };
+        output.write(reinterpret_cast<const char*>(eos), sizeof(eos));
+
+        FlatBuilder fb;
+        auto footer = fb.finish([&](FlatBuilder& b) -> size_t {
+            using F = FlatBuilder::Field;
+            return b.table({
+                F(0, F::I16, 4),
+                F(1, [&](FlatBuilder& b2) -> size_t { return write_schema(b2, columns); }),
+                F(2, [](FlatBuilder& b2) -> size_t { return b2.struct_vector({}); }),
+                F(3, [&](FlatBuilder& b2) -> size_t {
+                    // Block struct is { int64 offset, int32 metaDataLength, (4 bytes padding), int64 bodyLength }.
+                    std::vector<std::vector<int64_t> > contents;
+                    for (const auto& bl : blocks) {
+                        contents.push_back({ bl.offset, static_cast<int64_t>(static_cast<uint32_t>(bl.meta_length)), bl.body_length });
+                    }
+                    return b2.struct_vector(contents);
+                })
+            });
+        });
+
+        output.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+        int32_t flen = footer.size();
+        output.write(reinterpret_cast<const char*>(&flen), sizeof(flen));
+        output.write("ARROW1", 6);
+        output.close();
+        if (!output) {
+            throw std::runtime_error("failed to finish writing the Arrow file");
+        }
+    }
+
+private:
+    int32_t write_message(const std::vector<uint8_t>& meta) {
+        uint32_t cont = 0xFFFFFFFF;
+        int32_t len = meta.size();
+        output.write(reinterpret_cast<const char*>(&cont), 4);
+        output.write(reinterpret_cast<const char*>(&len), 4);
+        output.write(reinterpret_cast<const char*>(meta.data()), meta.size());
+        position += 8 + meta.size();
+        return 8 + len;
+    }
+
+    void write_padded(const void* ptr, int64_t len) {
+        output.write(static_cast<const char*>(ptr), len);
+        static const char zeros[8] = { 0 };
+        int64_t extra = pad8(len) - len;
+        output.write(zeros, extra);
+        position += len + extra;
+    }
+
+    struct Block {
+        int64_t offset;
+        int32_t meta_length;
+        int64_t body_length;
+    };
+
+    std::ofstream output;
+    std::vector<Column> columns;
+    std::vector<Block> blocks;
+    int64_t position = 0;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,566 @@
+#ifndef KANAVAL_BATCH_HPP
+#define KANAVAL_BATCH_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * @file batch.hpp
+ *
+ * @brief Validate many files cooperatively across processes that share a directory.
+ */
+
+namespace kanaval {
+
+namespace batch {
+
+/**
+ * @brief Options for `Workspace`.
+ */
+struct Options {
+    /**
+     * Number of files in each shard.
+     * Each shard is claimed and completed as a single unit of work.
+     * This is only used when the workspace is first created.
+     */
+    size_t shard_size = 100;
+
+    /**
+     * Number of seconds after which a lease is considered to be abandoned, e.g., because its worker died.
+     * Leases are renewed after each file, so this should be longer than the time taken to validate the largest file.
+     */
+    double lease_timeout = 3600;
+};
+
+/**
+ * @brief Result of validating a single file.
+ */
+struct Result {
+    /**
+     * Path to the file.
+     */
+    std::string path;
+
+    /**
+     * Whether the file was valid.
+     */
+    bool ok = true;
+
+    /**
+     * Time taken to validate the file, in seconds.
+     */
+    double seconds = 0;
+
+    /**
+     * Error message if `ok = false`, otherwise empty.
+     */
+    std::string message;
+};
+
+/**
+ * @cond
+ */
+inline std::string clean_field(std::string x) {
+    for (auto& c : x) {
+        if (c == '\t' || c == '\n' || c == '\r') {
+            c = ' ';
+        }
+    }
+    return x;
+}
+
+inline std::string clean_name(std::string x) {
+    for (auto& c : x) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '.') {
+            c = '_';
+        }
+    }
+    return x;
+}
+
+inline std::string format_result(const Result& r) {
+    return clean_field(r.path) + "\t" + (r.ok ? "ok" : "error") + "\t" + std::to_string(r.seconds) + "\t" + clean_field(r.message) + "\n";
+}
+
+inline void write_atomically(const std::filesystem::path& path, const std::string& contents, const std::string& owner) {
+    auto tmp = path;
+    tmp += "." + clean_name(owner) + ".tmp";
+    {
+        std::ofstream output(tmp, std::ios::binary | std::ios::trunc);
+        output << contents;
+        if (!output) {
+            throw std::runtime_error("failed to write '" + tmp.string() + "'");
+        }
+    }
+    std::filesystem::rename(tmp, path); // atomically replaces any existing file.
+}
+/**
+ * @endcond
+ */
+
+/**
+ * @brief Shared directory that coordinates the validation of a list of files.
+ *
+ * The directory contains:
+ *
+ * - `manifest.txt`, the list of files to validate.
+ *   The first line records the shard size and each subsequent line contains one path.
+ * - `leases/<i>.lease`, a lease on shard `i` that is held by the worker named in the file.
+ *   Leases are created exclusively, so only one worker can claim each shard.
+ *   A lease that has not been renewed within `Options::lease_timeout` seconds can be taken over by another worker.
+ * - `results/<i>.tsv`, the results for shard `i`, created atomically once all files in the shard have been validated.
+ *   Shards with results are never validated again, so an interrupted job can be resumed by simply restarting the workers.
+ * - `summary.tsv`, the merged results from `merge()`.
+ *
+ * All coordination is performed through atomic file creation and renaming,
+ * so any number of processes on any number of machines can work in the same directory, provided it is on a shared filesystem.
+ */
+class Workspace {
+public:
+    /**
+     * Create a workspace or join an existing one.
+     * If multiple workers attempt to create the workspace at the same time, only one manifest is used and the others join it.
+     *
+     * @param dir Path to the shared directory.
+     * @param files Paths to the files to validate.
+     * This should not be empty; workers without a list of files should join with the other constructor.
+     * If `dir` already contains a manifest, its files should be the same as `files`.
+     * @param options Further options.
+     */
+    Workspace(std::string dir, const std::vector<std::string>& files, Options options = Options()) : dir_(std::move(dir)), options_(std::move(options)) {
+        if (options_.shard_size == 0) {
+            throw std::runtime_error("shard size should be positive");
+        }
+        if (files.empty()) {
+            throw std::runtime_error("list of files should not be empty when creating a workspace");
+        }
+        std::filesystem::create_directories(dir_ / "leases");
+        std::filesystem::create_directories(dir_ / "results");
+
+        auto mpath = dir_ / "manifest.txt";
+        if (!std::filesystem::exists(mpath)) {
+            std::stringstream contents;
+            contents << "#shard_size\t" << options_.shard_size << "\n";
+            for (const auto& f : files) {
+                if (f.find('\n') != std::string::npos) {
+                    throw std::runtime_error("file paths should not contain newlines");
+                }
+                contents << f << "\n";
+            }
+
+            // Linking is atomic and fails if the target exists, so only the first worker's manifest is used.
+            auto tmp = mpath;
+            tmp += "." + std::to_string(std::random_device()()) + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+            {
+                std::ofstream output(tmp, std::ios::binary | std::ios::trunc);
+                output << contents.str();
+                if (!output) {
+                    throw std::runtime_error("failed to write '" + tmp.string() + "'");
+                }
+            }
+            std::error_code ec;
+            std::filesystem::create_hard_link(tmp, mpath, ec);
+            std::filesystem::remove(tmp);
+
+            // Failing because another worker created the manifest first is fine, as long as the files are the same (checked below).
+            if (ec && !std::filesystem::exists(mpath)) {
+                throw std::runtime_error("failed to create '" + mpath.string() + "' (" + ec.message() + ")");
+            }
+        }
+
+        load_manifest();
+        if (files_ != files) {
+            throw std::runtime_error("files are not the same as those in the existing manifest at '" + mpath.string() + "'");
+        }
+    }
+
+    /**
+     * Join an existing workspace.
+     * An error is raised if the workspace has not yet been created with the other constructor.
+     *
+     * @param dir Path to the shared directory, containing a manifest.
+     * @param options Further options.
+     * `Options::shard_size` is ignored.
+     */
+    Workspace(std::string dir, Options options = Options()) : dir_(std::move(dir)), options_(std::move(options)) {
+        if (!std::filesystem::exists(dir_ / "manifest.txt")) {
+            throw std::runtime_error("no manifest in '" + dir_.string() + "', files should be supplied to create the workspace");
+        }
+        load_manifest();
+    }
+
+public:
+    /**
+     * @return Paths to all files in the manifest.
+     */
+    const std::vector<std::string>& files() const {
+        return files_;
+    }
+
+    /**
+     * @return Number of shards.
+     */
+    size_t num_shards() const {
+        return (files_.size() + options_.shard_size - 1) / options_.shard_size;
+    }
+
+    /**
+     * @param shard Index of the shard.
+     * @return Pair containing the index of the first file in the shard and the number of files.
+     */
+    std::pair<size_t, size_t> shard_range(size_t shard) const {
+        size_t start = shard * options_.shard_size;
+        return std::make_pair(start, std::min(options_.shard_size, files_.size() - start));
+    }
+
+    /**
+     * @param shard Index of the shard.
+     * @return Whether results are available for the shard.
+     */
+    bool is_done(size_t shard) const {
+        return std::filesystem::exists(results_path(shard));
+    }
+
+    /**
+     * Attempt to claim a shard for a worker.
+     *
+     * @param shard Index of the shard.
+     * @param owner Name of the worker, which should be unique across all workers, e.g., the host name and process ID.
+     *
+     * @return Whether the shard was claimed.
+     * This is false if the shard has already been completed or is leased by another worker whose lease has not expired.
+     */
+    bool claim(size_t shard, const std::string& owner) {
+        if (is_done(shard)) {
+            return false;
+        }
+
+        auto lpath = lease_path(shard);
+        if (try_create(lpath, owner)) {
+            return !recheck_done(shard);
+        }
+
+        // Taking over an expired lease. Renaming is atomic, so only one worker can move it aside.
+        if (!is_expired(lpath)) {
+            return false;
+        }
+
+        auto stale = lpath;
+        stale += "." + clean_name(owner) + ".stale";
+        std::error_code ec;
+        std::filesystem::rename(lpath, stale, ec);
+        if (ec) {
+            return false; // lease was removed or moved aside by another worker in the meantime; try again later.
+        }
+
+        // Another worker may have taken over the expired lease between our check and the rename,
+        // in which case we have moved aside its fresh lease and must put it back. Hard-linking fails
+        // if yet another lease was created in the meantime; the owner of the restored lease will then
+        // find that it no longer owns the shard when it next calls renew().
+        if (!is_expired(stale)) {
+            std::filesystem::create_hard_link(stale, lpath, ec);
+            std::filesystem::remove(stale, ec);
+            return false;
+        }
+
+        std::filesystem::remove(stale, ec);
+        if (try_create(lpath, owner)) {
+            return !recheck_done(shard);
+        }
+        return false;
+    }
+
+    /**
+     * Renew the lease on a shard so that it is not taken over by another worker.
+     *
+     * @param shard Index of a shard claimed by this worker.
+     * @param owner Name of the worker.
+     *
+     * @return Whether the worker still holds the lease.
+     * If false, the lease has expired and was taken over by another worker, so this worker should abandon the shard.
+     */
+    bool renew(size_t shard, const std::string& owner) {
+        auto lpath = lease_path(shard);
+        if (!owns(lpath, owner)) {
+            return false;
+        }
+        std::error_code ec;
+        std::filesystem::last_write_time(lpath, std::filesystem::file_time_type::clock::now(), ec);
+        return !ec;
+    }
+
+    /**
+     * Record the results for a shard and release its lease.
+     * The lease is left alone if it is now held by another worker.
+     *
+     * @param shard Index of a shard claimed by this worker.
+     * @param results Results for all files in the shard.
+     * @param owner Name of the worker.
+     */
+    void complete(size_t shard, const std::vector<Result>& results, const std::string& owner) {
+        std::string contents;
+        for (const auto& r : results) {
+            contents += format_result(r);
+        }
+        write_atomically(results_path(shard), contents, owner);
+
+        auto lpath = lease_path(shard);
+        if (owns(lpath, owner)) {
+            std::error_code ec;
+            std::filesystem::remove(lpath, ec);
+        }
+    }
+
+    /**
+     * @param shard Index of a completed shard.
+     * @return Results for all files in the shard.
+     */
+    std::vector<Result> results(size_t shard) const {
+        std::ifstream input(results_path(shard));
+        if (!input) {
+            throw std::runtime_error("failed to open results for shard " + std::to_string(shard));
+        }
+
+        std::vector<Result> output;
+        std::string line;
+        while (std::getline(input, line)) {
+            Result current;
+            std::stringstream fields(line);
+            std::string status, seconds;
+            std::getline(fields, current.path, '\t');
+            std::getline(fields, status, '\t');
+            std::getline(fields, seconds, '\t');
+            std::getline(fields, current.message);
+            current.ok = (status == "ok");
+            current.seconds = std::stod(seconds);
+            output.push_back(std::move(current));
+        }
+        return output;
+    }
+
+    /**
+     * @return Path to the shared directory.
+     */
+    const std::filesystem::path& directory() const {
+        return dir_;
+    }
+
+private:
+    std::filesystem::path dir_;
+    Options options_;
+    std::vector<std::string> files_;
+
+    std::filesystem::path lease_path(size_t shard) const {
+        return dir_ / "leases" / (std::to_string(shard) + ".lease");
+    }
+
+    std::filesystem::path results_path(size_t shard) const {
+        return dir_ / "results" / (std::to_string(shard) + ".tsv");
+    }
+
+    static bool try_create(const std::filesystem::path& path, const std::string& owner) {
+        auto handle = std::fopen(path.string().c_str(), "wx"); // exclusive creation.
+        if (!handle) {
+            return false;
+        }
+        std::fputs(owner.c_str(), handle);
+        std::fclose(handle);
+        return true;
+    }
+
+    bool is_expired(const std::filesystem::path& path) const {
+        std::error_code ec;
+        auto modified = std::filesystem::last_write_time(path, ec);
+        if (ec) {
+            return false;
+        }
+        auto age = std::chrono::duration<double>(std::filesystem::file_time_type::clock::now() - modified).count();
+        return age >= options_.lease_timeout;
+    }
+
+    static bool owns(const std::filesystem::path& path, const std::string& owner) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            return false;
+        }
+        std::string contents((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        return contents == owner;
+    }
+
+    // Another worker may have completed the shard and released its lease just before we claimed it.
+    bool recheck_done(size_t shard) {
+        if (is_done(shard)) {
+            std::error_code ec;
+            std::filesystem::remove(lease_path(shard), ec);
+            return true;
+        }
+        return false;
+    }
+
+    void load_manifest() {
+        auto mpath = dir_ / "manifest.txt";
+        std::ifstream input(mpath);
+        if (!input) {
+            throw std::runtime_error("failed to open '" + mpath.string() + "'");
+        }
+
+        std::string line;
+        std::getline(input, line);
+        const std::string prefix = "#shard_size\t";
+        if (line.rfind(prefix, 0) != 0) {
+            throw std::runtime_error("expected the shard size in the first line of '" + mpath.string() + "'");
+        }
+        options_.shard_size = std::stoull(line.substr(prefix.size()));
+        if (options_.shard_size == 0) {
+            throw std::runtime_error("shard size in '" + mpath.string() + "' should be positive");
+        }
+
+        while (std::getline(input, line)) {
+            files_.push_back(line);
+        }
+    }
+};
+
+/**
+ * Validate files in a workspace until no more shards can be claimed.
+ * Workers start at different shards (based on their name) to reduce contention, and skip over shards that are completed or leased by other workers.
+ * This function can be called concurrently by any number of workers in different processes.
+ *
+ * @tparam Function Function that accepts a file path and throws an exception if the file is invalid.
+ *
+ * @param workspace Workspace to process.
+ * @param owner Name of the worker, which should be unique across all workers.
+ * @param fun Function to validate each file.
+ *
+ * @return Number of files validated by this worker.
+ */
+template<class Function>
+size_t run(Workspace& workspace, const std::string& owner, Function fun) {
+    size_t nshards = workspace.num_shards();
+    if (nshards == 0) {
+        return 0;
+    }
+
+    size_t first = std::hash<std::string>()(owner) % nshards;
+    size_t nvalidated = 0;
+    for (size_t i = 0; i < nshards; ++i) {
+        size_t shard = (first + i) % nshards;
+        if (!workspace.claim(shard, owner)) {
+            continue;
+        }
+
+        auto range = workspace.shard_range(shard);
+        const auto& files = workspace.files();
+        std::vector<Result> results(range.second);
+        bool lost = false;
+        for (size_t f = 0; f < range.second; ++f) {
+            auto& current = results[f];
+            current.path = files[range.first + f];
+
+            auto start = std::chrono::steady_clock::now();
+            try {
+                fun(current.path);
+            } catch (std::exception& e) {
+                current.ok = false;
+                current.message = e.what();
+            }
+            current.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            // Abandoning the shard if our lease expired and was taken over, as the new owner will validate all of its files.
+            if (!workspace.renew(shard, owner)) {
+                lost = true;
+                break;
+            }
+        }
+
+        if (lost) {
+            continue;
+        }
+        workspace.complete(shard, results, owner);
+        nvalidated += range.second;
+    }
+
+    return nvalidated;
+}
+
+/**
+ * @brief Merged results for a workspace.
+ */
+struct Summary {
+    /**
+     * Number of files in the manifest.
+     */
+    size_t num_files = 0;
+
+    /**
+     * Number of valid files.
+     */
+    size_t num_ok = 0;
+
+    /**
+     * Number of invalid files.
+     */
+    size_t num_failed = 0;
+
+    /**
+     * Number of files in shards without results, i.e., not yet validated.
+     */
+    size_t num_pending = 0;
+
+    /**
+     * Results for all completed shards, in the same order as the manifest.
+     */
+    std::vector<Result> results;
+};
+
+/**
+ * Merge the results from all completed shards.
+ * The merged results are also written to `summary.tsv` in the workspace,
+ * where each line contains the path, status (`ok` or `error`), time in seconds and error message for a single file.
+ *
+ * @param workspace Workspace to summarize.
+ * @param owner Name of the worker, used to create a unique temporary file for the summary.
+ *
+ * @return Summary of the results.
+ */
+inline Summary merge(const Workspace& workspace, const std::string& owner) {
+    Summary output;
+    output.num_files = workspace.files().size();
+
+    std::string contents;
+    for (size_t s = 0, nshards = workspace.num_shards(); s < nshards; ++s) {
+        if (!workspace.is_done(s)) {
+            output.num_pending += workspace.shard_range(s).second;
+            continue;
+        }
+        for (auto& r : workspace.results(s)) {
+            if (r.ok) {
+                ++output.num_ok;
+            } else {
+                ++output.num_failed;
+            }
+            contents += format_result(r);
+            output.results.push_back(std::move(r));
+        }
+    }
+
+    write_atomically(workspace.directory() / "summary.tsv", contents, owner);
+    return output;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,505 @@
+#ifndef KANAVAL_BLOCKS_HPP
+#define KANAVAL_BLOCKS_HPP
+
+#include "H5Cpp.h"
+#include "zlib.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+#include "utils.hpp"
+#include "misc.hpp"
+#include "inspect.hpp"
+#include "inputs.hpp"
+#include "embedded.hpp"
+#include "streaming.hpp"
+#include "annotations.hpp"
+#include "interning.hpp"
+
+/**
+ * @file blocks.hpp
+ *
+ * @brief Materialize the sample of origin for each cell, and tabulate clusters against samples.
+ */
+
+namespace kanaval {
+
+namespace blocks {
+
+/**
+ * @brief Sample of origin for each cell, before and after QC filtering.
+ *
+ * This is intended to be created once with `materialize()` and shared by all consumers that need a per-cell blocking factor,
+ * e.g., per-sample QC thresholds (using `all`), batch-mixing diagnostics (using `filtered`) or cluster-by-sample tables.
+ */
+struct Blocks {
+    /**
+     * Name of each sample.
+     * For single-sample datasets, this contains a single empty string.
+     */
+    std::vector<std::string> names;
+
+    /**
+     * Sample of each cell before QC filtering, as integers in `[0, names.size())`.
+     */
+    std::vector<int> all;
+
+    /**
+     * Sample of each cell after QC filtering, as integers in `[0, names.size())`.
+     */
+    std::vector<int> filtered;
+
+    /**
+     * @return Number of samples.
+     */
+    int num_blocks() const {
+        return names.size();
+    }
+};
+
+/**
+ * @brief Options for `materialize()`.
+ */
+struct Options {
+    /**
+     * Number of cells to process in each block when reading the discard vector.
+     */
+    hsize_t block_size = 65536;
+
+    /**
+     * Number of bytes to decompress when searching for the header of a MatrixMarket file.
+     */
+    hsize_t header_size = 65536;
+};
+
+/**
+ * @cond
+ */
+inline std::string read_prefix(const embedded::Location& location, hsize_t len) {
+    auto bytes = embedded::read_bytes(location, 0, len);
+    if (!embedded::is_gzip(bytes)) {
+        return bytes;
+    }
+
+    // Only decompressing as much as we need, as the rest of the file may be very large.
+    z_stream strm{};
+    if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK) {
+        throw std::runtime_error("failed to initialize the Gzip decompressor");
+    }
+
+    std::string output(len, '\0');
+    strm.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    strm.avail_out = len;
+    hsize_t consumed = 0;
+    while (strm.avail_out) {
+        if (strm.avail_in == 0) {
+            if (consumed) {
+                bytes = embedded::read_bytes(location, consumed, len);
+            }
+            if (bytes.empty()) {
+                break;
+            }
+            consumed += bytes.size();
+            strm.next_in = reinterpret_cast<Bytef*>(&bytes[0]);
+            strm.avail_in = bytes.size();
+        }
+
+        int ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            break;
+        } else if (ret != Z_OK) {
+            inflateEnd(&strm);
+            throw std::runtime_error("failed to decompress Gzip-compressed contents");
+        }
+    }
+
+    output.resize(len - strm.avail_out);
+    inflateEnd(&strm);
+    return output;
+}
+
+inline hsize_t count_mtx_columns(const embedded::Location& location, hsize_t header_size) {
+    auto contents = read_prefix(location, header_size);
+    std::istringstream input(contents);
+    std::string line;
+    while (std::getline(input, line)) {
+        if (line.empty() || line[0] == '%') {
+            continue;
+        }
+
+        // The size line is only usable if it was read in full.
+        if (input.eof() && contents.size() == header_size) {
+            break;
+        }
+        std::istringstream fields(line);
+        long long nrows, ncols, nnz;
+        if (!(fields >> nrows >> ncols >> nnz) || ncols < 0) {
+            throw std::runtime_error("failed to parse the size line of the MatrixMarket file");
+        }
+        return ncols;
+    }
+
+    throw std::runtime_error("failed to find the size line in the first " + std::to_string(header_size) + " bytes of the MatrixMarket file");
+}
+
+/*
+ * Standalone files (e.g., from embedded::locate_in_directory()) are opened in
+ * place, so HDF5 only reads the objects that are accessed. HDF5 cannot open a
+ * file at an arbitrary offset inside a *.kana file, so embedded files are
+ * loaded into memory in full instead.
+ */
+struct H5Input {
+    H5Input(const embedded::Location& location) : handle(open(location, bytes)) {}
+
+    std::string bytes; // must be declared before 'handle'.
+    H5::H5File handle;
+
+    static H5::H5File open(const embedded::Location& location, std::string& bytes) {
+        if (location.offset == 0) {
+            std::ifstream input(location.path, std::ios::binary | std::ios::ate);
+            if (input && static_cast<hsize_t>(input.tellg()) == location.size) {
+                return H5::H5File(location.path, H5F_ACC_RDONLY);
+            }
+        }
+        bytes = embedded::read_bytes(location);
+        return embedded::open_hdf5(bytes);
+    }
+};
+
+inline hsize_t count_h5_columns(const embedded::Location& location, const std::string& format) {
+    H5Input input(location);
+    const auto& fhandle = input.handle;
+
+    if (format == "10X") {
+        auto shape = utils::load_integer_vector<hsize_t>(utils::check_and_open_group(fhandle, "matrix"), "shape");
+        if (shape.size() != 2) {
+            throw std::runtime_error("'matrix/shape' should be of length 2");
+        }
+        return shape[1];
+    }
+
+    // H5AD stores cells in the rows, either as a dense 'X' or as a sparse 'X' group with a 'shape' attribute.
+    if (inspect::has_dataset(fhandle, "X")) {
+        auto dims = utils::get_dimensions(fhandle.openDataSet("X"));
+        if (dims.size() != 2) {
+            throw std::runtime_error("'X' should be a 2-dimensional dataset");
+        }
+        return dims[0];
+    }
+
+    auto xhandle = utils::check_and_open_group(fhandle, "X");
+    for (std::string attr : { "shape", "h5sparse_shape" }) {
+        if (xhandle.attrExists(attr)) {
+            auto ahandle = xhandle.openAttribute(attr);
+            std::vector<hsize_t> shape(ahandle.getSpace().getSimpleExtentNpoints());
+            ahandle.read(H5::PredType::NATIVE_HSIZE, shape.data());
+            if (shape.size() != 2) {
+                throw std::runtime_error("'" + attr + "' attribute of 'X' should be of length 2");
+            }
+            return shape[0];
+        }
+    }
+    throw std::runtime_error("failed to determine the shape of 'X'");
+}
+
+struct Factor {
+    std::vector<int> codes;
+    std::vector<std::string> levels;
+};
+
+inline Factor load_h5ad_factor(const embedded::Location& location, const std::string& name) {
+    H5Input input(location);
+    auto obs = utils::check_and_open_group(input.handle, "obs");
+
+    Factor output;
+    if (inspect::has_group(obs, name)) {
+        auto chandle = obs.openGroup(name);
+        output.codes = utils::load_integer_vector(chandle, "codes");
+        output.levels = utils::load_string_vector(chandle, "categories");
+    } else if (inspect::has_dataset(obs, name)) {
+        auto dhandle = obs.openDataSet(name);
+        if (dhandle.getTypeClass() == H5T_STRING) {
+            interning::Dictionary dictionary;
+            output.codes = interning::load_codes(dhandle, dictionary);
+            output.levels = dictionary.levels();
+        } else {
+            output.codes = utils::load_integer_vector(obs, name);
+            output.levels = utils::load_string_vector(utils::check_and_open_group(obs, "__categories"), name);
+        }
+    } else {
+        throw std::runtime_error("failed to find '" + name + "' in 'obs'");
+    }
+
+    return output;
+}
+
+/*
+ * Using the fewest significant digits that still round-trip, so that integer
+ * IDs like 1234567 are printed in full (rather than as "1.23457e+06") while
+ * 0.1 is still printed as "0.1".
+ */
+inline std::string format_number(double x) {
+    std::string output;
+    for (int digits = std::numeric_limits<double>::digits10; digits <= std::numeric_limits<double>::max_digits10; ++digits) {
+        std::ostringstream converted;
+        converted << std::setprecision(digits) << x;
+        output = converted.str();
+        if (std::strtod(output.c_str(), NULL) == x) {
+            break;
+        }
+    }
+    return output;
+}
+
+inline Factor load_annotation_factor(const embedded::Location& location, const std::string& name) {
+    auto table = annotations::read(location);
+    for (auto& col : table.columns) {
+        if (col.name != name) {
+            continue;
+        }
+        if (col.numeric) {
+            // Treating each unique number as a separate sample.
+            Factor output;
+            interning::Dictionary dictionary;
+            for (auto x : col.numbers) {
+                if (std::isnan(x)) {
+                    output.codes.push_back(-1);
+                } else {
+                    output.codes.push_back(dictionary.intern(format_number(x)));
+                }
+            }
+            output.levels = dictionary.levels();
+            return output;
+        }
+        return Factor{ std::move(col.codes), std::move(col.levels) };
+    }
+    throw std::runtime_error("failed to find '" + name + "' in the annotation file");
+}
+
+template<class Function>
+void check_and_apply(const H5::DataSet& discards, hsize_t num_cells, hsize_t block_size, Function fun) {
+    auto dims = utils::get_dimensions(discards);
+    if (dims.size() != 1 || dims[0] != num_cells) {
+        throw std::runtime_error("discard vector should be of length equal to the number of cells");
+    }
+    streaming::for_each_block<int>(discards, block_size, fun);
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Subset the per-cell samples to the cells that were retained after QC filtering.
+ *
+ * @param all Sample of each cell before filtering.
+ * @param discards Handle to the discard vector, usually from `quality_control::open_discard_vector()`.
+ * @param block_size Number of cells to process in each block.
+ *
+ * @return Sample of each cell after filtering.
+ */
+inline std::vector<int> filter(const std::vector<int>& all, const H5::DataSet& discards, hsize_t block_size = 65536) {
+    std::vector<int> output;
+    output.reserve(all.size());
+    check_and_apply(discards, all.size(), block_size, [&](hsize_t start, hsize_t len, const int* ptr) -> void {
+        for (hsize_t i = 0; i < len; ++i) {
+            if (!ptr[i]) {
+                output.push_back(all[start + i]);
+            }
+        }
+    });
+    output.shrink_to_fit();
+    return output;
+}
+
+/**
+ * Materialize the sample of origin for each cell.
+ *
+ * - For multiple matrices, each matrix is a sample, in the order of `sample_groups` and `sample_names` in the `inputs` parameters.
+ *   The number of cells in each matrix is obtained from the header of the `"mtx"` file for the `"MatrixMarket"` format,
+ *   from `matrix/shape` for the `"10X"` format, or from the shape of `X` for the `"H5AD"` format.
+ * - For a single matrix with a `sample_factor`, the factor is taken from the `"annotations"` file for the `"MatrixMarket"` format,
+ *   or from the corresponding column of `obs` for the `"H5AD"` format.
+ *   Each level of the factor is a sample; missing values are not allowed.
+ * - Otherwise, all cells belong to a single sample, and the input files are not accessed.
+ *
+ * HDF5 input files are opened in place if they are standalone files, e.g., from `embedded::locate_in_directory()`, so only the required objects are read.
+ * HDF5 files embedded inside a `*.kana` file are loaded into memory in full, as they cannot be opened at an arbitrary offset.
+ * Similarly, `"annotations"` files are always read in full.
+ *
+ * Samples after QC filtering are obtained by removing the cells that were marked in the discard vector of the filtering step.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param files Location of each input file, in the same order as `inputs/parameters/files`,
+ * usually from `embedded::locate_in_kana()` or `embedded::locate_in_directory()`.
+ * This may be empty for single-sample datasets.
+ * @param details Details about the dataset, from `inputs::validate()`.
+ * @param version Version of the state file.
+ * @param options Further options.
+ *
+ * @return The sample of each cell before and after filtering.
+ * An error is raised if the input files are inconsistent with `details`.
+ */
+inline Blocks materialize(const H5::H5File& handle, const std::vector<embedded::Location>& files, const inputs::Details& details, int version, const Options& options = Options()) {
+    auto phandle = utils::check_and_open_group(utils::check_and_open_group(handle, "inputs"), "parameters");
+    auto fhandle = utils::check_and_open_dataset(phandle, "format", H5T_STRING);
+    bool multi_matrix = (fhandle.getSpace().getSimpleExtentNdims() != 0);
+    hsize_t num_cells = details.num_cells;
+
+    Blocks output;
+    if (multi_matrix) {
+        auto formats = utils::load_string_vector(fhandle);
+        auto runs = utils::load_integer_vector(phandle, "sample_groups");
+        output.names = utils::load_string_vector(phandle, "sample_names");
+        output.all.reserve(num_cells);
+
+        auto fihandle = utils::check_and_open_group(phandle, "files");
+        int sofar = 0;
+        if (runs.size() == 1 && output.names.size() == 1) {
+            // No need to count anything if there's only one matrix.
+            output.all.resize(num_cells);
+            runs.clear();
+        }
+        for (size_t s = 0; s < runs.size(); ++s) {
+            hsize_t ncells = 0;
+            bool found = false;
+            try {
+                for (int f = 0; f < runs[s]; ++f, ++sofar) {
+                    if (static_cast<size_t>(sofar) >= files.size()) {
+                        throw std::runtime_error("no location supplied for file " + std::to_string(sofar));
+                    }
+                    auto type = utils::load_string(utils::check_and_open_group(fihandle, std::to_string(sofar)), "type");
+                    if (formats[s] == "MatrixMarket" && type == "mtx") {
+                        ncells = count_mtx_columns(files[sofar], options.header_size);
+                        found = true;
+                    } else if ((formats[s] == "10X" || formats[s] == "H5AD") && type == "h5") {
+                        ncells = count_h5_columns(files[sofar], formats[s]);
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    throw std::runtime_error("unsupported format '" + formats[s] + "'");
+                }
+            } catch (std::exception& e) {
+                throw utils::combine_errors(e, "failed to count cells for sample '" + output.names[s] + "'");
+            }
+            output.all.insert(output.all.end(), ncells, static_cast<int>(s));
+        }
+
+    } else if (phandle.exists("sample_factor")) {
+        auto format = utils::load_string(fhandle);
+        auto factor = utils::load_string(phandle, "sample_factor");
+        auto fihandle = utils::check_and_open_group(phandle, "files");
+        size_t nfiles = fihandle.getNumObjs();
+        if (files.size() < nfiles) {
+            throw std::runtime_error("no location supplied for file " + std::to_string(files.size()));
+        }
+
+        Factor loaded;
+        bool found = false;
+        try {
+            for (size_t f = 0; f < nfiles && !found; ++f) {
+                auto type = utils::load_string(utils::check_and_open_group(fihandle, std::to_string(f)), "type");
+                if (format == "MatrixMarket" && type == "annotations") {
+                    loaded = load_annotation_factor(files[f], factor);
+                    found = true;
+                } else if (format == "H5AD" && type == "h5") {
+                    loaded = load_h5ad_factor(files[f], factor);
+                    found = true;
+                }
+            }
+            if (!found) {
+                throw std::runtime_error("no annotations available for format '" + format + "'");
+            }
+        } catch (std::exception& e) {
+            throw utils::combine_errors(e, "failed to load the sample factor '" + factor + "'");
+        }
+
+        for (auto c : loaded.codes) {
+            if (c < 0 || static_cast<size_t>(c) >= loaded.levels.size()) {
+                throw std::runtime_error("sample factor '" + factor + "' should not contain missing or out-of-range values");
+            }
+        }
+        output.names = std::move(loaded.levels);
+        output.all = std::move(loaded.codes);
+
+    } else {
+        output.names.resize(1);
+        output.all.resize(num_cells);
+    }
+
+    if (output.all.size() != num_cells) {
+        throw std::runtime_error("number of cells in the input files (" + std::to_string(output.all.size()) + ") is not equal to the number of cells in 'inputs'");
+    }
+    if (output.num_blocks() != details.num_samples) {
+        throw std::runtime_error("number of samples in the input files (" + std::to_string(output.num_blocks()) + ") is not equal to the number of samples in 'inputs'");
+    }
+
+    auto discards = quality_control::open_discard_vector(handle, details.modalities, version);
+    output.filtered = filter(output.all, discards, options.block_size);
+    return output;
+}
+
+/**
+ * Tabulate the cluster assignments against the samples in a single pass over the cells.
+ *
+ * @param clusters Pointer to an array of length `n`, containing the cluster assignment of each cell as integers in `[0, num_clusters)`.
+ * @param blocks Pointer to an array of length `n`, containing the sample of each cell as integers in `[0, num_blocks)`.
+ * @param n Number of cells.
+ * @param num_clusters Number of clusters.
+ * @param num_blocks Number of samples.
+ *
+ * @return Row-major matrix with one row per cluster and one column per sample, containing the number of cells in each combination.
+ */
+inline std::vector<hsize_t> contingency(const int* clusters, const int* blocks, size_t n, int num_clusters, int num_blocks) {
+    std::vector<hsize_t> output(static_cast<size_t>(num_clusters) * num_blocks);
+    for (size_t i = 0; i < n; ++i) {
+        auto c = clusters[i];
+        auto b = blocks[i];
+        if (c < 0 || c >= num_clusters || b < 0 || b >= num_blocks) {
+            throw std::runtime_error("cluster and sample assignments should be non-negative and less than the number of clusters and samples, respectively");
+        }
+        ++output[static_cast<size_t>(c) * num_blocks + b];
+    }
+    return output;
+}
+
+/**
+ * Tabulate the clusters in a state file against the samples after QC filtering.
+ * The cluster assignments are read in blocks, so they are never fully loaded into memory.
+ *
+ * @param clusters Handle to an integer dataset of cluster assignments, e.g., `snn_graph_cluster/results/clusters`.
+ * @param num_clusters Number of clusters.
+ * @param blocks Samples of each cell, from `materialize()`.
+ * @param block_size Number of cells to process in each block.
+ *
+ * @return Row-major matrix with one row per cluster and one column per sample, containing the number of cells in each combination.
+ */
+inline std::vector<hsize_t> contingency(const H5::DataSet& clusters, int num_clusters, const Blocks& blocks, hsize_t block_size = 65536) {
+    auto dims = utils::get_dimensions(clusters);
+    if (dims.size() != 1 || dims[0] != blocks.filtered.size()) {
+        throw std::runtime_error("cluster assignments should be of length equal to the number of cells after filtering");
+    }
+
+    int nblocks = blocks.num_blocks();
+    std::vector<hsize_t> output(static_cast<size_t>(num_clusters) * nblocks);
+    streaming::for_each_block<int>(clusters, block_size, [&](hsize_t start, hsize_t len, const int* ptr) -> void {
+        auto partial = contingency(ptr, blocks.filtered.data() + start, len, num_clusters, nblocks);
+        for (size_t i = 0; i < output.size(); ++i) {
+            output[i] += partial[i];
+        }
+    });
+
+    return output;
+}
+
+}
+
+}
+
+#endif
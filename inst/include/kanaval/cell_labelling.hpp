@@ -3,8 +3,12 @@
 
 #include "H5Cpp.h"
 #include <vector>
+#include <string>
+#include <algorithm>
 #include <unordered_set>
+#include <unordered_map>
 #include "utils.hpp"
+#include "interning.hpp"
 
 /**
  * @file cell_labelling.hpp
@@ -16,6 +20,83 @@ namespace kanaval {
 
 namespace cell_labelling {
 
+/**
+ * @brief Registry of the label vocabularies of the reference datasets.
+ *
+ * Reference and label names are interned into integer IDs when they are added to the registry,
+ * so that checking a label against a reference only involves integer comparisons.
+ * A single registry can be constructed once and reused to validate any number of files.
+ */
+class Registry {
+public:
+    /**
+     * Add a reference to the registry.
+     * If the reference already exists, its vocabulary is replaced.
+     *
+     * @param reference Name of the reference dataset, e.g., `"BlueprintEncode"`.
+     * @param labels Labels in the reference dataset.
+     */
+    void add(const std::string& reference, const std::vector<std::string>& labels) {
+        std::vector<int> ids;
+        ids.reserve(labels.size());
+        for (const auto& l : labels) {
+            ids.push_back(label_ids.intern(l));
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        auto rit = reference_ids.find(reference);
+        if (rit == reference_ids.end()) {
+            reference_ids.emplace(reference, vocabularies.size());
+            vocabularies.push_back(std::move(ids));
+        } else {
+            vocabularies[rit->second] = std::move(ids);
+        }
+    }
+
+    /**
+     * @return Number of references in the registry.
+     */
+    size_t num_references() const {
+        return vocabularies.size();
+    }
+
+    /**
+     * @param reference Name of the reference dataset.
+     * @return ID of the reference, or -1 if it is not in the registry.
+     */
+    int reference_id(const std::string& reference) const {
+        auto it = reference_ids.find(reference);
+        return (it == reference_ids.end() ? -1 : it->second);
+    }
+
+    /**
+     * @param label Name of a label.
+     * @return ID of the label, or -1 if it is not present in any reference.
+     */
+    int label_id(std::string_view label) const {
+        return label_ids.find(label);
+    }
+
+    /**
+     * @param reference ID of the reference, from `reference_id()`.
+     * @param label ID of the label, from `label_id()`.
+     * @return Whether the label is part of the reference's vocabulary.
+     */
+    bool contains(int reference, int label) const {
+        if (reference < 0 || label < 0) {
+            return false;
+        }
+        const auto& vocab = vocabularies[reference];
+        return std::binary_search(vocab.begin(), vocab.end(), label);
+    }
+
+private:
+    std::unordered_map<std::string, int> reference_ids;
+    interning::Dictionary label_ids;
+    std::vector<std::vector<int> > vocabularies;
+};
+
 /**
  * @cond
  */
@@ -65,6 +146,44 @@ inline void validate_results(const H5::Group& handle, const std::unordered_set<s
 
     return;
 }
+
+inline void validate_vocabulary(const H5::Group& handle, const Registry& registry) {
+    auto rhandle = utils::check_and_open_group(handle, "results");
+    auto perhandle = utils::check_and_open_group(rhandle, "per_reference");
+
+    size_t nchilds = perhandle.getNumObjs();
+    std::vector<std::string> present;
+    for (size_t a = 0; a < nchilds; ++a) {
+        std::string name = perhandle.getObjnameByIdx(a);
+        int ref = registry.reference_id(name);
+        if (ref < 0) {
+            throw std::runtime_error("reference '" + name + "' in 'results/per_reference' is not in the registry");
+        }
+        present.push_back(name);
+
+        // Each unique label is only looked up in the registry once.
+        interning::Dictionary dictionary;
+        auto codes = interning::load_codes(perhandle, name, dictionary);
+        std::vector<unsigned char> valid(dictionary.size());
+        for (size_t d = 0; d < dictionary.size(); ++d) {
+            valid[d] = registry.contains(ref, registry.label_id(dictionary.get(d)));
+        }
+        for (auto c : codes) {
+            if (!valid[c]) {
+                throw std::runtime_error("label '" + dictionary.get(c) + "' in 'results/per_reference/" + name + "' is not present in the reference");
+            }
+        }
+    }
+
+    if (nchilds > 1) {
+        auto integrated = utils::load_string_vector(rhandle, "integrated");
+        for (const auto& i : integrated) {
+            if (std::find(present.begin(), present.end(), i) == present.end()) {
+                throw std::runtime_error("reference '" + i + "' in 'integrated' has no results in 'results/per_reference'");
+            }
+        }
+    }
+}
 /**
  * @endcond
  */
@@ -94,13 +213,19 @@ inline void validate_results(const H5::Group& handle, const std::unordered_set<s
  * - `integrated`: a string dataset of length equal to the number of clusters.
  *   This specifies the reference with the top-scoring label for each cluster, after integrating the results of all per-reference classifications.
  *
+ * If a `registry` is supplied, each child of `per_reference` should also be a reference in the registry,
+ * and each of its labels should be part of that reference's vocabulary.
+ * Each entry of `integrated` should be the name of a child of `per_reference`.
+ *
  * <HR>
  * @param handle An open HDF5 file handle.
  * @param num_clusters Number of clusters to be labelled.
+ * @param registry Pointer to a registry of reference vocabularies.
+ * If `NULL`, labels are not checked against the references.
  * 
  * @return If the format is invalid, an error is raised.
  */
-inline void validate(const H5::H5File& handle, int num_clusters) {
+inline void validate(const H5::H5File& handle, int num_clusters, const Registry* registry = NULL) {
     auto nhandle = utils::check_and_open_group(handle, "cell_labelling");
 
     std::unordered_set<std::string> refs;
@@ -112,6 +237,9 @@ inline void validate(const H5::H5File& handle, int num_clusters) {
 
     try {
         validate_results(nhandle, refs, num_clusters);
+        if (registry) {
+            validate_vocabulary(nhandle, *registry);
+        }
     } catch (std::exception& e) {
         throw utils::combine_errors(e, "failed to retrieve results from 'cell_labelling'");
     }
@@ -0,0 +1,296 @@
+#ifndef KANAVAL_CELL_TABLE_HPP
+#define KANAVAL_CELL_TABLE_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "utils.hpp"
+#include "misc.hpp"
+#include "inspect.hpp"
+#include "streaming.hpp"
+#include "arrow_ipc.hpp"
+#include "blocks.hpp"
+
+/**
+ * @file cell_table.hpp
+ *
+ * @brief Export per-cell results as a columnar table.
+ */
+
+namespace kanaval {
+
+namespace cell_table {
+
+/**
+ * @brief Options for `export_arrow()`.
+ */
+struct Options {
+    /**
+     * Maximum number of PCs to include in the table.
+     */
+    int num_pcs = 10;
+
+    /**
+     * Number of cells in each record batch.
+     * Larger values improve throughput at the cost of memory usage.
+     */
+    hsize_t block_size = 65536;
+
+    /**
+     * Location of each input file, in the same order as `inputs/parameters/files`,
+     * usually from `embedded::locate_in_kana()` or `embedded::locate_in_directory()`.
+     * This is used to obtain the sample of origin for each cell with `blocks::materialize()`,
+     * and may be empty for single-sample datasets.
+     */
+    std::vector<embedded::Location> files;
+};
+
+/**
+ * @cond
+ */
+struct Source {
+    Source(H5::DataSet d, std::vector<std::string> n, arrow_ipc::Type t, bool f, hsize_t c = 0) :
+        dataset(std::move(d)), names(std::move(n)), type(t), filtered(f), ncols(c) {}
+
+    H5::DataSet dataset;
+    std::vector<std::string> names;
+    arrow_ipc::Type type;
+    bool filtered;
+    hsize_t ncols;
+
+    std::vector<double> dbuffer;
+    std::vector<int> ibuffer;
+    std::vector<std::vector<double> > dcolumns;
+    std::vector<std::vector<int> > icolumns;
+};
+
+inline void add_source(std::vector<Source>& sources, const H5::Group& handle, const std::string& step, const std::string& path, const std::string& name, bool filtered) {
+    if (!inspect::has_group(handle, step)) {
+        return;
+    }
+    auto shandle = handle.openGroup(step);
+    if (!shandle.exists(path) || shandle.childObjType(path) != H5O_TYPE_DATASET) {
+        return;
+    }
+
+    auto dhandle = shandle.openDataSet(path);
+    auto type = (dhandle.getTypeClass() == H5T_INTEGER ? arrow_ipc::Type::INT32 : arrow_ipc::Type::FLOAT64);
+    sources.emplace_back(dhandle, std::vector<std::string>{ name }, type, filtered);
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Export the per-cell results in a state file to an Arrow IPC file, i.e., a Feather V2 file.
+ * The table contains one row for each cell in the unfiltered dataset, with the following columns:
+ *
+ * - `cell`: 32-bit integer containing the index of the cell in the unfiltered dataset.
+ * - `discard`: boolean indicating whether the cell was removed during quality filtering.
+ * - `sample`: string containing the name of the sample of origin for each cell, from `blocks::materialize()`.
+ *   For single-sample datasets, this is an empty string for all cells.
+ * - `sums`, `detected` and `proportion`: the RNA-based QC metrics from `quality_control::validate()`.
+ * - `adt_sums`, `adt_detected` and `adt_igg_total`: the ADT-based QC metrics from `adt_quality_control::validate()`, if ADTs are present.
+ * - `cluster`: 32-bit integer containing the cluster assignment from the chosen clustering in `choose_clustering::validate()`.
+ * - `tsne_x`, `tsne_y`, `umap_x` and `umap_y`: the coordinates from `tsne::validate()` and `umap::validate()`.
+ * - `PC1`, `PC2`, etc.: the first `Options::num_pcs` PCs from `pca::validate()` (or `adt_pca::validate()`, for ADT-only datasets).
+ *
+ * Columns derived from results after quality filtering (i.e., clusters, coordinates and PCs) are missing for the discarded cells.
+ *
+ * The table is written in record batches of `Options::block_size` cells, where each batch is written column by column.
+ * Each dataset in the state file is read exactly once and in blocks, so memory usage does not scale with the number of cells.
+ * The only exception is the sample of origin, which is materialized for all cells before writing the table.
+ * The state file is assumed to have been validated with `validate()`.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param path Path to the output Arrow file.
+ * @param version Version of the state file.
+ * @param options Further options.
+ *
+ * @return The Arrow file is created at `path`.
+ */
+inline void export_arrow(const H5::H5File& handle, const std::string& path, int version, const Options& options = Options()) {
+    auto summary = inspect::inspect(handle, version);
+    const auto& modalities = summary.inputs.modalities;
+    hsize_t num_cells = summary.inputs.num_cells;
+    hsize_t num_kept = summary.num_filtered_cells;
+    bool rna_in_use = std::find(modalities.begin(), modalities.end(), std::string("RNA")) != modalities.end();
+    bool adt_in_use = std::find(modalities.begin(), modalities.end(), std::string("ADT")) != modalities.end();
+
+    auto discards = quality_control::open_discard_vector(handle, modalities, version);
+
+    blocks::Blocks samples;
+    try {
+        inputs::Details details;
+        details.modalities = modalities;
+        details.num_features = summary.inputs.num_features;
+        details.num_cells = summary.inputs.num_cells;
+        details.num_samples = summary.inputs.num_samples;
+        blocks::Options bopt;
+        bopt.block_size = options.block_size;
+        samples = blocks::materialize(handle, options.files, details, version, bopt);
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to obtain the sample of origin for each cell");
+    }
+
+    std::vector<Source> sources;
+    add_source(sources, handle, "quality_control", "results/metrics/sums", "sums", false);
+    add_source(sources, handle, "quality_control", "results/metrics/detected", "detected", false);
+    add_source(sources, handle, "quality_control", "results/metrics/proportion", "proportion", false);
+    if (adt_in_use) {
+        add_source(sources, handle, "adt_quality_control", "results/metrics/sums", "adt_sums", false);
+        add_source(sources, handle, "adt_quality_control", "results/metrics/detected", "adt_detected", false);
+        add_source(sources, handle, "adt_quality_control", "results/metrics/igg_total", "adt_igg_total", false);
+    }
+
+    if (!summary.clustering_method.empty()) {
+        std::string step = (summary.clustering_method == "kmeans" ? "kmeans_cluster" : "snn_graph_cluster");
+        add_source(sources, handle, step, "results/clusters", "cluster", true);
+    }
+
+    for (std::string step : { "tsne", "umap" }) {
+        add_source(sources, handle, step, "results/x", step + "_x", true);
+        add_source(sources, handle, step, "results/y", step + "_y", true);
+    }
+
+    {
+        std::string step = (rna_in_use ? "pca" : "adt_pca");
+        const auto& pinfo = (rna_in_use ? summary.pca : summary.adt_pca);
+        int npcs = std::min(options.num_pcs, pinfo.num_pcs_stored);
+        if (npcs > 0) {
+            std::vector<std::string> names;
+            for (int p = 0; p < npcs; ++p) {
+                names.push_back("PC" + std::to_string(p + 1));
+            }
+            auto dhandle = utils::check_and_open_dataset(handle.openGroup(step), "results/pcs", H5T_FLOAT);
+            sources.emplace_back(dhandle, names, arrow_ipc::Type::FLOAT64, true, npcs);
+        }
+    }
+
+    for (const auto& src : sources) {
+        auto dims = utils::get_dimensions(src.dataset);
+        if (dims.empty() || dims[0] != (src.filtered ? num_kept : num_cells)) {
+            throw std::runtime_error("number of rows in '" + src.dataset.getObjName() + "' is not consistent with the number of cells");
+        }
+    }
+
+    std::vector<arrow_ipc::Column> columns;
+    columns.emplace_back("cell", arrow_ipc::Type::INT32);
+    columns.emplace_back("discard", arrow_ipc::Type::BOOL);
+    columns.emplace_back("sample", arrow_ipc::Type::UTF8);
+    for (const auto& src : sources) {
+        for (const auto& n : src.names) {
+            columns.emplace_back(n, src.type, src.filtered);
+        }
+    }
+    arrow_ipc::FileWriter writer(path, columns);
+
+    hsize_t block_size = std::max<hsize_t>(1, options.block_size);
+    std::vector<int> discard_buffer, cell_index;
+    std::vector<int32_t> sample_offsets;
+    std::string sample_chars;
+    std::vector<uint8_t> discard_bits, valid_bits;
+    std::vector<hsize_t> kept;
+    hsize_t filtered_position = 0;
+
+    for (hsize_t start = 0; start < num_cells; start += block_size) {
+        hsize_t len = std::min(block_size, num_cells - start);
+        discard_buffer.resize(len);
+        streaming::read_block(discards, start, len, 0, discard_buffer.data());
+
+        size_t nbytes = (len + 7) / 8;
+        discard_bits.assign(nbytes, 0);
+        valid_bits.assign(nbytes, 0);
+        cell_index.resize(len);
+        sample_offsets.resize(len + 1);
+        sample_chars.clear();
+        kept.clear();
+        for (hsize_t i = 0; i < len; ++i) {
+            cell_index[i] = start + i;
+            sample_offsets[i] = sample_chars.size();
+            sample_chars += samples.names[samples.all[start + i]];
+            if (discard_buffer[i]) {
+                discard_bits[i / 8] |= (1 << (i % 8));
+            } else {
+                valid_bits[i / 8] |= (1 << (i % 8));
+                kept.push_back(i);
+            }
+        }
+        sample_offsets[len] = sample_chars.size();
+
+        hsize_t num_present = kept.size();
+        if (filtered_position + num_present > num_kept) {
+            throw std::runtime_error("number of retained cells in the discard vector is greater than the number of filtered cells");
+        }
+
+        std::vector<arrow_ipc::ColumnData> data(3);
+        data[0].values = cell_index.data();
+        data[1].values = discard_bits.data();
+        data[2].values = sample_chars.data();
+        data[2].offsets = sample_offsets.data();
+
+        for (auto& src : sources) {
+            hsize_t nread = (src.filtered ? num_present : len);
+            hsize_t first = (src.filtered ? filtered_position : start);
+            size_t ncols = std::max<hsize_t>(1, src.ncols);
+
+            // Filtered results are spread out to their positions in the full table, leaving zeroes for the missing values.
+            auto expand = [&](const auto& buffer, auto& columns) -> void {
+                columns.resize(ncols);
+                for (size_t c = 0; c < ncols; ++c) {
+                    auto& current = columns[c];
+                    current.assign(len, 0);
+                    if (src.filtered) {
+                        for (hsize_t i = 0; i < num_present; ++i) {
+                            current[kept[i]] = buffer[i * ncols + c];
+                        }
+                    } else {
+                        for (hsize_t i = 0; i < len; ++i) {
+                            current[i] = buffer[i * ncols + c];
+                        }
+                    }
+                }
+            };
+
+            if (src.type == arrow_ipc::Type::INT32) {
+                src.ibuffer.resize(nread * ncols);
+                streaming::read_block(src.dataset, first, nread, src.ncols, src.ibuffer.data());
+                expand(src.ibuffer, src.icolumns);
+            } else {
+                src.dbuffer.resize(nread * ncols);
+                streaming::read_block(src.dataset, first, nread, src.ncols, src.dbuffer.data());
+                expand(src.dbuffer, src.dcolumns);
+            }
+
+            for (size_t c = 0; c < ncols; ++c) {
+                arrow_ipc::ColumnData current;
+                if (src.type == arrow_ipc::Type::INT32) {
+                    current.values = src.icolumns[c].data();
+                } else {
+                    current.values = src.dcolumns[c].data();
+                }
+                if (src.filtered && num_present < len) {
+                    current.validity = valid_bits.data();
+                    current.null_count = len - num_present;
+                }
+                data.push_back(current);
+            }
+        }
+
+        writer.write_batch(len, data);
+        filtered_position += num_present;
+    }
+
+    if (filtered_position != num_kept) {
+        throw std::runtime_error("number of retained cells in the discard vector is less than the number of filtered cells");
+    }
+
+    writer.close();
+}
+
+}
+
+}
+
+#endif
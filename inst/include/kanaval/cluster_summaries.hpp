@@ -0,0 +1,342 @@
+#ifndef KANAVAL_CLUSTER_SUMMARIES_HPP
+#define KANAVAL_CLUSTER_SUMMARIES_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include "utils.hpp"
+#include "streaming.hpp"
+#include "write_utils.hpp"
+
+/**
+ * @file cluster_summaries.hpp
+ *
+ * @brief Summarize the t-SNE or UMAP coordinates of each cluster for overview plots.
+ */
+
+namespace kanaval {
+
+namespace cluster_summaries {
+
+/**
+ * @brief Per-cluster summaries of a 2-dimensional embedding.
+ */
+struct Summaries {
+    /**
+     * Number of cells in each cluster.
+     */
+    std::vector<hsize_t> counts;
+
+    /**
+     * Row-major matrix with one row per cluster, containing the mean x- and y-coordinates of its cells.
+     * Values are NaN for empty clusters.
+     */
+    std::vector<double> centroids;
+
+    /**
+     * Row-major matrix with one row per cluster, containing the minimum x, maximum x, minimum y and maximum y-coordinates of its cells.
+     * Values are NaN for empty clusters.
+     */
+    std::vector<double> ranges;
+
+    /**
+     * @return Number of clusters.
+     */
+    size_t size() const {
+        return counts.size();
+    }
+};
+
+/**
+ * @cond
+ */
+struct Accumulator {
+    Accumulator(int nclusters) :
+        counts(nclusters),
+        sum_x(nclusters),
+        sum_y(nclusters),
+        min_x(nclusters, std::numeric_limits<double>::infinity()),
+        max_x(nclusters, -std::numeric_limits<double>::infinity()),
+        min_y(nclusters, std::numeric_limits<double>::infinity()),
+        max_y(nclusters, -std::numeric_limits<double>::infinity())
+    {}
+
+    std::vector<hsize_t> counts;
+    std::vector<double> sum_x, sum_y, min_x, max_x, min_y, max_y;
+    bool invalid = false;
+
+    void add(const double* x, const double* y, const int* clusters, size_t n) {
+        int nclusters = counts.size();
+        for (size_t i = 0; i < n; ++i) {
+            int c = clusters[i];
+            if (c < 0 || c >= nclusters) {
+                invalid = true;
+                return;
+            }
+            ++counts[c];
+            sum_x[c] += x[i];
+            sum_y[c] += y[i];
+            min_x[c] = std::min(min_x[c], x[i]);
+            max_x[c] = std::max(max_x[c], x[i]);
+            min_y[c] = std::min(min_y[c], y[i]);
+            max_y[c] = std::max(max_y[c], y[i]);
+        }
+    }
+
+    void merge(const Accumulator& other) {
+        invalid = invalid || other.invalid;
+        for (size_t c = 0; c < counts.size(); ++c) {
+            counts[c] += other.counts[c];
+            sum_x[c] += other.sum_x[c];
+            sum_y[c] += other.sum_y[c];
+            min_x[c] = std::min(min_x[c], other.min_x[c]);
+            max_x[c] = std::max(max_x[c], other.max_x[c]);
+            min_y[c] = std::min(min_y[c], other.min_y[c]);
+            max_y[c] = std::max(max_y[c], other.max_y[c]);
+        }
+    }
+
+    Summaries finish() const {
+        if (invalid) {
+            throw std::runtime_error("cluster assignments should be non-negative and less than the number of clusters");
+        }
+
+        Summaries output;
+        output.counts = counts;
+        size_t nclusters = counts.size();
+        output.centroids.resize(nclusters * 2, std::numeric_limits<double>::quiet_NaN());
+        output.ranges.resize(nclusters * 4, std::numeric_limits<double>::quiet_NaN());
+
+        for (size_t c = 0; c < nclusters; ++c) {
+            if (counts[c]) {
+                output.centroids[2 * c] = sum_x[c] / counts[c];
+                output.centroids[2 * c + 1] = sum_y[c] / counts[c];
+                double* rptr = output.ranges.data() + 4 * c;
+                rptr[0] = min_x[c];
+                rptr[1] = max_x[c];
+                rptr[2] = min_y[c];
+                rptr[3] = max_y[c];
+            }
+        }
+        return output;
+    }
+};
+
+// Reduce each thread's share of the cells into its own accumulator, to be merged by the caller.
+inline void reduce(const double* x, const double* y, const int* clusters, size_t n, std::vector<Accumulator>& partials) {
+    size_t nthreads = partials.size();
+    if (nthreads == 1) {
+        partials[0].add(x, y, clusters, n);
+        return;
+    }
+
+    size_t per_thread = (n + nthreads - 1) / nthreads;
+    std::vector<std::thread> workers;
+    workers.reserve(nthreads);
+    for (size_t t = 0, first = 0; first < n; ++t, first += per_thread) {
+        size_t len = std::min(per_thread, n - first);
+        workers.emplace_back([&](size_t thread, size_t start, size_t length) -> void {
+            partials[thread].add(x + start, y + start, clusters + start, length);
+        }, t, first, len);
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Compute per-cluster summaries from in-memory coordinates.
+ *
+ * @param x Pointer to an array of length `n`, containing the x-coordinates of each cell.
+ * @param y Pointer to an array of length `n`, containing the y-coordinates of each cell.
+ * @param clusters Pointer to an array of length `n`, containing the cluster assignment of each cell.
+ * @param n Number of cells.
+ * @param num_clusters Number of clusters.
+ * @param num_threads Number of threads to use.
+ *
+ * @return Summaries for each cluster.
+ */
+inline Summaries compute(const double* x, const double* y, const int* clusters, size_t n, int num_clusters, int num_threads = 1) {
+    std::vector<Accumulator> partials(std::max(1, num_threads), Accumulator(num_clusters));
+    reduce(x, y, clusters, n, partials);
+    for (size_t t = 1; t < partials.size(); ++t) {
+        partials[0].merge(partials[t]);
+    }
+    return partials[0].finish();
+}
+
+/**
+ * Compute per-cluster summaries in a single pass over the coordinates in the state file.
+ * The coordinates and cluster assignments are read in blocks, and each block is reduced in parallel while the main thread performs all HDF5 calls.
+ *
+ * @param results Handle to the `results` group of the `tsne` or `umap` step, containing the `x` and `y` datasets.
+ * @param clusters Handle to an integer dataset containing the cluster assignment of each cell, e.g., from `snn_graph_cluster`.
+ * @param num_clusters Number of clusters.
+ * @param num_threads Number of threads to use.
+ * @param block_size Number of cells in each block.
+ *
+ * @return Summaries for each cluster.
+ */
+inline Summaries compute(const H5::Group& results, const H5::DataSet& clusters, int num_clusters, int num_threads = 1, hsize_t block_size = 65536) {
+    auto xhandle = utils::check_and_open_dataset(results, "x", H5T_FLOAT);
+    auto yhandle = utils::check_and_open_dataset(results, "y", H5T_FLOAT);
+    auto dims = utils::get_dimensions(xhandle);
+    if (dims.size() != 1 || utils::get_dimensions(yhandle) != dims || utils::get_dimensions(clusters) != dims) {
+        throw std::runtime_error("'x', 'y' and the cluster assignments should be 1-dimensional datasets of the same length");
+    }
+
+    hsize_t ncells = dims[0];
+    block_size = std::max<hsize_t>(1, std::min(block_size, ncells));
+    std::vector<double> xbuffer(block_size), ybuffer(block_size);
+    std::vector<int> cbuffer(block_size);
+    instrumentation::Allocation tracked(block_size * (2 * sizeof(double) + sizeof(int)));
+
+    std::vector<Accumulator> partials(std::max(1, num_threads), Accumulator(num_clusters));
+    for (hsize_t start = 0; start < ncells; start += block_size) {
+        hsize_t len = std::min(block_size, ncells - start);
+        streaming::read_block(xhandle, start, len, 0, xbuffer.data());
+        streaming::read_block(yhandle, start, len, 0, ybuffer.data());
+        streaming::read_block(clusters, start, len, 0, cbuffer.data());
+        reduce(xbuffer.data(), ybuffer.data(), cbuffer.data(), len, partials);
+    }
+
+    for (size_t t = 1; t < partials.size(); ++t) {
+        partials[0].merge(partials[t]);
+    }
+    return partials[0].finish();
+}
+
+/**
+ * Create an empty `cluster_summaries` group in the results of the `tsne` or `umap` step, to be filled later by `write()`.
+ * This is useful when all objects must be created before the summaries can be computed, e.g., before SWMR writing starts in a `progress::Writer`.
+ *
+ * @param results Handle to the `results` group.
+ * @param num_clusters Number of clusters.
+ */
+inline void create(const H5::Group& results, hsize_t num_clusters) {
+    auto ghandle = results.createGroup("cluster_summaries");
+    ghandle.createDataSet("counts", H5::PredType::NATIVE_INT32, H5::DataSpace(1, &num_clusters));
+    hsize_t cdims[2] = { num_clusters, 2 };
+    ghandle.createDataSet("centroids", H5::PredType::NATIVE_DOUBLE, H5::DataSpace(2, cdims));
+    hsize_t rdims[2] = { num_clusters, 4 };
+    ghandle.createDataSet("ranges", H5::PredType::NATIVE_DOUBLE, H5::DataSpace(2, rdims));
+}
+
+/**
+ * Save per-cluster summaries into the results of the `tsne` or `umap` step.
+ * This fills the `cluster_summaries` group, creating it with `create()` if it does not already exist; see `validate()` for its contents.
+ *
+ * @param results Handle to the `results` group.
+ * @param summaries Summaries for each cluster, usually from `compute()`.
+ */
+inline void write(const H5::Group& results, const Summaries& summaries) {
+    hsize_t nclusters = summaries.size();
+    if (!results.exists("cluster_summaries")) {
+        create(results, nclusters);
+    }
+
+    auto ghandle = results.openGroup("cluster_summaries");
+    size_t ncl = nclusters;
+    auto khandle = utils::check_and_open_dataset(ghandle, "counts", H5T_INTEGER, { ncl });
+    auto chandle = utils::check_and_open_dataset(ghandle, "centroids", H5T_FLOAT, { ncl, 2 });
+    auto rhandle = utils::check_and_open_dataset(ghandle, "ranges", H5T_FLOAT, { ncl, 4 });
+    if (nclusters) {
+        std::vector<int> counts(summaries.counts.begin(), summaries.counts.end());
+        khandle.write(counts.data(), H5::PredType::NATIVE_INT);
+        chandle.write(summaries.centroids.data(), H5::PredType::NATIVE_DOUBLE);
+        rhandle.write(summaries.ranges.data(), H5::PredType::NATIVE_DOUBLE);
+    }
+}
+
+/**
+ * Check the optional `cluster_summaries` group in the results of the `tsne` or `umap` step.
+ * If present, `cluster_summaries` should contain:
+ *
+ * - `counts`: an integer dataset of length equal to the number of clusters, containing the number of cells in each cluster.
+ *   Counts should be non-negative and sum to the number of cells.
+ * - `centroids`: a float dataset with one row per cluster and 2 columns, containing the mean x- and y-coordinates of the cells in each cluster.
+ * - `ranges`: a float dataset with one row per cluster and 4 columns, containing the minimum x, maximum x, minimum y and maximum y-coordinates of the cells in each cluster.
+ *
+ * For empty clusters, the corresponding rows of `centroids` and `ranges` should be NaN.
+ * Otherwise, each centroid should lie within the corresponding ranges, up to a relative tolerance for floating-point error.
+ *
+ * @param results Handle to the `results` group.
+ * @param num_cells Number of cells in the dataset after any quality filtering is applied.
+ * @param cluster_sizes Pointer to the number of cells in each cluster of the chosen clustering.
+ * If provided, `counts` should be equal to this vector.
+ * If `NULL`, `counts` is only checked against `num_cells`.
+ *
+ * @return If the format is invalid, an error is raised.
+ */
+inline void validate(const H5::Group& results, int num_cells, const std::vector<int>* cluster_sizes = NULL) {
+    if (!results.exists("cluster_summaries")) {
+        return;
+    }
+    auto handle = utils::check_and_open_group(results, "cluster_summaries");
+
+    auto counts = utils::load_integer_vector(handle, "counts");
+    size_t nclusters = counts.size();
+    if (cluster_sizes) {
+        if (nclusters != cluster_sizes->size()) {
+            throw std::runtime_error("length of 'counts' should be equal to the number of clusters");
+        }
+        for (size_t c = 0; c < nclusters; ++c) {
+            if (counts[c] != (*cluster_sizes)[c]) {
+                throw std::runtime_error("'counts' for cluster " + std::to_string(c) + " should be equal to its number of cells");
+            }
+        }
+    }
+
+    long long total = 0;
+    for (auto c : counts) {
+        if (c < 0) {
+            throw std::runtime_error("'counts' should contain non-negative values");
+        }
+        total += c;
+    }
+    if (total != num_cells) {
+        throw std::runtime_error("'counts' should sum to the number of cells");
+    }
+
+    std::vector<double> centroids(nclusters * 2), ranges(nclusters * 4);
+    auto chandle = utils::check_and_open_dataset(handle, "centroids", H5T_FLOAT, { nclusters, 2 });
+    auto rhandle = utils::check_and_open_dataset(handle, "ranges", H5T_FLOAT, { nclusters, 4 });
+    if (nclusters) {
+        chandle.read(centroids.data(), H5::PredType::NATIVE_DOUBLE);
+        rhandle.read(ranges.data(), H5::PredType::NATIVE_DOUBLE);
+    }
+
+    for (size_t c = 0; c < nclusters; ++c) {
+        const double* cptr = centroids.data() + 2 * c;
+        const double* rptr = ranges.data() + 4 * c;
+        if (counts[c] == 0) {
+            if (!std::isnan(cptr[0]) || !std::isnan(cptr[1]) || std::any_of(rptr, rptr + 4, [](double v) -> bool { return !std::isnan(v); })) {
+                throw std::runtime_error("summaries for empty cluster " + std::to_string(c) + " should be NaN");
+            }
+            continue;
+        }
+
+        // Allowing for round-off in the mean, e.g., three cells at 0.1 have a mean of 0.10000000000000002.
+        // Negated comparisons so that NaNs are also caught.
+        auto within = [](double val, double lower, double upper) -> bool {
+            double tol = 1e-6 * std::max(std::abs(lower), std::abs(upper));
+            return lower - tol <= val && val <= upper + tol;
+        };
+        if (!(within(cptr[0], rptr[0], rptr[1]) && within(cptr[1], rptr[2], rptr[3]))) {
+            throw std::runtime_error("centroid of cluster " + std::to_string(c) + " should lie within its ranges");
+        }
+    }
+}
+
+}
+
+}
+
+#endif
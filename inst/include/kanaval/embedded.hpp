@@ -0,0 +1,275 @@
+#ifndef KANAVAL_EMBEDDED_HPP
+#define KANAVAL_EMBEDDED_HPP
+
+#include "H5Cpp.h"
+#include "zlib.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include "utils.hpp"
+
+/**
+ * @file embedded.hpp
+ *
+ * @brief Access the input files embedded inside a `*.kana` file.
+ */
+
+namespace kanaval {
+
+namespace embedded {
+
+/**
+ * @brief Information about an embedded input file.
+ */
+struct FileInfo {
+    /**
+     * Type of the file, e.g., `"mtx"`, `"genes"`, `"annotations"` or `"h5"`.
+     */
+    std::string type;
+
+    /**
+     * Name of the file as it was provided to **kana**.
+     */
+    std::string name;
+
+    /**
+     * Offset of the file from the start of the embedded section.
+     */
+    hsize_t offset = 0;
+
+    /**
+     * Size of the file in bytes.
+     */
+    hsize_t size = 0;
+};
+
+/**
+ * @brief Location of a file's bytes on disk.
+ */
+struct Location {
+    /**
+     * Path to the file containing the bytes.
+     */
+    std::string path;
+
+    /**
+     * Offset of the first byte in `path`.
+     */
+    hsize_t offset = 0;
+
+    /**
+     * Number of bytes.
+     */
+    hsize_t size = 0;
+};
+
+/**
+ * @param handle Open handle to a HDF5 state file.
+ * The input files should be embedded, see `inputs::validate()` for details.
+ *
+ * @return Information about each embedded input file, in the same order as `inputs/parameters/files`.
+ */
+inline std::vector<FileInfo> list_files(const H5::Group& handle) {
+    auto fhandle = utils::check_and_open_group(utils::check_and_open_group(utils::check_and_open_group(handle, "inputs"), "parameters"), "files");
+    size_t nfiles = fhandle.getNumObjs();
+    std::vector<FileInfo> output(nfiles);
+
+    for (size_t i = 0; i < nfiles; ++i) {
+        try {
+            auto cur = utils::check_and_open_group(fhandle, std::to_string(i));
+            auto& info = output[i];
+            info.type = utils::load_string(cur, "type");
+            info.name = utils::load_string(cur, "name");
+            info.offset = utils::load_integer_scalar<hsize_t>(cur, "offset");
+            info.size = utils::load_integer_scalar<hsize_t>(cur, "size");
+        } catch (std::exception& e) {
+            throw utils::combine_errors(e, "failed to retrieve information for embedded file " + std::to_string(i));
+        }
+    }
+
+    return output;
+}
+
+/**
+ * Find the start of the embedded files in a `*.kana` file.
+ * This is preceded by a 24-byte header (containing the embedding type, format version and the size of the state file) and the state file itself.
+ *
+ * @param path Path to a `*.kana` file with embedded inputs.
+ *
+ * @return Offset of the first byte of the embedded files from the start of `path`.
+ */
+inline hsize_t kana_data_offset(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("failed to open '" + path + "'");
+    }
+
+    unsigned char header[24];
+    input.read(reinterpret_cast<char*>(header), 24);
+    if (input.gcount() != 24) {
+        throw std::runtime_error("'" + path + "' is too short to be a kana file");
+    }
+
+    auto decode = [&](int start) -> hsize_t {
+        hsize_t value = 0;
+        for (int i = 7; i >= 0; --i) {
+            value = (value << 8) | header[start + i];
+        }
+        return value;
+    };
+
+    if (decode(0) != 0) {
+        throw std::runtime_error("'" + path + "' does not contain embedded files");
+    }
+    return 24 + decode(16);
+}
+
+/**
+ * @param files Information about the embedded files, usually from `list_files()`.
+ * @param path Path to a `*.kana` file with embedded inputs.
+ *
+ * @return Location of each file inside `path`.
+ */
+inline std::vector<Location> locate_in_kana(const std::vector<FileInfo>& files, const std::string& path) {
+    hsize_t start = kana_data_offset(path);
+    std::vector<Location> output;
+    output.reserve(files.size());
+    for (const auto& f : files) {
+        output.push_back(Location{ path, start + f.offset, f.size });
+    }
+    return output;
+}
+
+/**
+ * @param files Information about the embedded files, usually from `list_files()`.
+ * @param dir Path to a directory containing the files split from a `*.kana` file, where each file is named after its index in `files`.
+ *
+ * @return Location of each file inside `dir`.
+ */
+inline std::vector<Location> locate_in_directory(const std::vector<FileInfo>& files, const std::string& dir) {
+    std::vector<Location> output;
+    output.reserve(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        output.push_back(Location{ dir + "/" + std::to_string(i), 0, files[i].size });
+    }
+    return output;
+}
+
+/**
+ * @param location Location of a file.
+ * @param start Offset of the first byte to read, relative to the start of the file.
+ * @param len Number of bytes to read.
+ * This is truncated to the end of the file.
+ *
+ * @return The requested bytes.
+ */
+inline std::string read_bytes(const Location& location, hsize_t start, hsize_t len) {
+    if (start >= location.size) {
+        return std::string();
+    }
+    len = std::min(len, location.size - start);
+
+    std::ifstream input(location.path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("failed to open '" + location.path + "'");
+    }
+    input.seekg(location.offset + start);
+
+    std::string output(len, '\0');
+    input.read(&output[0], len);
+    if (static_cast<hsize_t>(input.gcount()) != len) {
+        throw std::runtime_error("failed to read " + std::to_string(len) + " bytes from '" + location.path + "'");
+    }
+    return output;
+}
+
+/**
+ * @param location Location of a file.
+ * @return All bytes of the file.
+ */
+inline std::string read_bytes(const Location& location) {
+    return read_bytes(location, 0, location.size);
+}
+
+/**
+ * @param bytes Contents of a file.
+ * @return Whether the contents are Gzip-compressed.
+ */
+inline bool is_gzip(const std::string& bytes) {
+    return bytes.size() >= 2 && static_cast<unsigned char>(bytes[0]) == 0x1f && static_cast<unsigned char>(bytes[1]) == 0x8b;
+}
+
+/**
+ * @param bytes Gzip-compressed contents of a file, possibly containing multiple members.
+ * @return The decompressed contents.
+ */
+inline std::string gunzip(const std::string& bytes) {
+    z_stream strm{};
+    if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK) {
+        throw std::runtime_error("failed to initialize the Gzip decompressor");
+    }
+
+    std::string output;
+    std::vector<char> buffer(1 << 16);
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(bytes.data()));
+    strm.avail_in = bytes.size();
+
+    while (true) {
+        strm.next_out = reinterpret_cast<Bytef*>(buffer.data());
+        strm.avail_out = buffer.size();
+        int ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            inflateEnd(&strm);
+            throw std::runtime_error("failed to decompress Gzip-compressed contents");
+        }
+        output.append(buffer.data(), buffer.size() - strm.avail_out);
+
+        if (ret == Z_STREAM_END) {
+            if (strm.avail_in == 0) {
+                break;
+            }
+            inflateReset(&strm); // concatenated members.
+        } else if (strm.avail_in == 0 && strm.avail_out != 0) {
+            inflateEnd(&strm);
+            throw std::runtime_error("truncated Gzip-compressed contents");
+        }
+    }
+
+    inflateEnd(&strm);
+    return output;
+}
+
+/**
+ * @param location Location of a text file, possibly Gzip-compressed.
+ * @return The decompressed contents of the file.
+ */
+inline std::string read_text(const Location& location) {
+    auto bytes = read_bytes(location);
+    if (is_gzip(bytes)) {
+        return gunzip(bytes);
+    }
+    return bytes;
+}
+
+/**
+ * Open an embedded HDF5 file (e.g., for the `"10X"` or `"H5AD"` formats) from its bytes, without writing it to disk.
+ *
+ * @param bytes Contents of a HDF5 file.
+ * This should not be modified or destroyed while the returned file handle is in use.
+ * @param name Name of the file, used in error messages.
+ *
+ * @return Handle to the in-memory HDF5 file.
+ */
+inline H5::H5File open_hdf5(const std::string& bytes, const std::string& name = "embedded") {
+    H5::FileAccPropList fapl;
+    H5Pset_fapl_core(fapl.getId(), 1 << 20, false);
+    H5Pset_file_image(fapl.getId(), const_cast<char*>(bytes.data()), bytes.size());
+    return H5::H5File(name, H5F_ACC_RDONLY, H5::FileCreatPropList::DEFAULT, fapl);
+}
+
+}
+
+}
+
+#endif
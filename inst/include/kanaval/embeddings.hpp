@@ -0,0 +1,278 @@
+#ifndef KANAVAL_EMBEDDINGS_HPP
+#define KANAVAL_EMBEDDINGS_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include "utils.hpp"
+#include "inspect.hpp"
+#include "streaming.hpp"
+
+/**
+ * @file embeddings.hpp
+ *
+ * @brief Read low-dimensional embeddings in either layout.
+ */
+
+namespace kanaval {
+
+namespace embeddings {
+
+/**
+ * Layout of the embedding in memory.
+ *
+ * - `CELL_MAJOR`: values for the same cell are contiguous, i.e., the row-major cell-by-dimension layout used in the state file.
+ * - `DIMENSION_MAJOR`: values for the same dimension are contiguous, i.e., the layout used by the Javascript/Wasm code.
+ *   This is also the column-major layout of a cell-by-dimension matrix, e.g., in R.
+ */
+enum class Layout { CELL_MAJOR, DIMENSION_MAJOR };
+
+/**
+ * @brief Options for `read()`.
+ */
+struct ReadOptions {
+    /**
+     * Layout of the output array.
+     */
+    Layout layout = Layout::CELL_MAJOR;
+
+    /**
+     * Number of cells to read in each block.
+     * If zero, this is chosen automatically and rounded to a multiple of the chunk size.
+     * Only used when `layout = Layout::DIMENSION_MAJOR`.
+     */
+    hsize_t block_size = 0;
+
+    /**
+     * Number of threads to use for transposition.
+     * If greater than 1, each block is transposed by these threads while the next block is read from file.
+     * Only used when `layout = Layout::DIMENSION_MAJOR`.
+     */
+    int num_threads = 1;
+};
+
+/**
+ * @brief An embedding loaded into memory.
+ *
+ * @tparam T Type of the values.
+ */
+template<typename T = double>
+struct Embedding {
+    /**
+     * Number of cells.
+     */
+    hsize_t num_cells = 0;
+
+    /**
+     * Number of dimensions.
+     */
+    hsize_t num_dims = 0;
+
+    /**
+     * Layout of `values`.
+     */
+    Layout layout = Layout::CELL_MAJOR;
+
+    /**
+     * Array of length `num_cells * num_dims` containing the embedding coordinates in the specified `layout`.
+     */
+    std::vector<T> values;
+};
+
+/**
+ * Open the dataset containing an embedding in the state file.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param type Type of embedding, one of:
+ * - `"pca"`, for the RNA-derived PCs from `pca::validate()`.
+ * - `"adt_pca"`, for the ADT-derived PCs from `adt_pca::validate()`.
+ * - `"combined"`, for the combined embeddings from `combine_embeddings::validate()`.
+ * - `"corrected"`, for the batch-corrected embeddings from `batch_correction::validate()`.
+ *   For versions below 2.0, these are instead taken from the `pca` step, see `pca::validate()`.
+ * @param version Version of the state file.
+ *
+ * @return Handle to a 2-dimensional float dataset where each row is a cell and each column is a dimension.
+ */
+inline H5::DataSet open(const H5::Group& handle, const std::string& type, int version) {
+    std::string step, name;
+    if (type == "pca" || type == "adt_pca") {
+        step = type;
+        name = "pcs";
+    } else if (type == "combined") {
+        step = "combine_embeddings";
+        name = type;
+    } else if (type == "corrected") {
+        step = (version >= 2000000 ? "batch_correction" : "pca");
+        name = type;
+    } else {
+        throw std::runtime_error("unknown embedding type '" + type + "'");
+    }
+
+    auto rhandle = utils::check_and_open_group(utils::check_and_open_group(handle, step), "results");
+    auto dhandle = utils::check_and_open_dataset(rhandle, name, H5T_FLOAT);
+    if (dhandle.getSpace().getSimpleExtentNdims() != 2) {
+        throw std::runtime_error("'" + name + "' dataset should be 2-dimensional");
+    }
+    return dhandle;
+}
+
+/**
+ * Open the dataset containing the embedding prior to any batch correction in the state file.
+ * This is the combined embedding if `combine_embeddings/results/combined` is present, otherwise the PCs from `pca` if present, otherwise the PCs from `adt_pca`.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param version Version of the state file.
+ *
+ * @return Handle to a 2-dimensional float dataset where each row is a cell and each column is a dimension, see `open()`.
+ */
+inline H5::DataSet open_uncorrected(const H5::Group& handle, int version) {
+    if (inspect::has_group(handle, "combine_embeddings") && inspect::has_dataset(handle.openGroup("combine_embeddings/results"), "combined")) {
+        return open(handle, "combined", version);
+    } else if (inspect::has_group(handle, "pca") && inspect::has_dataset(handle.openGroup("pca/results"), "pcs")) {
+        return open(handle, "pca", version);
+    }
+    return open(handle, "adt_pca", version);
+}
+
+/**
+ * @cond
+ */
+inline hsize_t choose_embedding_block(const H5::DataSet& dhandle, hsize_t ncols) {
+    hsize_t block_size = streaming::choose_block_size(ncols);
+
+    auto plist = dhandle.getCreatePlist();
+    if (plist.getLayout() == H5D_CHUNKED) {
+        hsize_t chunks[2];
+        plist.getChunk(2, chunks);
+        if (chunks[0] > 0) {
+            block_size = std::max(chunks[0], (block_size / chunks[0]) * chunks[0]);
+        }
+    }
+
+    return block_size;
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Read an embedding into a user-supplied array.
+ *
+ * For `Layout::CELL_MAJOR`, the entire dataset is read in a single call.
+ * For `Layout::DIMENSION_MAJOR`, the dataset is read in blocks of consecutive cells, and each block is transposed into its position in `output` with a cache-blocked kernel.
+ * When multiple threads are available, the transposition of each block is split across threads and overlapped with the read of the next block,
+ * so the cost of loading the transposed layout is dominated by the read itself.
+ *
+ * @tparam T Type of the values in memory.
+ *
+ * @param dhandle Handle to a 2-dimensional dataset, usually obtained from `open()`.
+ * @param[out] output Pointer to an array of length equal to the product of the dataset dimensions.
+ * On output, this is filled with the embedding in the requested layout.
+ * @param options Further options.
+ */
+template<typename T>
+void read(const H5::DataSet& dhandle, T* output, const ReadOptions& options = ReadOptions()) {
+    auto dims = utils::get_dimensions(dhandle);
+    if (dims.size() != 2) {
+        throw std::runtime_error("expected a 2-dimensional dataset");
+    }
+    hsize_t ncells = dims[0], ndims = dims[1];
+    if (ncells == 0 || ndims == 0) {
+        return;
+    }
+
+    if (options.layout == Layout::CELL_MAJOR) {
+        dhandle.read(output, streaming::native_type<T>());
+        return;
+    }
+
+    hsize_t block_size = (options.block_size ? options.block_size : choose_embedding_block(dhandle, ndims));
+    block_size = std::min(block_size, ncells);
+    size_t nthreads = std::max(1, options.num_threads);
+
+    // Transposing a block into the corresponding columns of the dimension-major output.
+    auto transpose_block = [&](const T* buffer, hsize_t start, hsize_t len) -> void {
+        streaming::transpose(buffer, len, ndims, output + start, ncells, 32);
+    };
+
+    if (nthreads == 1) {
+        std::vector<T> buffer(block_size * ndims);
+        for (hsize_t start = 0; start < ncells; start += block_size) {
+            hsize_t len = std::min(block_size, ncells - start);
+            streaming::read_block(dhandle, start, len, ndims, buffer.data());
+            transpose_block(buffer.data(), start, len);
+        }
+        return;
+    }
+
+    // Double-buffering so that workers can transpose one block while the next is being read.
+    // HDF5 is not thread-safe, so all reads are still performed by the calling thread.
+    std::vector<T> buffers[2];
+    buffers[0].resize(block_size * ndims);
+    buffers[1].resize(block_size * ndims);
+    std::vector<std::thread> workers;
+    workers.reserve(nthreads);
+
+    auto join = [&]() -> void {
+        for (auto& w : workers) {
+            w.join();
+        }
+        workers.clear();
+    };
+
+    int current = 0;
+    try {
+        for (hsize_t start = 0; start < ncells; start += block_size) {
+            hsize_t len = std::min(block_size, ncells - start);
+            const T* buffer = buffers[current].data();
+            streaming::read_block(dhandle, start, len, ndims, buffers[current].data());
+            join();
+
+            hsize_t per_thread = (len + nthreads - 1) / nthreads;
+            for (hsize_t first = 0; first < len; first += per_thread) {
+                hsize_t sublen = std::min(per_thread, len - first);
+                workers.emplace_back(transpose_block, buffer + first * ndims, start + first, sublen);
+            }
+            current = 1 - current;
+        }
+    } catch (...) {
+        join();
+        throw;
+    }
+
+    join();
+}
+
+/**
+ * Read an embedding into memory.
+ *
+ * @tparam T Type of the values in memory.
+ *
+ * @param dhandle Handle to a 2-dimensional dataset, usually obtained from `open()`.
+ * @param options Further options.
+ *
+ * @return The embedding in the requested layout.
+ */
+template<typename T = double>
+Embedding<T> read(const H5::DataSet& dhandle, const ReadOptions& options = ReadOptions()) {
+    auto dims = utils::get_dimensions(dhandle);
+    if (dims.size() != 2) {
+        throw std::runtime_error("expected a 2-dimensional dataset");
+    }
+
+    Embedding<T> output;
+    output.num_cells = dims[0];
+    output.num_dims = dims[1];
+    output.layout = options.layout;
+    output.values.resize(dims[0] * dims[1]);
+    read(dhandle, output.values.data(), options);
+    return output;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,578 @@
+#ifndef KANAVAL_EXPORT_H5AD_HPP
+#define KANAVAL_EXPORT_H5AD_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <numeric>
+#include <memory>
+#include "utils.hpp"
+#include "misc.hpp"
+#include "inspect.hpp"
+#include "streaming.hpp"
+#include "interning.hpp"
+
+/**
+ * @file export_h5ad.hpp
+ *
+ * @brief Export the contents of a state file to the H5AD format.
+ */
+
+namespace kanaval {
+
+namespace h5ad {
+
+/**
+ * @brief Options for `export_state()`.
+ */
+struct ExportOptions {
+    /**
+     * Number of cells to process in each block.
+     * Larger values improve throughput at the cost of memory usage.
+     */
+    hsize_t block_size = 65536;
+
+    /**
+     * Deflate compression level for the per-cell datasets.
+     */
+    int compression_level = 6;
+
+    /**
+     * Whether to store the marker statistics in `uns`.
+     */
+    bool include_markers = true;
+
+    /**
+     * Whether to store the unfiltered quality control metrics and discard flags in `uns`.
+     */
+    bool include_unfiltered_qc = true;
+};
+
+/**
+ * @cond
+ */
+inline void set_string_attribute(const H5::H5Object& handle, const std::string& name, const std::string& value) {
+    H5::StrType stype(0, H5T_VARIABLE);
+    stype.setCset(H5T_CSET_UTF8);
+    auto ahandle = handle.createAttribute(name, stype, H5::DataSpace(H5S_SCALAR));
+    ahandle.write(stype, value);
+}
+
+inline void set_string_array_attribute(const H5::H5Object& handle, const std::string& name, const std::vector<std::string>& values) {
+    H5::StrType stype(0, H5T_VARIABLE);
+    stype.setCset(H5T_CSET_UTF8);
+    hsize_t len = values.size();
+    auto ahandle = handle.createAttribute(name, stype, H5::DataSpace(1, &len));
+    std::vector<const char*> ptrs;
+    for (const auto& v : values) {
+        ptrs.push_back(v.c_str());
+    }
+    if (len) {
+        ahandle.write(stype, ptrs.data());
+    }
+}
+
+inline void set_encoding(const H5::H5Object& handle, const std::string& type, const std::string& version) {
+    set_string_attribute(handle, "encoding-type", type);
+    set_string_attribute(handle, "encoding-version", version);
+}
+
+inline H5::Group create_dict(const H5::Group& handle, const std::string& name) {
+    auto ghandle = handle.createGroup(name);
+    set_encoding(ghandle, "dict", "0.1.0");
+    return ghandle;
+}
+
+inline H5::StrType string_type() {
+    H5::StrType stype(0, H5T_VARIABLE);
+    stype.setCset(H5T_CSET_UTF8);
+    return stype;
+}
+
+inline streaming::RowWriter create_array(const H5::Group& handle, const std::string& name, const H5::DataType& type, hsize_t nrows, hsize_t ncols, const ExportOptions& options) {
+    streaming::RowWriter writer(handle, name, type, nrows, ncols, options.compression_level);
+    set_encoding(writer.dataset(), "array", "0.2.0");
+    return writer;
+}
+
+inline streaming::RowWriter create_string_array(const H5::Group& handle, const std::string& name, hsize_t nrows, const ExportOptions& options) {
+    streaming::RowWriter writer(handle, name, string_type(), nrows, 0, options.compression_level);
+    set_encoding(writer.dataset(), "string-array", "0.2.0");
+    return writer;
+}
+
+inline void write_string_array(const H5::Group& handle, const std::string& name, const std::vector<std::string>& values, const ExportOptions& options) {
+    auto writer = create_string_array(handle, name, values.size(), options);
+    writer.write(values);
+}
+
+inline H5::Group create_dataframe(const H5::Group& handle, const std::string& name, const std::vector<std::string>& columns) {
+    auto ghandle = handle.createGroup(name);
+    set_encoding(ghandle, "dataframe", "0.2.0");
+    set_string_attribute(ghandle, "_index", "_index");
+    set_string_array_attribute(ghandle, "column-order", columns);
+    return ghandle;
+}
+
+struct QcColumn {
+    QcColumn(H5::DataSet d, std::string n, bool i) : source(std::move(d)), name(std::move(n)), is_integer(i) {}
+    H5::DataSet source;
+    std::string name;
+    bool is_integer;
+};
+
+inline std::vector<QcColumn> find_qc_columns(const H5::Group& handle, bool adt_in_use) {
+    std::vector<QcColumn> output;
+    auto add_columns = [&](const std::string& step, const std::vector<std::string>& metrics, const std::string& prefix) -> void {
+        auto mhandle = utils::check_and_open_group(utils::check_and_open_group(utils::check_and_open_group(handle, step), "results"), "metrics");
+        for (const auto& m : metrics) {
+            auto dhandle = utils::check_and_open_dataset(mhandle, m);
+            output.emplace_back(dhandle, prefix + m, dhandle.getTypeClass() == H5T_INTEGER);
+        }
+    };
+
+    add_columns("quality_control", { "sums", "detected", "proportion" }, "");
+    if (adt_in_use) {
+        add_columns("adt_quality_control", { "sums", "detected", "igg_total" }, "adt_");
+    }
+    return output;
+}
+
+/*
+ * Fused pass over all per-cell QC datasets: each block of the discard vector and
+ * the metrics is read exactly once, and the retained entries are appended to obs.
+ */
+inline void write_qc(
+    const H5::DataSet& discards,
+    const std::vector<QcColumn>& columns,
+    hsize_t num_cells,
+    hsize_t num_kept,
+    const H5::Group& obs,
+    const H5::Group* unfiltered,
+    const ExportOptions& options)
+{
+    std::vector<streaming::RowWriter> filtered_writers, unfiltered_writers;
+    for (const auto& col : columns) {
+        const auto& ftype = (col.is_integer ? H5::PredType::NATIVE_INT32 : H5::PredType::NATIVE_DOUBLE);
+        filtered_writers.push_back(create_array(obs, col.name, ftype, num_kept, 0, options));
+        if (unfiltered) {
+            unfiltered_writers.push_back(create_array(*unfiltered, col.name, ftype, num_cells, 0, options));
+        }
+    }
+
+    auto index_writer = create_string_array(obs, "_index", num_kept, options);
+    std::unique_ptr<streaming::RowWriter> discard_writer;
+    if (unfiltered) {
+        discard_writer.reset(new streaming::RowWriter(create_array(*unfiltered, "discards", H5::PredType::NATIVE_INT8, num_cells, 0, options)));
+    }
+
+    hsize_t block_size = std::max<hsize_t>(1, options.block_size);
+    std::vector<double> dbuffer(std::min(block_size, num_cells));
+    std::vector<int> ibuffer(dbuffer.size());
+    std::vector<hsize_t> kept;
+    kept.reserve(dbuffer.size());
+    std::vector<double> dkept;
+    std::vector<int> ikept;
+    std::vector<std::string> names;
+
+    streaming::for_each_block<int>(discards, block_size, [&](hsize_t start, hsize_t len, const int* dptr) -> void {
+        kept.clear();
+        names.clear();
+        for (hsize_t i = 0; i < len; ++i) {
+            if (dptr[i] == 0) {
+                kept.push_back(i);
+                names.push_back(std::to_string(start + i));
+            }
+        }
+
+        if (index_writer.filled() + kept.size() > num_kept) {
+            throw std::runtime_error("number of retained cells in the discard vector is greater than the number of rows in the embeddings");
+        }
+        index_writer.write(names);
+
+        if (discard_writer) {
+            discard_writer->write(dptr, len);
+        }
+
+        hsize_t offset = start, count = len;
+        H5::DataSpace mspace(1, &count);
+        for (size_t c = 0; c < columns.size(); ++c) {
+            const auto& col = columns[c];
+            auto dspace = col.source.getSpace();
+            dspace.selectHyperslab(H5S_SELECT_SET, &count, &offset);
+
+            if (col.is_integer) {
+                col.source.read(ibuffer.data(), H5::PredType::NATIVE_INT, mspace, dspace);
+                ikept.clear();
+                for (auto k : kept) {
+                    ikept.push_back(ibuffer[k]);
+                }
+                filtered_writers[c].write(ikept.data(), ikept.size());
+                if (unfiltered) {
+                    unfiltered_writers[c].write(ibuffer.data(), len);
+                }
+            } else {
+                col.source.read(dbuffer.data(), H5::PredType::NATIVE_DOUBLE, mspace, dspace);
+                dkept.clear();
+                for (auto k : kept) {
+                    dkept.push_back(dbuffer[k]);
+                }
+                filtered_writers[c].write(dkept.data(), dkept.size());
+                if (unfiltered) {
+                    unfiltered_writers[c].write(dbuffer.data(), len);
+                }
+            }
+        }
+    });
+
+    if (index_writer.filled() != num_kept) {
+        throw std::runtime_error("number of retained cells in the discard vector is less than the number of rows in the embeddings");
+    }
+}
+
+inline H5::Group create_categorical(const H5::Group& obs, const std::string& name) {
+    auto chandle = obs.createGroup(name);
+    set_encoding(chandle, "categorical", "0.2.0");
+    H5::DataSpace scalar(H5S_SCALAR);
+    auto ahandle = chandle.createAttribute("ordered", H5::PredType::NATIVE_HBOOL, scalar);
+    hbool_t ordered = false;
+    ahandle.write(H5::PredType::NATIVE_HBOOL, &ordered);
+    return chandle;
+}
+
+struct LabelColumn {
+    std::string name;
+    std::vector<int> codes; // per-cluster codes into 'dictionary'.
+    interning::Dictionary dictionary;
+};
+
+inline std::vector<LabelColumn> find_label_columns(const H5::Group& handle) {
+    std::vector<LabelColumn> output;
+    if (!inspect::has_group(handle, "cell_labelling")) {
+        return output;
+    }
+    auto rhandle = utils::check_and_open_group(handle.openGroup("cell_labelling"), "results");
+    if (!inspect::has_group(rhandle, "per_reference")) {
+        return output;
+    }
+
+    auto perhandle = rhandle.openGroup("per_reference");
+    size_t nrefs = perhandle.getNumObjs();
+    output.reserve(nrefs);
+    for (size_t r = 0; r < nrefs; ++r) {
+        output.emplace_back();
+        auto& current = output.back();
+        auto ref = perhandle.getObjnameByIdx(r);
+        current.name = "labels_" + ref;
+        current.codes = interning::load_codes(perhandle, ref, current.dictionary);
+    }
+    return output;
+}
+
+/*
+ * Each cluster's label is looked up in the same pass that copies the
+ * clusters, so the per-cell label codes never need to be held in memory.
+ */
+inline int write_clusters(const H5::DataSet& source, const H5::Group& obs, const std::vector<LabelColumn>& labels, hsize_t num_kept, const ExportOptions& options) {
+    auto chandle = create_categorical(obs, "clusters");
+    auto codes = create_array(chandle, "codes", H5::PredType::NATIVE_INT32, num_kept, 0, options);
+
+    std::vector<streaming::RowWriter> label_writers;
+    for (const auto& lab : labels) {
+        auto lhandle = create_categorical(obs, lab.name);
+        write_string_array(lhandle, "categories", lab.dictionary.levels(), options);
+        label_writers.push_back(create_array(lhandle, "codes", H5::PredType::NATIVE_INT32, num_kept, 0, options));
+    }
+
+    int nclusters = 0;
+    std::vector<int> lbuffer;
+    streaming::for_each_block<int>(source, options.block_size, [&](hsize_t, hsize_t len, const int* ptr) -> void {
+        for (hsize_t i = 0; i < len; ++i) {
+            nclusters = std::max(nclusters, ptr[i] + 1);
+        }
+        codes.write(ptr, len);
+
+        lbuffer.resize(len);
+        for (size_t l = 0; l < labels.size(); ++l) {
+            const auto& lcodes = labels[l].codes;
+            for (hsize_t i = 0; i < len; ++i) {
+                auto c = ptr[i];
+                if (c < 0 || static_cast<size_t>(c) >= lcodes.size()) {
+                    throw std::runtime_error("cluster " + std::to_string(c) + " has no label in '" + labels[l].name + "'");
+                }
+                lbuffer[i] = lcodes[c];
+            }
+            label_writers[l].write(lbuffer.data(), len);
+        }
+    });
+
+    std::vector<std::string> categories;
+    for (int c = 0; c < nclusters; ++c) {
+        categories.push_back(std::to_string(c));
+    }
+    write_string_array(chandle, "categories", categories, options);
+    return nclusters;
+}
+
+inline void copy_embedding(const H5::DataSet& source, const H5::Group& obsm, const std::string& name, const ExportOptions& options) {
+    auto dims = utils::get_dimensions(source);
+    if (dims.size() != 2) {
+        throw std::runtime_error("expected a 2-dimensional dataset for '" + name + "'");
+    }
+    auto writer = create_array(obsm, name, H5::PredType::NATIVE_DOUBLE, dims[0], dims[1], options);
+    auto block_size = streaming::choose_block_size(dims[1], options.block_size);
+    streaming::for_each_block<double>(source, block_size, [&](hsize_t, hsize_t len, const double* ptr) -> void {
+        writer.write(ptr, len);
+    });
+}
+
+/*
+ * Interleave the 'x' and 'y' coordinates in a single pass.
+ */
+inline void copy_coordinates(const H5::Group& rhandle, const H5::Group& obsm, const std::string& name, hsize_t num_kept, const ExportOptions& options) {
+    auto xhandle = utils::check_and_open_dataset(rhandle, "x", H5T_FLOAT, { static_cast<size_t>(num_kept) });
+    auto yhandle = utils::check_and_open_dataset(rhandle, "y", H5T_FLOAT, { static_cast<size_t>(num_kept) });
+    auto writer = create_array(obsm, name, H5::PredType::NATIVE_DOUBLE, num_kept, 2, options);
+
+    std::vector<double> ybuffer, combined;
+    streaming::for_each_block<double>(xhandle, options.block_size, [&](hsize_t start, hsize_t len, const double* xptr) -> void {
+        ybuffer.resize(len);
+        hsize_t count = len;
+        auto yspace = yhandle.getSpace();
+        yspace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+        yhandle.read(ybuffer.data(), H5::PredType::NATIVE_DOUBLE, H5::DataSpace(1, &count), yspace);
+
+        combined.resize(len * 2);
+        for (hsize_t i = 0; i < len; ++i) {
+            combined[2 * i] = xptr[i];
+            combined[2 * i + 1] = ybuffer[i];
+        }
+        writer.write(combined.data(), len);
+    });
+}
+
+inline void write_markers(const H5::Group& handle, const H5::Group& uns, const std::vector<std::string>& modalities, const std::vector<int>& num_features, int nclusters, int version, const ExportOptions& options) {
+    auto mhandle = utils::check_and_open_group(utils::check_and_open_group(handle, "marker_detection"), "results");
+    auto ohandle = create_dict(uns, "kana_markers");
+
+    std::vector<std::string> stats { "means", "detected" };
+    for (const auto& eff : markers::effects) {
+        for (std::string summary : { "mean", "min", "min_rank" }) {
+            stats.push_back(eff + "/" + summary);
+        }
+    }
+
+    std::vector<double> buffer;
+    for (size_t m = 0; m < modalities.size(); ++m) {
+        auto source = (version >= 2000000 ?
+            utils::check_and_open_group(utils::check_and_open_group(mhandle, "per_cluster"), modalities[m]) :
+            utils::check_and_open_group(mhandle, "clusters"));
+
+        // Each statistic is stored as a cluster-by-feature matrix, filled one cluster at a time.
+        auto modhandle = create_dict(ohandle, modalities[m]);
+        buffer.resize(num_features[m]);
+        for (const auto& stat : stats) {
+            std::string outname = stat;
+            std::replace(outname.begin(), outname.end(), '/', '_');
+            auto writer = create_array(modhandle, outname, H5::PredType::NATIVE_DOUBLE, nclusters, num_features[m], options);
+
+            for (int c = 0; c < nclusters; ++c) {
+                auto dhandle = utils::check_and_open_dataset(source, std::to_string(c) + "/" + stat, H5T_FLOAT, { static_cast<size_t>(num_features[m]) });
+                dhandle.read(buffer.data(), H5::PredType::NATIVE_DOUBLE);
+                writer.write(buffer.data(), 1);
+            }
+        }
+    }
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Export the analysis results in a state file to the H5AD format, for use with **anndata**.
+ * The state file is assumed to have been validated with `validate()`.
+ * All per-cell datasets are processed in blocks of `ExportOptions::block_size` cells so that memory usage does not scale with the number of cells,
+ * and each dataset in the state file is read exactly once.
+ *
+ * The H5AD file describes the cells that were retained after quality filtering.
+ * No `X` matrix is stored as the state file does not contain the (normalized) expression values.
+ * The contents are mapped as follows:
+ *
+ * - `obs` contains the per-cell quality control metrics from `quality_control::validate()` (and `adt_quality_control::validate()`, prefixed with `adt_`),
+ *   as well as a `clusters` categorical column from the clustering chosen in `choose_clustering::validate()`.
+ *   If `cell_labelling::validate()` results are present, each reference is also stored as a `labels_<reference>` categorical column,
+ *   containing the label assigned to each cell's cluster.
+ *   The index contains the position of each retained cell in the unfiltered dataset.
+ * - `obsm` contains `X_pca` (and `X_adt_pca`) from `pca::validate()` (and `adt_pca::validate()`),
+ *   `X_combined` from `combine_embeddings::validate()`, `X_corrected` from `batch_correction::validate()`,
+ *   and `X_tsne` and `X_umap` from `tsne::validate()` and `umap::validate()`, respectively.
+ *   Each embedding is only stored if it is present in the state file.
+ * - `var` contains the RNA feature selection statistics from `feature_selection::validate()`.
+ *   The index contains the identities of the RNA features, see `inputs::validate()` for details.
+ * - `uns` contains `kana_markers`, a dictionary of modalities where each modality is a dictionary of statistics from `marker_detection::validate()`.
+ *   Each statistic is stored as a cluster-by-feature matrix, named after the statistic (e.g., `means`) or the effect size and its summary (e.g., `cohen_mean`).
+ *   If `ExportOptions::include_unfiltered_qc = true`, `uns` also contains `kana_quality_control`, a dictionary of the unfiltered QC metrics and the `discards` flags.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param path Path to the output H5AD file.
+ * This is overwritten if it already exists.
+ * @param version Version of the state file.
+ * @param options Further options.
+ *
+ * @return The H5AD file is created at `path`.
+ */
+inline void export_state(const H5::H5File& handle, const std::string& path, int version, const ExportOptions& options = ExportOptions()) {
+    auto summary = inspect::inspect(handle, version);
+    const auto& modalities = summary.inputs.modalities;
+    if (modalities.empty()) {
+        throw std::runtime_error("failed to determine the modalities in 'inputs'");
+    }
+    if (summary.num_filtered_cells < 0) {
+        throw std::runtime_error("failed to determine the number of filtered cells from the PCs");
+    }
+    hsize_t num_cells = summary.inputs.num_cells;
+    hsize_t num_kept = summary.num_filtered_cells;
+
+    size_t rna_idx = std::find(modalities.begin(), modalities.end(), std::string("RNA")) - modalities.begin();
+    bool rna_in_use = rna_idx != modalities.size();
+    bool adt_in_use = std::find(modalities.begin(), modalities.end(), std::string("ADT")) != modalities.end();
+
+    H5::H5File ohandle(path, H5F_ACC_TRUNC);
+    auto root = ohandle.openGroup("/");
+    set_encoding(root, "anndata", "0.1.0");
+
+    // Filling the per-cell information.
+    std::vector<std::string> obs_columns;
+    auto qc_columns = find_qc_columns(handle, adt_in_use);
+    for (const auto& col : qc_columns) {
+        obs_columns.push_back(col.name);
+    }
+    bool has_clusters = !summary.clustering_method.empty();
+    std::vector<LabelColumn> label_columns;
+    if (has_clusters) {
+        obs_columns.push_back("clusters");
+        try {
+            label_columns = find_label_columns(handle);
+        } catch (std::exception& e) {
+            throw utils::combine_errors(e, "failed to load the cell labels");
+        }
+        for (const auto& lab : label_columns) {
+            obs_columns.push_back(lab.name);
+        }
+    }
+    auto obs = create_dataframe(root, "obs", obs_columns);
+
+    auto uns = create_dict(root, "uns");
+    try {
+        auto discards = quality_control::open_discard_vector(handle, modalities, version);
+        if (options.include_unfiltered_qc) {
+            auto unfiltered = create_dict(uns, "kana_quality_control");
+            write_qc(discards, qc_columns, num_cells, num_kept, obs, &unfiltered, options);
+        } else {
+            write_qc(discards, qc_columns, num_cells, num_kept, obs, NULL, options);
+        }
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to export the quality control metrics");
+    }
+
+    int nclusters = 0;
+    if (has_clusters) {
+        try {
+            std::string step = (summary.clustering_method == "kmeans" ? "kmeans_cluster" : "snn_graph_cluster");
+            auto rhandle = utils::check_and_open_group(utils::check_and_open_group(handle, step), "results");
+            auto chandle = utils::check_and_open_dataset(rhandle, "clusters", H5T_INTEGER, { static_cast<size_t>(num_kept) });
+            nclusters = write_clusters(chandle, obs, label_columns, num_kept, options);
+        } catch (std::exception& e) {
+            throw utils::combine_errors(e, "failed to export the clusters");
+        }
+    }
+
+    // Filling the embeddings.
+    auto obsm = create_dict(root, "obsm");
+    try {
+        auto add_embedding = [&](const std::string& step, const std::string& name, const std::string& outname) -> void {
+            if (inspect::has_group(handle, step)) {
+                auto shandle = handle.openGroup(step);
+                if (inspect::has_group(shandle, "results")) {
+                    auto rhandle = shandle.openGroup("results");
+                    if (inspect::has_dataset(rhandle, name)) {
+                        copy_embedding(rhandle.openDataSet(name), obsm, outname, options);
+                    }
+                }
+            }
+        };
+
+        add_embedding("pca", "pcs", "X_pca");
+        if (adt_in_use) {
+            add_embedding("adt_pca", "pcs", "X_adt_pca");
+        }
+        add_embedding("combine_embeddings", "combined", "X_combined");
+        add_embedding("batch_correction", "corrected", "X_corrected");
+
+        for (std::string step : { "tsne", "umap" }) {
+            if (inspect::has_group(handle, step)) {
+                auto rhandle = utils::check_and_open_group(handle.openGroup(step), "results");
+                copy_coordinates(rhandle, obsm, "X_" + step, num_kept, options);
+            }
+        }
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to export the embeddings");
+    }
+
+    // Filling the per-feature information.
+    {
+        size_t var_idx = (rna_in_use ? rna_idx : 0);
+        std::vector<int> identities;
+        if (version >= 2000000) {
+            identities = utils::load_integer_vector<int>(handle, "inputs/results/identities/" + modalities[var_idx]);
+        } else if (version >= 1002000) {
+            identities = utils::load_integer_vector<int>(handle, "inputs/results/identities");
+        } else {
+            identities.resize(summary.inputs.num_features[var_idx]);
+            std::iota(identities.begin(), identities.end(), 0);
+        }
+
+        std::vector<std::string> stats;
+        if (rna_in_use) {
+            stats = std::vector<std::string>{ "means", "vars", "fitted", "resids" };
+        }
+
+        auto var = create_dataframe(root, "var", stats);
+        std::vector<std::string> index;
+        index.reserve(identities.size());
+        for (auto i : identities) {
+            index.push_back(std::to_string(i));
+        }
+        write_string_array(var, "_index", index, options);
+
+        if (rna_in_use) {
+            auto rhandle = utils::check_and_open_group(utils::check_and_open_group(handle, "feature_selection"), "results");
+            std::vector<double> buffer(identities.size());
+            for (const auto& s : stats) {
+                auto dhandle = utils::check_and_open_dataset(rhandle, s, H5T_FLOAT, { identities.size() });
+                dhandle.read(buffer.data(), H5::PredType::NATIVE_DOUBLE);
+                auto writer = create_array(var, s, H5::PredType::NATIVE_DOUBLE, buffer.size(), 0, options);
+                writer.write(buffer.data(), buffer.size());
+            }
+        }
+    }
+
+    if (options.include_markers && nclusters > 0) {
+        try {
+            write_markers(handle, uns, modalities, summary.inputs.num_features, nclusters, version, options);
+        } catch (std::exception& e) {
+            throw utils::combine_errors(e, "failed to export the marker statistics");
+        }
+    }
+
+    for (std::string name : { "varm", "obsp", "varp", "layers" }) {
+        create_dict(root, name);
+    }
+}
+
+}
+
+}
+
+#endif
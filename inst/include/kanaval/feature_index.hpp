@@ -0,0 +1,392 @@
+#ifndef KANAVAL_FEATURE_INDEX_HPP
+#define KANAVAL_FEATURE_INDEX_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+#include "utils.hpp"
+#include "write_utils.hpp"
+#include "embedded.hpp"
+
+/**
+ * @file feature_index.hpp
+ *
+ * @brief Build and query a persistent index of feature names.
+ */
+
+namespace kanaval {
+
+namespace feature_index {
+
+/**
+ * @brief Names of the rows of an input matrix.
+ */
+struct FeatureNames {
+    /**
+     * Identifier for each row, e.g., Ensembl IDs.
+     */
+    std::vector<std::string> ids;
+
+    /**
+     * Symbol for each row, e.g., gene symbols.
+     * If no symbols are available, this is set to `ids`.
+     */
+    std::vector<std::string> symbols;
+};
+
+/**
+ * @brief Sorted index of names.
+ *
+ * Names are stored in sorted order alongside the index of the corresponding row in the loaded dataset, so lookups are performed by binary search.
+ * Duplicated names are allowed, e.g., for gene symbols.
+ */
+struct Index {
+    /**
+     * Sorted vector of names.
+     */
+    std::vector<std::string> names;
+
+    /**
+     * Row index in the loaded dataset for each entry of `names`.
+     * Rows with the same name are ordered by increasing index.
+     */
+    std::vector<int> indices;
+
+    /**
+     * @param unsorted Name of each row in the loaded dataset.
+     * @return Index for `unsorted`.
+     */
+    static Index build(const std::vector<std::string>& unsorted) {
+        std::vector<int> order(unsorted.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int l, int r) -> bool { return unsorted[l] < unsorted[r]; });
+
+        Index output;
+        output.names.reserve(order.size());
+        for (auto o : order) {
+            output.names.push_back(unsorted[o]);
+        }
+        output.indices.swap(order);
+        return output;
+    }
+
+    /**
+     * @param name Name of interest.
+     * @return Index of the first row in the loaded dataset with name `name`, or -1 if no such row exists.
+     */
+    int find(const std::string& name) const {
+        auto it = std::lower_bound(names.begin(), names.end(), name);
+        if (it == names.end() || *it != name) {
+            return -1;
+        }
+        return indices[it - names.begin()];
+    }
+
+    /**
+     * @param name Name of interest.
+     * @return Indices of all rows in the loaded dataset with name `name`.
+     */
+    std::vector<int> find_all(const std::string& name) const {
+        auto range = std::equal_range(names.begin(), names.end(), name);
+        return std::vector<int>(indices.begin() + (range.first - names.begin()), indices.begin() + (range.second - names.begin()));
+    }
+};
+
+/**
+ * @brief Indices for the identifiers and symbols of a single modality.
+ */
+struct ModalityIndex {
+    /**
+     * Index of feature identifiers.
+     */
+    Index ids;
+
+    /**
+     * Index of feature symbols.
+     */
+    Index symbols;
+};
+
+/**
+ * @cond
+ */
+inline FeatureNames parse_genes(const std::string& contents) {
+    FeatureNames output;
+    size_t pos = 0;
+    while (pos < contents.size()) {
+        size_t end = contents.find('\n', pos);
+        if (end == std::string::npos) {
+            end = contents.size();
+        }
+
+        size_t last = end;
+        if (last > pos && contents[last - 1] == '\r') {
+            --last;
+        }
+
+        if (last > pos) {
+            size_t tab1 = contents.find('\t', pos);
+            if (tab1 == std::string::npos || tab1 > last) {
+                output.ids.emplace_back(contents.begin() + pos, contents.begin() + last);
+                output.symbols.push_back(output.ids.back());
+            } else {
+                size_t tab2 = contents.find('\t', tab1 + 1);
+                if (tab2 == std::string::npos || tab2 > last) {
+                    tab2 = last;
+                }
+                output.ids.emplace_back(contents.begin() + pos, contents.begin() + tab1);
+                output.symbols.emplace_back(contents.begin() + tab1 + 1, contents.begin() + tab2);
+            }
+        }
+
+        pos = end + 1;
+    }
+    return output;
+}
+
+inline FeatureNames parse_10x(const H5::H5File& handle) {
+    FeatureNames output;
+    auto mhandle = utils::check_and_open_group(handle, "matrix");
+    if (mhandle.exists("features")) {
+        auto fhandle = utils::check_and_open_group(mhandle, "features");
+        output.ids = utils::load_string_vector(fhandle, "id");
+        output.symbols = utils::load_string_vector(fhandle, "name");
+    } else {
+        output.ids = utils::load_string_vector(mhandle, "genes");
+        output.symbols = utils::load_string_vector(mhandle, "gene_names");
+    }
+    if (output.ids.size() != output.symbols.size()) {
+        throw std::runtime_error("feature identifiers and names should have the same length");
+    }
+    return output;
+}
+
+inline FeatureNames parse_h5ad(const H5::H5File& handle) {
+    FeatureNames output;
+    auto vhandle = utils::check_and_open_group(handle, "var");
+
+    std::string index_name = "_index";
+    if (vhandle.attrExists("_index")) {
+        auto ahandle = vhandle.openAttribute("_index");
+        ahandle.read(ahandle.getStrType(), index_name);
+    }
+    output.ids = utils::load_string_vector(vhandle, index_name);
+
+    for (std::string candidate : { "gene_symbols", "feature_name", "gene_name", "symbol" }) {
+        if (vhandle.exists(candidate) && vhandle.childObjType(candidate) == H5O_TYPE_DATASET && vhandle.openDataSet(candidate).getTypeClass() == H5T_STRING) {
+            output.symbols = utils::load_string_vector(vhandle, candidate);
+            break;
+        }
+    }
+    if (output.symbols.size() != output.ids.size()) {
+        output.symbols = output.ids;
+    }
+    return output;
+}
+
+inline std::string first_format(const H5::Group& phandle) {
+    auto fhandle = utils::check_and_open_dataset(phandle, "format", H5T_STRING);
+    if (fhandle.getSpace().getSimpleExtentNdims() == 0) {
+        return utils::load_string(fhandle);
+    } else {
+        auto formats = utils::load_string_vector(fhandle);
+        if (formats.empty()) {
+            throw std::runtime_error("'format' should not be empty");
+        }
+        return formats.front();
+    }
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Load the names of the rows of the first input matrix from its embedded files.
+ * For `"MatrixMarket"` inputs, names are parsed from the (possibly Gzipped) `genes` file.
+ * For `"10X"` inputs, names are taken from `matrix/features` (or `matrix/genes` and `matrix/gene_names` for older files).
+ * For `"H5AD"` inputs, identifiers are taken from the index of `var`, while symbols are taken from the first string column named `gene_symbols`, `feature_name`, `gene_name` or `symbol`.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param locations Location of each embedded file, from `embedded::locate_in_kana()` or `embedded::locate_in_directory()`.
+ *
+ * @return Names of the rows of the first input matrix.
+ */
+inline FeatureNames load_feature_names(const H5::Group& handle, const std::vector<embedded::Location>& locations) {
+    auto phandle = utils::check_and_open_group(utils::check_and_open_group(handle, "inputs"), "parameters");
+    auto format = first_format(phandle);
+    auto files = embedded::list_files(handle);
+    if (files.size() != locations.size()) {
+        throw std::runtime_error("number of locations should be equal to the number of embedded files");
+    }
+
+    size_t nfiles = files.size();
+    if (phandle.exists("sample_groups")) {
+        auto groups = utils::load_integer_vector<int>(phandle, "sample_groups");
+        if (groups.empty()) {
+            throw std::runtime_error("'sample_groups' should not be empty");
+        }
+        nfiles = std::min(nfiles, static_cast<size_t>(groups.front()));
+    }
+
+    if (format == "MatrixMarket") {
+        for (size_t f = 0; f < nfiles; ++f) {
+            if (files[f].type == "genes") {
+                return parse_genes(embedded::read_text(locations[f]));
+            }
+        }
+        throw std::runtime_error("no 'genes' file is available for the first matrix");
+    }
+
+    if (format == "10X" || format == "H5AD") {
+        for (size_t f = 0; f < nfiles; ++f) {
+            if (files[f].type == "h5") {
+                auto bytes = embedded::read_bytes(locations[f]);
+                auto fhandle = embedded::open_hdf5(bytes, files[f].name);
+                return (format == "10X" ? parse_10x(fhandle) : parse_h5ad(fhandle));
+            }
+        }
+        throw std::runtime_error("no 'h5' file is available for the first matrix");
+    }
+
+    throw std::runtime_error("feature names cannot be extracted from format '" + format + "'");
+}
+
+/**
+ * Identify the row of the first input matrix corresponding to each row in the loaded dataset, see `inputs::validate()` for details.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param modality Modality of interest.
+ * Ignored for `version < 2000000`.
+ * @param version Version of the format.
+ *
+ * @return Vector of length equal to the number of features in the loaded dataset, containing the index of the corresponding row in the first input matrix.
+ */
+inline std::vector<int> loaded_identities(const H5::Group& handle, const std::string& modality, int version) {
+    auto rhandle = utils::check_and_open_group(utils::check_and_open_group(handle, "inputs"), "results");
+    if (version >= 2000000) {
+        return utils::load_integer_vector<int>(utils::check_and_open_group(rhandle, "identities"), modality);
+    } else if (version >= 1002000) {
+        return utils::load_integer_vector<int>(rhandle, "identities");
+    } else if (rhandle.exists("indices")) {
+        return utils::load_integer_vector<int>(rhandle, "indices");
+    }
+
+    // The permutation maps each original row to its position in the loaded dataset.
+    auto perm = utils::load_integer_vector<int>(rhandle, "permutation");
+    std::vector<int> output(perm.size());
+    for (size_t i = 0; i < perm.size(); ++i) {
+        if (perm[i] < 0 || static_cast<size_t>(perm[i]) >= perm.size()) {
+            throw std::runtime_error("'permutation' contains out-of-range values");
+        }
+        output[perm[i]] = i;
+    }
+    return output;
+}
+
+/**
+ * Build indices of the feature names for each modality in the loaded dataset.
+ * This parses the embedded input files once and applies the row identities from the state file,
+ * so that subsequent name lookups do not need to revisit the inputs.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param locations Location of each embedded file, from `embedded::locate_in_kana()` or `embedded::locate_in_directory()`.
+ * @param version Version of the format.
+ *
+ * @return Map of modality names to their indices.
+ * For `version < 2000000`, only an `"RNA"` modality is reported.
+ */
+inline std::unordered_map<std::string, ModalityIndex> build(const H5::Group& handle, const std::vector<embedded::Location>& locations, int version) {
+    auto names = load_feature_names(handle, locations);
+
+    std::vector<std::string> modalities;
+    if (version >= 2000000) {
+        auto ihandle = utils::check_and_open_group(utils::check_and_open_group(utils::check_and_open_group(handle, "inputs"), "results"), "identities");
+        size_t nmod = ihandle.getNumObjs();
+        for (size_t m = 0; m < nmod; ++m) {
+            modalities.push_back(ihandle.getObjnameByIdx(m));
+        }
+    } else {
+        modalities.push_back("RNA");
+    }
+
+    std::unordered_map<std::string, ModalityIndex> output;
+    for (const auto& mod : modalities) {
+        auto ids = loaded_identities(handle, mod, version);
+        std::vector<std::string> curids, cursyms;
+        curids.reserve(ids.size());
+        cursyms.reserve(ids.size());
+        for (auto i : ids) {
+            if (i < 0 || static_cast<size_t>(i) >= names.ids.size()) {
+                throw std::runtime_error("identities for modality '" + mod + "' are out of range for the feature names");
+            }
+            curids.push_back(names.ids[i]);
+            cursyms.push_back(names.symbols[i]);
+        }
+
+        auto& current = output[mod];
+        current.ids = Index::build(curids);
+        current.symbols = Index::build(cursyms);
+    }
+
+    return output;
+}
+
+/**
+ * Save the indices into a HDF5 group, either inside the state file or in a separate sidecar file.
+ * This creates a `feature_index` group containing one subgroup per modality.
+ * Each modality subgroup contains `ids` and `symbols` subgroups, which in turn contain the `names` string dataset and the `indices` integer dataset from the corresponding `Index`.
+ *
+ * @param handle Group in which to save the indices.
+ * @param indices Map of modality names to their indices, usually from `build()`.
+ */
+inline void save(const H5::Group& handle, const std::unordered_map<std::string, ModalityIndex>& indices) {
+    auto ihandle = handle.createGroup("feature_index");
+    for (const auto& mod : indices) {
+        auto mhandle = ihandle.createGroup(mod.first);
+        auto save_index = [&](const std::string& name, const Index& index) -> void {
+            auto xhandle = mhandle.createGroup(name);
+            utils::write_string_vector(xhandle, "names", index.names);
+            utils::write_integer_vector(xhandle, "indices", index.indices);
+        };
+        save_index("ids", mod.second.ids);
+        save_index("symbols", mod.second.symbols);
+    }
+}
+
+/**
+ * @param handle Group containing a `feature_index` group, as created by `save()`.
+ * @return Map of modality names to their indices.
+ */
+inline std::unordered_map<std::string, ModalityIndex> load(const H5::Group& handle) {
+    auto ihandle = utils::check_and_open_group(handle, "feature_index");
+    std::unordered_map<std::string, ModalityIndex> output;
+
+    size_t nmod = ihandle.getNumObjs();
+    for (size_t m = 0; m < nmod; ++m) {
+        std::string mod = ihandle.getObjnameByIdx(m);
+        auto mhandle = utils::check_and_open_group(ihandle, mod);
+        auto load_index = [&](const std::string& name, Index& index) -> void {
+            auto xhandle = utils::check_and_open_group(mhandle, name);
+            index.names = utils::load_string_vector(xhandle, "names");
+            index.indices = utils::load_integer_vector<int>(xhandle, "indices");
+            if (index.names.size() != index.indices.size()) {
+                throw std::runtime_error("'names' and 'indices' should have the same length in '" + mod + "/" + name + "'");
+            }
+        };
+
+        auto& current = output[mod];
+        load_index("ids", current.ids);
+        load_index("symbols", current.symbols);
+    }
+
+    return output;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,482 @@
+#ifndef KANAVAL_GZIP_INDEX_HPP
+#define KANAVAL_GZIP_INDEX_HPP
+
+#include "H5Cpp.h"
+#include "zlib.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include "utils.hpp"
+#include "write_utils.hpp"
+#include "embedded.hpp"
+
+/**
+ * @file gzip_index.hpp
+ *
+ * @brief Random access into Gzip-compressed embedded files.
+ */
+
+namespace kanaval {
+
+namespace gzip_index {
+
+/**
+ * Size of the Deflate window that must be stored at each checkpoint.
+ */
+inline constexpr size_t window_size = 32768;
+
+/**
+ * @brief A point at which decompression can be resumed.
+ */
+struct Checkpoint {
+    /**
+     * Offset in the compressed file.
+     * If `bits > 0`, decompression starts from the byte before this offset.
+     */
+    hsize_t compressed = 0;
+
+    /**
+     * Offset in the decompressed contents.
+     */
+    hsize_t uncompressed = 0;
+
+    /**
+     * Number of bits from the byte before `compressed` that belong to the next Deflate block.
+     * A value of -1 indicates that the checkpoint is at the start of a Gzip member, in which case no `window` is necessary.
+     */
+    int bits = 0;
+
+    /**
+     * The last `window_size` bytes of decompressed contents before this checkpoint.
+     */
+    std::vector<unsigned char> window;
+};
+
+/**
+ * @brief Index of checkpoints for a Gzip-compressed file.
+ */
+struct Index {
+    /**
+     * Size of the decompressed contents.
+     */
+    hsize_t total = 0;
+
+    /**
+     * Checkpoints, in order of increasing offset.
+     */
+    std::vector<Checkpoint> points;
+};
+
+/**
+ * @cond
+ */
+class Reader {
+public:
+    Reader(const embedded::Location& loc, hsize_t start) : location(loc), input(loc.path, std::ios::binary), buffer(65536), position(start) {
+        if (!input) {
+            throw std::runtime_error("failed to open '" + location.path + "'");
+        }
+        input.seekg(location.offset + start);
+    }
+
+    // Fills the stream's input buffer if it is empty; returns false if the end of the file is reached.
+    bool fill(z_stream& strm) {
+        if (strm.avail_in) {
+            return true;
+        }
+        hsize_t remaining = location.size - position;
+        if (remaining == 0) {
+            return false;
+        }
+        size_t len = std::min<hsize_t>(buffer.size(), remaining);
+        input.read(reinterpret_cast<char*>(buffer.data()), len);
+        if (static_cast<size_t>(input.gcount()) != len) {
+            throw std::runtime_error("failed to read from '" + location.path + "'");
+        }
+        position += len;
+        strm.next_in = buffer.data();
+        strm.avail_in = len;
+        return true;
+    }
+
+    int get() {
+        unsigned char c;
+        input.read(reinterpret_cast<char*>(&c), 1);
+        ++position;
+        return c;
+    }
+
+private:
+    const embedded::Location& location;
+    std::ifstream input;
+    std::vector<unsigned char> buffer;
+    hsize_t position;
+};
+
+struct Inflater {
+    Inflater(int wbits) {
+        if (inflateInit2(&strm, wbits) != Z_OK) {
+            throw std::runtime_error("failed to initialize the Gzip decompressor");
+        }
+    }
+
+    ~Inflater() {
+        inflateEnd(&strm);
+    }
+
+    z_stream strm{};
+};
+/**
+ * @endcond
+ */
+
+/**
+ * Build an index of checkpoints for a Gzip-compressed file, following the approach in **zlib**'s `zran.c` example.
+ * The file is decompressed once and a checkpoint is recorded at the first Deflate block boundary after every `spacing` bytes of decompressed output, as well as at the start of every Gzip member.
+ *
+ * @param location Location of the Gzip-compressed file, usually from `embedded::locate_in_kana()` or `embedded::locate_in_directory()`.
+ * @param spacing Approximate distance between checkpoints in the decompressed contents.
+ * Smaller values improve random access speed at the cost of a larger index.
+ *
+ * @return Index of checkpoints for `location`.
+ */
+inline Index build(const embedded::Location& location, hsize_t spacing = 4194304) {
+    Index output;
+    Reader reader(location, 0);
+    Inflater inflater(47);
+    auto& strm = inflater.strm;
+
+    std::vector<unsigned char> window(window_size);
+    hsize_t totin = 0, totout = 0, last = 0;
+    bool at_member_start = true;
+
+    auto add_point = [&](int bits) -> void {
+        Checkpoint point;
+        point.compressed = totin;
+        point.uncompressed = totout;
+        point.bits = bits;
+        if (bits >= 0) {
+            // The output buffer is used as a circular window.
+            point.window.resize(window_size);
+            size_t left = strm.avail_out;
+            if (left) {
+                std::memcpy(point.window.data(), window.data() + window_size - left, left);
+            }
+            if (left < window_size) {
+                std::memcpy(point.window.data() + left, window.data(), window_size - left);
+            }
+        }
+        output.points.push_back(std::move(point));
+        last = totout;
+    };
+
+    add_point(-1);
+    strm.avail_out = 0;
+
+    while (true) {
+        if (!reader.fill(strm)) {
+            if (at_member_start) {
+                break;
+            }
+            throw std::runtime_error("truncated Gzip-compressed contents");
+        }
+
+        if (strm.avail_out == 0) {
+            strm.avail_out = window_size;
+            strm.next_out = window.data();
+        }
+
+        totin += strm.avail_in;
+        totout += strm.avail_out;
+        int ret = inflate(&strm, Z_BLOCK);
+        totin -= strm.avail_in;
+        totout -= strm.avail_out;
+
+        if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+            throw std::runtime_error("failed to decompress Gzip-compressed contents");
+        }
+        at_member_start = false;
+
+        if (ret == Z_STREAM_END) {
+            // Concatenated members are restarted from their own headers.
+            inflateReset(&strm);
+            at_member_start = true;
+            if (reader.fill(strm)) {
+                add_point(-1);
+            }
+            continue;
+        }
+
+        if ((strm.data_type & 128) && !(strm.data_type & 64) && totout - last > spacing) {
+            add_point(strm.data_type & 7);
+        }
+    }
+
+    output.total = totout;
+    return output;
+}
+
+/**
+ * Decompress a range of bytes from a Gzip-compressed file, starting from the closest preceding checkpoint.
+ * This function is thread-safe, so multiple ranges can be decompressed in parallel.
+ *
+ * @param location Location of the Gzip-compressed file.
+ * @param index Index for `location`, from `build()` or `load()`.
+ * @param start Offset of the first decompressed byte to extract.
+ * @param len Number of decompressed bytes to extract.
+ * This is truncated to the end of the decompressed contents.
+ * @param[out] buffer Pointer to an array of length `len`.
+ *
+ * @return Number of bytes written to `buffer`.
+ */
+inline hsize_t extract(const embedded::Location& location, const Index& index, hsize_t start, hsize_t len, unsigned char* buffer) {
+    if (start >= index.total || len == 0) {
+        return 0;
+    }
+    len = std::min(len, index.total - start);
+
+    auto it = std::upper_bound(index.points.begin(), index.points.end(), start, [](hsize_t s, const Checkpoint& p) -> bool { return s < p.uncompressed; });
+    if (it == index.points.begin()) {
+        throw std::runtime_error("no checkpoint precedes the requested range");
+    }
+    const auto& point = *(it - 1);
+
+    bool raw = point.bits >= 0;
+    Inflater inflater(raw ? -15 : 47);
+    auto& strm = inflater.strm;
+    Reader reader(location, point.compressed - (point.bits > 0 ? 1 : 0));
+    if (point.bits > 0) {
+        int ch = reader.get();
+        inflatePrime(&strm, point.bits, ch >> (8 - point.bits));
+    }
+    if (raw) {
+        inflateSetDictionary(&strm, point.window.data(), window_size);
+    }
+
+    std::vector<unsigned char> discard(window_size);
+    hsize_t skip = start - point.uncompressed;
+    hsize_t filled = 0;
+
+    while (filled < len) {
+        if (skip) {
+            strm.next_out = discard.data();
+            strm.avail_out = std::min<hsize_t>(skip, window_size);
+        } else {
+            strm.next_out = buffer + filled;
+            strm.avail_out = std::min<hsize_t>(len - filled, 1u << 30);
+        }
+        size_t requested = strm.avail_out;
+
+        if (!reader.fill(strm)) {
+            throw std::runtime_error("truncated Gzip-compressed contents");
+        }
+        int ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+            throw std::runtime_error("failed to decompress Gzip-compressed contents");
+        }
+
+        size_t produced = requested - strm.avail_out;
+        if (skip) {
+            skip -= produced;
+        } else {
+            filled += produced;
+        }
+
+        if (ret == Z_STREAM_END) {
+            if (raw) {
+                // Skipping the trailer of the current member before parsing the next header.
+                for (int i = 0; i < 8; ++i) {
+                    if (!reader.fill(strm)) {
+                        throw std::runtime_error("truncated Gzip trailer");
+                    }
+                    ++strm.next_in;
+                    --strm.avail_in;
+                }
+                inflateReset2(&strm, 47);
+                raw = false;
+            } else {
+                inflateReset(&strm);
+            }
+        }
+    }
+
+    return filled;
+}
+
+/**
+ * @param location Location of the Gzip-compressed file.
+ * @param index Index for `location`, from `build()` or `load()`.
+ * @param start Offset of the first decompressed byte to extract.
+ * @param len Number of decompressed bytes to extract.
+ *
+ * @return The decompressed bytes in the requested range.
+ */
+inline std::string extract(const embedded::Location& location, const Index& index, hsize_t start, hsize_t len) {
+    len = (start < index.total ? std::min(len, index.total - start) : 0);
+    std::string output(len, '\0');
+    extract(location, index, start, len, reinterpret_cast<unsigned char*>(&output[0]));
+    return output;
+}
+
+/**
+ * Decompress an entire Gzip-compressed file in parallel.
+ * The decompressed contents are split into contiguous ranges at the checkpoints, and each thread decompresses a range with `extract()`.
+ *
+ * @param location Location of the Gzip-compressed file.
+ * @param index Index for `location`, from `build()` or `load()`.
+ * @param num_threads Number of threads to use.
+ *
+ * @return The decompressed contents.
+ */
+inline std::string decompress(const embedded::Location& location, const Index& index, int num_threads = 1) {
+    std::string output(index.total, '\0');
+    auto ptr = reinterpret_cast<unsigned char*>(&output[0]);
+
+    // Assigning checkpoint boundaries to threads based on the decompressed size.
+    size_t nthreads = std::max(1, num_threads);
+    std::vector<hsize_t> bounds { 0 };
+    for (size_t t = 1; t < nthreads; ++t) {
+        hsize_t target = (index.total * t) / nthreads;
+        auto it = std::upper_bound(index.points.begin(), index.points.end(), target, [](hsize_t s, const Checkpoint& p) -> bool { return s < p.uncompressed; });
+        if (it == index.points.begin()) {
+            continue; // e.g., empty index, in which case extract() will complain.
+        }
+        hsize_t boundary = (it - 1)->uncompressed;
+        if (boundary > bounds.back()) {
+            bounds.push_back(boundary);
+        }
+    }
+    bounds.push_back(index.total);
+
+    size_t njobs = bounds.size() - 1;
+    if (njobs == 1) {
+        extract(location, index, 0, index.total, ptr);
+        return output;
+    }
+
+    std::vector<std::thread> workers;
+    std::vector<std::string> errors(njobs);
+    workers.reserve(njobs);
+    for (size_t j = 0; j < njobs; ++j) {
+        workers.emplace_back([&](size_t job) -> void {
+            try {
+                extract(location, index, bounds[job], bounds[job + 1] - bounds[job], ptr + bounds[job]);
+            } catch (std::exception& e) {
+                errors[job] = e.what();
+            }
+        }, j);
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    for (const auto& e : errors) {
+        if (!e.empty()) {
+            throw std::runtime_error(e);
+        }
+    }
+    return output;
+}
+
+/**
+ * Save an index into a HDF5 group, e.g., in a sidecar file alongside the `*.kana` file.
+ * This creates a group at `name` containing:
+ *
+ * - `compressed`, `uncompressed` and `bits`: integer datasets containing the corresponding fields of each `Checkpoint`.
+ * - `windows`: a 2-dimensional unsigned 8-bit integer dataset where each row contains the window for a checkpoint (or zeros, if `bits = -1`).
+ *   This is compressed with Deflate.
+ * - `total`: an integer scalar containing the size of the decompressed contents.
+ *
+ * @param handle Parent group.
+ * @param name Name of the group to create.
+ * @param index Index to save.
+ */
+inline void save(const H5::Group& handle, const std::string& name, const Index& index) {
+    auto ghandle = handle.createGroup(name);
+    hsize_t npoints = index.points.size();
+
+    std::vector<hsize_t> compressed, uncompressed;
+    std::vector<int> bits;
+    for (const auto& p : index.points) {
+        compressed.push_back(p.compressed);
+        uncompressed.push_back(p.uncompressed);
+        bits.push_back(p.bits);
+    }
+
+    H5::DataSpace vspace(1, &npoints);
+    ghandle.createDataSet("compressed", H5::PredType::NATIVE_HSIZE, vspace).write(compressed.data(), H5::PredType::NATIVE_HSIZE);
+    ghandle.createDataSet("uncompressed", H5::PredType::NATIVE_HSIZE, vspace).write(uncompressed.data(), H5::PredType::NATIVE_HSIZE);
+    utils::write_integer_vector(ghandle, "bits", bits);
+
+    hsize_t total = index.total;
+    ghandle.createDataSet("total", H5::PredType::NATIVE_HSIZE, H5S_SCALAR).write(&total, H5::PredType::NATIVE_HSIZE);
+
+    hsize_t wdims[2] = { npoints, window_size };
+    H5::DSetCreatPropList plist;
+    if (npoints) {
+        hsize_t chunks[2] = { 1, window_size };
+        plist.setChunk(2, chunks);
+        plist.setDeflate(6);
+    }
+    auto whandle = ghandle.createDataSet("windows", H5::PredType::NATIVE_UINT8, H5::DataSpace(2, wdims), plist);
+
+    std::vector<unsigned char> empty(window_size);
+    hsize_t count[2] = { 1, window_size };
+    H5::DataSpace mspace(2, count);
+    for (hsize_t p = 0; p < npoints; ++p) {
+        hsize_t offset[2] = { p, 0 };
+        auto dspace = whandle.getSpace();
+        dspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+        const auto& w = index.points[p].window;
+        whandle.write(w.empty() ? empty.data() : w.data(), H5::PredType::NATIVE_UINT8, mspace, dspace);
+    }
+}
+
+/**
+ * @param handle Parent group.
+ * @param name Name of the group created by `save()`.
+ *
+ * @return The index.
+ */
+inline Index load(const H5::Group& handle, const std::string& name) {
+    auto ghandle = utils::check_and_open_group(handle, name);
+    auto compressed = utils::load_integer_vector<hsize_t>(ghandle, "compressed");
+    auto uncompressed = utils::load_integer_vector<hsize_t>(ghandle, "uncompressed");
+    auto bits = utils::load_integer_vector<int>(ghandle, "bits");
+    size_t npoints = compressed.size();
+    if (uncompressed.size() != npoints || bits.size() != npoints) {
+        throw std::runtime_error("checkpoint fields should have the same length in '" + name + "'");
+    }
+
+    Index output;
+    output.total = utils::load_integer_scalar<hsize_t>(ghandle, "total");
+    auto whandle = utils::check_and_open_dataset(ghandle, "windows", H5T_INTEGER, { npoints, window_size });
+
+    hsize_t count[2] = { 1, window_size };
+    H5::DataSpace mspace(2, count);
+    output.points.resize(npoints);
+    for (size_t p = 0; p < npoints; ++p) {
+        auto& point = output.points[p];
+        point.compressed = compressed[p];
+        point.uncompressed = uncompressed[p];
+        point.bits = bits[p];
+        if (point.bits >= 0) {
+            point.window.resize(window_size);
+            hsize_t offset[2] = { p, 0 };
+            auto dspace = whandle.getSpace();
+            dspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+            whandle.read(point.window.data(), H5::PredType::NATIVE_UINT8, mspace, dspace);
+        }
+    }
+
+    return output;
+}
+
+}
+
+}
+
+#endif
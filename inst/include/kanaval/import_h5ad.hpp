@@ -0,0 +1,697 @@
+#ifndef KANAVAL_IMPORT_H5AD_HPP
+#define KANAVAL_IMPORT_H5AD_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <memory>
+#include <functional>
+#include "utils.hpp"
+#include "misc.hpp"
+#include "inspect.hpp"
+#include "streaming.hpp"
+#include "write_utils.hpp"
+#include "progress.hpp"
+#include "cluster_summaries.hpp"
+
+/**
+ * @file import_h5ad.hpp
+ *
+ * @brief Import analysis results from a H5AD file into a state file.
+ */
+
+namespace kanaval {
+
+namespace h5ad {
+
+/**
+ * @brief Options for `import_state()`.
+ */
+struct ImportOptions {
+    /**
+     * Name of the `obs` column containing the cluster assignments.
+     * If empty, the first available column of `"leiden"`, `"louvain"`, `"clusters"` or `"seurat_clusters"` is used.
+     * If none are available, all cells are assigned to a single cluster.
+     */
+    std::string cluster_column;
+
+    /**
+     * Name of the `obsm` entry containing the PCs.
+     */
+    std::string pca_key = "X_pca";
+
+    /**
+     * Name of the `obsm` entry containing the t-SNE coordinates.
+     */
+    std::string tsne_key = "X_tsne";
+
+    /**
+     * Name of the `obsm` entry containing the UMAP coordinates.
+     */
+    std::string umap_key = "X_umap";
+
+    /**
+     * Number of cells to process in each block.
+     */
+    hsize_t block_size = 65536;
+
+    /**
+     * Deflate compression level for the per-cell datasets.
+     */
+    int compression_level = 6;
+
+    /**
+     * Function to be called with the name of each step after it is marked as complete, e.g., to report progress.
+     * Readers in other processes can access the step's results once this is called.
+     */
+    std::function<void(const std::string&)> on_complete;
+};
+
+/**
+ * @cond
+ */
+inline std::string read_string_attribute(const H5::H5Object& handle, const std::string& name) {
+    auto ahandle = handle.openAttribute(name);
+    std::string output;
+    ahandle.read(ahandle.getStrType(), output);
+    return output;
+}
+
+inline hsize_t dataframe_size(const H5::Group& handle, const std::string& name) {
+    if (!inspect::has_group(handle, name)) {
+        throw std::runtime_error("'" + name + "' should be a dataframe-encoded group");
+    }
+    auto dfhandle = handle.openGroup(name);
+    std::string index = "_index";
+    if (dfhandle.attrExists("_index")) {
+        index = read_string_attribute(dfhandle, "_index");
+    }
+    auto dims = utils::get_dimensions(utils::check_and_open_dataset(dfhandle, index));
+    if (dims.size() != 1) {
+        throw std::runtime_error("index of '" + name + "' should be 1-dimensional");
+    }
+    return dims[0];
+}
+
+/*
+ * Create the dataset for a per-cell matrix from obsm, returning a function
+ * that copies its contents. Python-based writers store this as a row-major
+ * cell-by-dimension array, which matches the state file layout; column-major
+ * writers (e.g., from R) store the transpose, which is fixed with a
+ * cache-blocked transpose on each block of cells.
+ */
+inline std::function<void()> prepare_embedding(const H5::DataSet& source, const H5::Group& output, const std::string& name, hsize_t num_cells, const ImportOptions& options, hsize_t& ndims) {
+    auto dims = utils::get_dimensions(source);
+    if (dims.size() != 2) {
+        throw std::runtime_error("expected a 2-dimensional array");
+    }
+
+    if (dims[0] == num_cells) {
+        ndims = dims[1];
+        auto writer = std::make_shared<streaming::RowWriter>(output, name, H5::PredType::NATIVE_DOUBLE, num_cells, ndims, options.compression_level);
+        return [=]() -> void {
+            streaming::for_each_block<double>(source, options.block_size, [&](hsize_t, hsize_t len, const double* ptr) -> void {
+                writer->write(ptr, len);
+            });
+            writer->finalize(num_cells);
+        };
+    }
+
+    if (dims[1] != num_cells) {
+        throw std::runtime_error("array dimensions are not consistent with the number of cells");
+    }
+
+    ndims = dims[0];
+    hsize_t nd = ndims;
+    auto writer = std::make_shared<streaming::RowWriter>(output, name, H5::PredType::NATIVE_DOUBLE, num_cells, nd, options.compression_level);
+    hsize_t block_size = std::max<hsize_t>(1, options.block_size);
+    return [=]() -> void {
+        std::vector<double> buffer, transposed;
+        auto dspace = source.getSpace();
+        for (hsize_t start = 0; start < num_cells; start += block_size) {
+            hsize_t len = std::min(block_size, num_cells - start);
+            hsize_t offset[2] = { 0, start };
+            hsize_t count[2] = { nd, len };
+            dspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+            buffer.resize(nd * len);
+            source.read(buffer.data(), H5::PredType::NATIVE_DOUBLE, H5::DataSpace(2, count), dspace);
+            transposed.resize(buffer.size());
+            streaming::transpose(buffer.data(), nd, len, transposed.data());
+            writer->write(transposed.data(), len);
+        }
+        writer->finalize(num_cells);
+    };
+}
+
+/*
+ * Create the 'x' and 'y' datasets for a 2-column embedding, returning a
+ * function that splits the embedding into them.
+ */
+inline std::function<void()> prepare_coordinates(const H5::DataSet& source, const H5::Group& output, hsize_t num_cells, const ImportOptions& options) {
+    auto dims = utils::get_dimensions(source);
+    if (dims.size() != 2 || !((dims[0] == num_cells && dims[1] == 2) || (dims[0] == 2 && dims[1] == num_cells))) {
+        throw std::runtime_error("expected a 2-dimensional array with one row per cell and 2 columns");
+    }
+    bool by_row = (dims[0] == num_cells);
+
+    auto xwriter = std::make_shared<streaming::RowWriter>(output, "x", H5::PredType::NATIVE_DOUBLE, num_cells, 0, options.compression_level);
+    auto ywriter = std::make_shared<streaming::RowWriter>(output, "y", H5::PredType::NATIVE_DOUBLE, num_cells, 0, options.compression_level);
+
+    hsize_t block_size = std::max<hsize_t>(1, options.block_size);
+    return [=]() -> void {
+        std::vector<double> buffer, x, y;
+        auto dspace = source.getSpace();
+
+        for (hsize_t start = 0; start < num_cells; start += block_size) {
+            hsize_t len = std::min(block_size, num_cells - start);
+            hsize_t offset[2], count[2];
+            if (by_row) {
+                offset[0] = start; offset[1] = 0;
+                count[0] = len; count[1] = 2;
+            } else {
+                offset[0] = 0; offset[1] = start;
+                count[0] = 2; count[1] = len;
+            }
+            dspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+            buffer.resize(2 * len);
+            source.read(buffer.data(), H5::PredType::NATIVE_DOUBLE, H5::DataSpace(2, count), dspace);
+
+            x.resize(len);
+            y.resize(len);
+            for (hsize_t i = 0; i < len; ++i) {
+                if (by_row) {
+                    x[i] = buffer[2 * i];
+                    y[i] = buffer[2 * i + 1];
+                } else {
+                    x[i] = buffer[i];
+                    y[i] = buffer[len + i];
+                }
+            }
+            xwriter->write(x.data(), len);
+            ywriter->write(y.data(), len);
+        }
+    };
+}
+
+inline H5::DataSet find_cluster_codes(const H5::Group& obs, const ImportOptions& options, std::string& column) {
+    std::vector<std::string> candidates;
+    if (!options.cluster_column.empty()) {
+        candidates.push_back(options.cluster_column);
+    } else {
+        candidates = std::vector<std::string>{ "leiden", "louvain", "clusters", "seurat_clusters" };
+    }
+
+    for (const auto& c : candidates) {
+        if (inspect::has_group(obs, c)) {
+            column = c;
+            return utils::check_and_open_dataset(obs.openGroup(c), "codes", H5T_INTEGER);
+        } else if (inspect::has_dataset(obs, c)) {
+            column = c;
+            return utils::check_and_open_dataset(obs, c, H5T_INTEGER);
+        }
+    }
+
+    if (!options.cluster_column.empty()) {
+        throw std::runtime_error("failed to find '" + options.cluster_column + "' in 'obs'");
+    }
+    column.clear();
+    return H5::DataSet();
+}
+
+/*
+ * Two passes over the codes: the first identifies the used levels, and the
+ * second (in the returned function) writes the codes after dropping unused
+ * levels, as each cluster must be represented at least once in the state file.
+ * AnnData uses -1 for missing values in categoricals, so these cells are
+ * assigned to an extra "unassigned" cluster after all used levels; its index
+ * is stored in the 'unassigned' attribute of the clusters dataset.
+ */
+inline std::function<void()> prepare_clusters(const H5::DataSet& codes, const H5::Group& output, hsize_t num_cells, const ImportOptions& options, int& nclusters) {
+    auto dims = utils::get_dimensions(codes);
+    if (dims.size() != 1 || dims[0] != num_cells) {
+        throw std::runtime_error("cluster codes should be a 1-dimensional array with one entry per cell");
+    }
+
+    std::vector<int> remapping;
+    bool has_missing = false;
+    streaming::for_each_block<int>(codes, options.block_size, [&](hsize_t, hsize_t len, const int* ptr) -> void {
+        for (hsize_t i = 0; i < len; ++i) {
+            if (ptr[i] == -1) {
+                has_missing = true;
+                continue;
+            }
+            if (ptr[i] < 0) {
+                throw std::runtime_error("cluster codes should be non-negative or -1 for missing values");
+            }
+            if (static_cast<size_t>(ptr[i]) >= remapping.size()) {
+                remapping.resize(ptr[i] + 1);
+            }
+            remapping[ptr[i]] = 1;
+        }
+    });
+
+    nclusters = 0;
+    for (auto& r : remapping) {
+        if (r) {
+            r = nclusters;
+            ++nclusters;
+        }
+    }
+
+    int unassigned = -1;
+    if (has_missing) {
+        unassigned = nclusters;
+        ++nclusters;
+    }
+
+    auto writer = std::make_shared<streaming::RowWriter>(output, "clusters", H5::PredType::NATIVE_INT32, num_cells, 0, options.compression_level);
+    if (has_missing) {
+        auto ahandle = writer->dataset().createAttribute("unassigned", H5::PredType::NATIVE_INT, H5::DataSpace(H5S_SCALAR));
+        ahandle.write(H5::PredType::NATIVE_INT, &unassigned);
+    }
+
+    return [=]() -> void {
+        std::vector<int> remapped;
+        streaming::for_each_block<int>(codes, options.block_size, [&](hsize_t, hsize_t len, const int* ptr) -> void {
+            remapped.resize(len);
+            for (hsize_t i = 0; i < len; ++i) {
+                remapped[i] = (ptr[i] == -1 ? unassigned : remapping[ptr[i]]);
+            }
+            writer->write(remapped.data(), len);
+        });
+    };
+}
+
+/*
+ * Create a dataset for the first available column from a dataframe, returning
+ * a function that copies its contents. If no column is available, a
+ * placeholder is created instead and an empty function is returned.
+ */
+inline std::function<void()> prepare_column(const H5::Group& df, const std::vector<std::string>& candidates, const H5::Group& output, const std::string& name, H5T_class_t type, hsize_t len, const ImportOptions& options, double fill = std::numeric_limits<double>::quiet_NaN()) {
+    for (const auto& c : candidates) {
+        if (!inspect::has_dataset(df, c)) {
+            continue;
+        }
+        auto source = df.openDataSet(c);
+        auto dims = utils::get_dimensions(source);
+        if (dims.size() != 1 || dims[0] != len) {
+            continue;
+        }
+
+        if (type == H5T_INTEGER) {
+            auto writer = std::make_shared<streaming::RowWriter>(output, name, H5::PredType::NATIVE_INT32, len, 0, options.compression_level);
+            return [=]() -> void {
+                streaming::for_each_block<int>(source, options.block_size, [&](hsize_t, hsize_t n, const int* ptr) -> void {
+                    writer->write(ptr, n);
+                });
+            };
+        } else {
+            auto writer = std::make_shared<streaming::RowWriter>(output, name, H5::PredType::NATIVE_DOUBLE, len, 0, options.compression_level);
+            return [=]() -> void {
+                streaming::for_each_block<double>(source, options.block_size, [&](hsize_t, hsize_t n, const double* ptr) -> void {
+                    writer->write(ptr, n);
+                });
+            };
+        }
+    }
+
+    utils::write_placeholder(output, name, type, { len }, fill);
+    return std::function<void()>();
+}
+
+inline void write_marker_placeholders(const H5::Group& handle, hsize_t num_features, int nclusters) {
+    for (int c = 0; c < nclusters; ++c) {
+        auto chandle = handle.createGroup(std::to_string(c));
+        utils::write_placeholder(chandle, "means", H5T_FLOAT, { num_features });
+        utils::write_placeholder(chandle, "detected", H5T_FLOAT, { num_features });
+        for (const auto& eff : markers::effects) {
+            auto ehandle = chandle.createGroup(eff);
+            for (std::string summary : { "mean", "min", "min_rank" }) {
+                utils::write_placeholder(ehandle, summary, H5T_FLOAT, { num_features });
+            }
+        }
+    }
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Create a state file from the analysis results in a H5AD file, e.g., as generated by **scanpy**.
+ * The state file follows version 2.0 of the format and describes a single-sample RNA dataset with a linked (non-embedded) H5AD input,
+ * such that it passes `validate()` with `embedded = false`.
+ * All per-cell arrays are copied in blocks of `ImportOptions::block_size` cells.
+ * The state file is written with a `progress::Writer`, so each step is marked as complete as soon as it is imported.
+ *
+ * The contents are mapped as follows:
+ *
+ * - The PCs in `obsm` are stored in the `pca` step, see `pca::validate()`.
+ *   The percentage of variance explained is taken from `uns/pca/variance_ratio` if available.
+ * - The t-SNE and UMAP coordinates in `obsm` are stored in the `tsne` and `umap` steps, respectively.
+ *   The centroid and range of each cluster are also computed and stored, see `cluster_summaries::validate()`.
+ * - The cluster assignments in `obs` are stored in the `snn_graph_cluster` step, after dropping unused levels.
+ *   Cells with missing assignments (i.e., a code of -1) are assigned to an extra cluster after all other clusters,
+ *   whose index is stored in the `unassigned` attribute of the `clusters` dataset.
+ * - The QC metrics in `obs` are stored in the `quality_control` step, using the `total_counts`, `n_genes_by_counts` and `pct_counts_mt` columns (or their older equivalents).
+ *   All cells are assumed to be retained.
+ * - The `means` and `variances` in `var` are stored in the `feature_selection` step.
+ *
+ * The H5AD file is assumed to contain an `obsm` entry for the PCs, i.e., `ImportOptions::pca_key`.
+ * Any other results that are required by the format but are absent from the H5AD file are stored as placeholder datasets that contain NaNs (or zeros, for integers and QC metrics) without occupying any space in the file.
+ * This includes the marker statistics, which cannot be computed without the expression matrix.
+ * Parameters are set to the **kana** defaults.
+ * As the H5AD file does not record how the clusters were generated, the `snn_graph_cluster` parameters and the `marker_detection` results are marked as unknown with `utils::mark_unknown()`;
+ * these should not be treated as real values by downstream checks, e.g., `snn_graph_cluster::verify()`.
+ *
+ * @param path Path to the H5AD file.
+ * @param output Path to the output state file.
+ * This is overwritten if it already exists.
+ * @param options Further options.
+ *
+ * @return The state file is created at `output`.
+ */
+inline void import_state(const std::string& path, const std::string& output, const ImportOptions& options = ImportOptions()) {
+    H5::H5File ihandle(path, H5F_ACC_RDONLY);
+    hsize_t num_cells = dataframe_size(ihandle, "obs");
+    hsize_t num_features = dataframe_size(ihandle, "var");
+    auto obs = ihandle.openGroup("obs");
+    auto var = ihandle.openGroup("var");
+
+    progress::Writer writer(output);
+
+    // All objects are created first, as HDF5 does not allow objects to be
+    // created after SWMR writing starts. Each step records a function that
+    // fills its per-cell datasets, which is run after SWMR writing starts.
+    struct Pending {
+        std::string step;
+        std::string context;
+        std::vector<std::function<void()> > fills;
+    };
+    std::vector<Pending> pending;
+    auto add_step = [&](const std::string& step, const std::string& context = "") -> Pending& {
+        pending.push_back(Pending{ step, context, {} });
+        return pending.back();
+    };
+    auto add_fill = [](Pending& current, std::function<void()> fill) -> void {
+        if (fill) {
+            current.fills.push_back(std::move(fill));
+        }
+    };
+
+    // Inputs.
+    {
+        auto ghandle = writer.declare("inputs");
+        auto phandle = ghandle.createGroup("parameters");
+        utils::write_string(phandle, "format", "H5AD");
+        auto fhandle = phandle.createGroup("files").createGroup("0");
+        auto slash = path.find_last_of('/');
+        utils::write_string(fhandle, "name", (slash == std::string::npos ? path : path.substr(slash + 1)));
+        utils::write_string(fhandle, "type", "h5");
+        utils::write_string(fhandle, "id", path);
+
+        auto rhandle = ghandle.createGroup("results");
+        utils::write_integer_scalar(rhandle, "num_cells", num_cells);
+        utils::write_integer_scalar(rhandle, "num_samples", 1);
+        utils::write_integer_scalar(rhandle.createGroup("num_features"), "RNA", num_features);
+        std::vector<int> identities(num_features);
+        std::iota(identities.begin(), identities.end(), 0);
+        utils::write_integer_vector(rhandle.createGroup("identities"), "RNA", identities);
+        add_step("inputs");
+    }
+
+    // Quality control.
+    try {
+        auto ghandle = writer.declare("quality_control");
+        auto phandle = ghandle.createGroup("parameters");
+        utils::write_integer_scalar(phandle, "use_mito_default", 1);
+        utils::write_string(phandle, "mito_prefix", "mt-");
+        utils::write_float_scalar(phandle, "nmads", 3);
+
+        auto& current = add_step("quality_control", "failed to import the quality control metrics");
+        auto rhandle = ghandle.createGroup("results");
+        auto mhandle = rhandle.createGroup("metrics");
+        add_fill(current, prepare_column(obs, { "total_counts", "n_counts" }, mhandle, "sums", H5T_FLOAT, num_cells, options, 0));
+        add_fill(current, prepare_column(obs, { "n_genes_by_counts", "n_genes" }, mhandle, "detected", H5T_INTEGER, num_cells, options, 0));
+        add_fill(current, prepare_column(obs, { "pct_counts_mt", "percent_mito" }, mhandle, "proportion", H5T_FLOAT, num_cells, options, 0));
+
+        auto thandle = rhandle.createGroup("thresholds");
+        for (std::string t : { "sums", "detected", "proportion" }) {
+            utils::write_placeholder(thandle, t, H5T_FLOAT, { 1 });
+        }
+        utils::write_placeholder(rhandle, "discards", H5T_INTEGER, { num_cells }, 0);
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to import the quality control metrics");
+    }
+
+    {
+        auto ghandle = writer.declare("adt_quality_control");
+        auto phandle = ghandle.createGroup("parameters");
+        utils::write_string(phandle, "igg_prefix", "IgG");
+        utils::write_float_scalar(phandle, "nmads", 3);
+        utils::write_float_scalar(phandle, "min_detected_drop", 0.1);
+        ghandle.createGroup("results");
+        add_step("adt_quality_control");
+    }
+
+    {
+        auto ghandle = writer.declare("cell_filtering");
+        ghandle.createGroup("parameters");
+        ghandle.createGroup("results");
+        add_step("cell_filtering");
+    }
+
+    // Normalization and feature selection.
+    {
+        auto ghandle = writer.declare("normalization");
+        ghandle.createGroup("parameters");
+        ghandle.createGroup("results");
+        add_step("normalization");
+    }
+
+    {
+        auto ghandle = writer.declare("adt_normalization");
+        auto phandle = ghandle.createGroup("parameters");
+        utils::write_integer_scalar(phandle, "num_pcs", 25);
+        utils::write_integer_scalar(phandle, "num_clusters", 20);
+        ghandle.createGroup("results");
+        add_step("adt_normalization");
+    }
+
+    try {
+        auto ghandle = writer.declare("feature_selection");
+        utils::write_float_scalar(ghandle.createGroup("parameters"), "span", 0.3);
+        auto& current = add_step("feature_selection", "failed to import the feature selection statistics");
+        auto rhandle = ghandle.createGroup("results");
+        add_fill(current, prepare_column(var, { "means" }, rhandle, "means", H5T_FLOAT, num_features, options));
+        add_fill(current, prepare_column(var, { "variances", "vars" }, rhandle, "vars", H5T_FLOAT, num_features, options));
+        add_fill(current, prepare_column(var, { "fitted" }, rhandle, "fitted", H5T_FLOAT, num_features, options));
+        add_fill(current, prepare_column(var, { "resids" }, rhandle, "resids", H5T_FLOAT, num_features, options));
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to import the feature selection statistics");
+    }
+
+    // Dimensionality reduction.
+    try {
+        auto obsm = utils::check_and_open_group(ihandle, "obsm");
+        auto source = utils::check_and_open_dataset(obsm, options.pca_key, H5T_FLOAT);
+
+        auto ghandle = writer.declare("pca");
+        auto& current = add_step("pca", "failed to import the PCs from 'obsm'");
+        auto rhandle = ghandle.createGroup("results");
+        hsize_t npcs = 0;
+        add_fill(current, prepare_embedding(source, rhandle, "pcs", num_cells, options, npcs));
+
+        bool has_var_exp = false;
+        if (inspect::has_group(ihandle, "uns")) {
+            auto uns = ihandle.openGroup("uns");
+            if (inspect::has_group(uns, "pca") && inspect::has_dataset(uns.openGroup("pca"), "variance_ratio")) {
+                auto vhandle = uns.openGroup("pca").openDataSet("variance_ratio");
+                auto vdims = utils::get_dimensions(vhandle);
+                if (vdims.size() == 1 && vdims[0] == npcs) {
+                    std::vector<double> ratio(npcs);
+                    vhandle.read(ratio.data(), H5::PredType::NATIVE_DOUBLE);
+                    for (auto& r : ratio) {
+                        r *= 100;
+                    }
+                    utils::write_float_vector(rhandle, "var_exp", ratio);
+                    has_var_exp = true;
+                }
+            }
+        }
+        if (!has_var_exp) {
+            utils::write_placeholder(rhandle, "var_exp", H5T_FLOAT, { npcs });
+        }
+
+        auto phandle = ghandle.createGroup("parameters");
+        utils::write_integer_scalar(phandle, "num_hvgs", std::min<hsize_t>(2000, num_features));
+        utils::write_integer_scalar(phandle, "num_pcs", npcs);
+        utils::write_string(phandle, "block_method", "none");
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to import the PCs from 'obsm'");
+    }
+
+    {
+        auto ghandle = writer.declare("adt_pca");
+        auto phandle = ghandle.createGroup("parameters");
+        utils::write_integer_scalar(phandle, "num_pcs", 20);
+        utils::write_string(phandle, "block_method", "none");
+        ghandle.createGroup("results");
+        add_step("adt_pca");
+    }
+
+    {
+        auto ghandle = writer.declare("combine_embeddings");
+        auto phandle = ghandle.createGroup("parameters");
+        utils::write_integer_scalar(phandle, "approximate", 1);
+        phandle.createGroup("weights");
+        ghandle.createGroup("results");
+        add_step("combine_embeddings");
+    }
+
+    {
+        auto ghandle = writer.declare("batch_correction");
+        auto phandle = ghandle.createGroup("parameters");
+        utils::write_integer_scalar(phandle, "num_neighbors", 15);
+        utils::write_integer_scalar(phandle, "approximate", 1);
+        utils::write_string(phandle, "method", "none");
+        ghandle.createGroup("results");
+        add_step("batch_correction");
+    }
+
+    {
+        auto ghandle = writer.declare("neighbor_index");
+        utils::write_integer_scalar(ghandle.createGroup("parameters"), "approximate", 1);
+        ghandle.createGroup("results");
+        add_step("neighbor_index");
+    }
+
+    // Clustering.
+    int nclusters = 1;
+    {
+        auto ghandle = writer.declare("choose_clustering");
+        utils::write_string(ghandle.createGroup("parameters"), "method", "snn_graph");
+        ghandle.createGroup("results");
+        add_step("choose_clustering");
+    }
+
+    {
+        auto ghandle = writer.declare("kmeans_cluster");
+        utils::write_integer_scalar(ghandle.createGroup("parameters"), "k", 10);
+        ghandle.createGroup("results");
+        add_step("kmeans_cluster");
+    }
+
+    try {
+        auto ghandle = writer.declare("snn_graph_cluster");
+        auto phandle = ghandle.createGroup("parameters");
+        utils::write_integer_scalar(phandle, "k", 10);
+        utils::write_string(phandle, "scheme", "rank");
+        utils::write_float_scalar(phandle, "resolution", 1);
+        utils::mark_unknown(phandle);
+
+        auto& current = add_step("snn_graph_cluster", "failed to import the clusters from 'obs'");
+        auto rhandle = ghandle.createGroup("results");
+        std::string column;
+        auto codes = find_cluster_codes(obs, options, column);
+        if (column.empty()) {
+            utils::write_placeholder(rhandle, "clusters", H5T_INTEGER, { num_cells }, 0);
+        } else {
+            add_fill(current, prepare_clusters(codes, rhandle, num_cells, options, nclusters));
+        }
+        if (num_cells == 0) {
+            nclusters = 0;
+        }
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to import the clusters from 'obs'");
+    }
+
+    // Visualization.
+    for (std::string step : { "tsne", "umap" }) {
+        try {
+            auto ghandle = writer.declare(step);
+            auto phandle = ghandle.createGroup("parameters");
+            if (step == "tsne") {
+                utils::write_float_scalar(phandle, "perplexity", 30);
+                utils::write_integer_scalar(phandle, "iterations", 500);
+            } else {
+                utils::write_integer_scalar(phandle, "num_neighbors", 15);
+                utils::write_integer_scalar(phandle, "num_epochs", 500);
+                utils::write_float_scalar(phandle, "min_dist", 0.1);
+            }
+            utils::write_integer_scalar(phandle, "animate", 0);
+
+            auto& current = add_step(step, "failed to import the '" + step + "' coordinates");
+            auto rhandle = ghandle.createGroup("results");
+            const auto& key = (step == "tsne" ? options.tsne_key : options.umap_key);
+            if (inspect::has_group(ihandle, "obsm") && inspect::has_dataset(ihandle.openGroup("obsm"), key)) {
+                add_fill(current, prepare_coordinates(ihandle.openGroup("obsm").openDataSet(key), rhandle, num_cells, options));
+                cluster_summaries::create(rhandle, nclusters);
+
+                // The clusters are filled in an earlier step, so they are available by the time this runs.
+                const auto& file = writer.file();
+                int ncl = nclusters;
+                add_fill(current, [=]() -> void {
+                    auto clusters = file.openDataSet("snn_graph_cluster/results/clusters");
+                    cluster_summaries::write(rhandle, cluster_summaries::compute(rhandle, clusters, ncl, 1, options.block_size));
+                });
+            } else {
+                utils::write_placeholder(rhandle, "x", H5T_FLOAT, { num_cells });
+                utils::write_placeholder(rhandle, "y", H5T_FLOAT, { num_cells });
+            }
+        } catch (std::exception& e) {
+            throw utils::combine_errors(e, "failed to import the '" + step + "' coordinates");
+        }
+    }
+
+    // Markers and annotation.
+    {
+        auto ghandle = writer.declare("marker_detection");
+        ghandle.createGroup("parameters");
+        auto rhandle = ghandle.createGroup("results");
+        utils::mark_unknown(rhandle);
+        auto mhandle = rhandle.createGroup("per_cluster").createGroup("RNA");
+        write_marker_placeholders(mhandle, num_features, nclusters);
+        add_step("marker_detection");
+    }
+
+    {
+        auto ghandle = writer.declare("custom_selections");
+        ghandle.createGroup("parameters").createGroup("selections");
+        ghandle.createGroup("results").createGroup("per_selection");
+        add_step("custom_selections");
+    }
+
+    {
+        auto ghandle = writer.declare("cell_labelling");
+        auto phandle = ghandle.createGroup("parameters");
+        utils::write_string_vector(phandle, "human_references", {});
+        utils::write_string_vector(phandle, "mouse_references", {});
+        ghandle.createGroup("results").createGroup("per_reference");
+        add_step("cell_labelling");
+    }
+
+    // Filling the per-cell contents, so that readers can access each step as soon as it is complete.
+    writer.start_swmr();
+    for (const auto& current : pending) {
+        try {
+            for (const auto& fill : current.fills) {
+                fill();
+            }
+        } catch (std::exception& e) {
+            throw utils::combine_errors(e, current.context);
+        }
+        writer.complete(current.step);
+        if (options.on_complete) {
+            options.on_complete(current.step);
+        }
+    }
+}
+
+}
+
+}
+
+#endif
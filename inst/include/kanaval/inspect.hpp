@@ -0,0 +1,423 @@
+#ifndef KANAVAL_INSPECT_HPP
+#define KANAVAL_INSPECT_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include "utils.hpp"
+
+/**
+ * @file inspect.hpp
+ *
+ * @brief Summarize the parameters and dimensions of a state file.
+ */
+
+namespace kanaval {
+
+namespace inspect {
+
+/**
+ * @brief Summary of the parameters and dimensions of a state file.
+ *
+ * Integer and float fields are set to -1, and string fields are left empty, if the corresponding dataset is absent from the file.
+ */
+struct Summary {
+    /**
+     * @brief Summary of the inputs.
+     */
+    struct Inputs {
+        /**
+         * Format of each matrix.
+         */
+        std::vector<std::string> formats;
+
+        /**
+         * Available modalities in the dataset.
+         */
+        std::vector<std::string> modalities;
+
+        /**
+         * Number of features for each modality in `modalities`.
+         */
+        std::vector<int> num_features;
+
+        /**
+         * Number of cells before quality filtering.
+         */
+        int num_cells = -1;
+
+        /**
+         * Number of samples.
+         */
+        int num_samples = -1;
+    };
+
+    /**
+     * Summary of the inputs.
+     */
+    Inputs inputs;
+
+    /**
+     * Number of MADs used for the RNA-based quality control.
+     */
+    double quality_control_nmads = -1;
+
+    /**
+     * Number of MADs used for the ADT-based quality control.
+     */
+    double adt_quality_control_nmads = -1;
+
+    /**
+     * Number of cells after quality filtering, as determined from the extent of the PC matrix.
+     */
+    int num_filtered_cells = -1;
+
+    /**
+     * @brief Summary of a PCA step.
+     */
+    struct PCA {
+        /**
+         * Number of HVGs used to compute the PCA.
+         * Only used for the RNA-based PCA.
+         */
+        int num_hvgs = -1;
+
+        /**
+         * Number of requested PCs.
+         */
+        int num_pcs = -1;
+
+        /**
+         * Number of PCs that were actually stored.
+         */
+        int num_pcs_stored = -1;
+
+        /**
+         * Method used to handle multiple blocks.
+         */
+        std::string block_method;
+    };
+
+    /**
+     * Summary of the RNA-based PCA.
+     */
+    PCA pca;
+
+    /**
+     * Summary of the ADT-based PCA.
+     */
+    PCA adt_pca;
+
+    /**
+     * Number of dimensions in the combined embedding.
+     */
+    int num_combined_dims = -1;
+
+    /**
+     * Batch correction method.
+     */
+    std::string batch_correction_method;
+
+    /**
+     * Number of dimensions in the batch-corrected embedding.
+     */
+    int num_corrected_dims = -1;
+
+    /**
+     * Clustering method used by downstream steps.
+     */
+    std::string clustering_method;
+
+    /**
+     * Number of clusters for k-means clustering.
+     */
+    int kmeans_k = -1;
+
+    /**
+     * Number of neighbors for SNN graph clustering.
+     */
+    int snn_k = -1;
+
+    /**
+     * Edge weighting scheme for SNN graph clustering.
+     */
+    std::string snn_scheme;
+
+    /**
+     * Resolution for SNN graph clustering.
+     */
+    double snn_resolution = -1;
+
+    /**
+     * Number of clusters, as determined from the number of groups in the marker detection results.
+     */
+    int num_clusters = -1;
+
+    /**
+     * Perplexity for the t-SNE.
+     */
+    double tsne_perplexity = -1;
+
+    /**
+     * Number of iterations for the t-SNE.
+     */
+    int tsne_iterations = -1;
+
+    /**
+     * Number of neighbors for the UMAP.
+     */
+    int umap_num_neighbors = -1;
+
+    /**
+     * Number of epochs for the UMAP.
+     */
+    int umap_num_epochs = -1;
+
+    /**
+     * Minimum distance for the UMAP.
+     */
+    double umap_min_dist = -1;
+
+    /**
+     * Number of custom selections.
+     */
+    int num_custom_selections = -1;
+
+    /**
+     * Names of the references used for cell labelling, across both species.
+     */
+    std::vector<std::string> labelling_references;
+};
+
+/**
+ * @cond
+ */
+template<class Object>
+bool has_group(const Object& handle, const std::string& name) {
+    return handle.exists(name) && handle.childObjType(name) == H5O_TYPE_GROUP;
+}
+
+template<class Object>
+bool has_dataset(const Object& handle, const std::string& name) {
+    return handle.exists(name) && handle.childObjType(name) == H5O_TYPE_DATASET;
+}
+
+template<class Object>
+void fill_integer(const Object& handle, const std::string& name, int& output) {
+    if (has_dataset(handle, name)) {
+        output = utils::load_integer_scalar<>(handle, name);
+    }
+}
+
+template<class Object>
+void fill_float(const Object& handle, const std::string& name, double& output) {
+    if (has_dataset(handle, name)) {
+        output = utils::load_float_scalar<>(handle, name);
+    }
+}
+
+template<class Object>
+void fill_string(const Object& handle, const std::string& name, std::string& output) {
+    if (has_dataset(handle, name)) {
+        output = utils::load_string(handle, name);
+    }
+}
+
+template<class Object>
+void fill_extent(const Object& handle, const std::string& name, size_t dim, int& output) {
+    if (has_dataset(handle, name)) {
+        auto dims = utils::get_dimensions(handle.openDataSet(name));
+        if (dim < dims.size()) {
+            output = dims[dim];
+        }
+    }
+}
+
+inline void inspect_inputs(const H5::Group& handle, Summary::Inputs& output, int version) {
+    if (!has_group(handle, "inputs")) {
+        return;
+    }
+    auto ihandle = handle.openGroup("inputs");
+
+    if (has_group(ihandle, "parameters")) {
+        auto phandle = ihandle.openGroup("parameters");
+        if (has_dataset(phandle, "format")) {
+            auto fhandle = phandle.openDataSet("format");
+            if (fhandle.getSpace().getSimpleExtentNdims() == 0) {
+                output.formats.push_back(utils::load_string(fhandle));
+            } else {
+                output.formats = utils::load_string_vector(fhandle);
+            }
+        }
+    }
+
+    if (!has_group(ihandle, "results")) {
+        return;
+    }
+    auto rhandle = ihandle.openGroup("results");
+
+    if (version < 2000000) {
+        if (has_dataset(rhandle, "dimensions")) {
+            auto dims = utils::load_integer_vector<int>(rhandle, "dimensions");
+            if (dims.size() == 2) {
+                output.modalities.push_back("RNA");
+                output.num_features.push_back(dims[0]);
+                output.num_cells = dims[1];
+            }
+        }
+    } else {
+        fill_integer(rhandle, "num_cells", output.num_cells);
+        if (has_group(rhandle, "num_features")) {
+            auto fhandle = rhandle.openGroup("num_features");
+            size_t nmodals = fhandle.getNumObjs();
+            for (hsize_t idx = 0; idx < nmodals; ++idx) {
+                std::string modality = fhandle.getObjnameByIdx(idx);
+                output.modalities.push_back(modality);
+                output.num_features.push_back(utils::load_integer_scalar<>(fhandle, modality));
+            }
+        }
+    }
+
+    output.num_samples = 1;
+    fill_integer(rhandle, "num_samples", output.num_samples);
+}
+
+inline void inspect_pca(const H5::Group& handle, const std::string& name, Summary::PCA& output, int& num_cells) {
+    if (!has_group(handle, name)) {
+        return;
+    }
+    auto phandle = handle.openGroup(name);
+
+    if (has_group(phandle, "parameters")) {
+        auto pahandle = phandle.openGroup("parameters");
+        fill_integer(pahandle, "num_hvgs", output.num_hvgs);
+        fill_integer(pahandle, "num_pcs", output.num_pcs);
+        fill_string(pahandle, "block_method", output.block_method);
+    }
+
+    if (has_group(phandle, "results")) {
+        auto rhandle = phandle.openGroup("results");
+        fill_extent(rhandle, "var_exp", 0, output.num_pcs_stored);
+        if (num_cells < 0) {
+            fill_extent(rhandle, "pcs", 0, num_cells);
+        }
+    }
+}
+
+template<class Function>
+void with_group(const H5::Group& handle, const std::string& step, const std::string& child, Function fun) {
+    if (has_group(handle, step)) {
+        auto shandle = handle.openGroup(step);
+        if (has_group(shandle, child)) {
+            fun(shandle.openGroup(child));
+        }
+    }
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Summarize the parameters and dimensions of the analysis state HDF5 file embedded inside a `*.kana` file.
+ * Only scalar parameters and the extents of the result datasets are read, so this is fast enough to index large collections of files.
+ * Unlike `validate()`, missing groups or datasets are tolerated and are reported as sentinel values in the returned `Summary`.
+ * (Datasets that are present are still expected to have the types described in the individual validation functions.)
+ *
+ * @param handle Open handle to a HDF5 file.
+ * @param version Version of the kana file.
+ *
+ * @return A `Summary` of the analysis.
+ */
+inline Summary inspect(const H5::Group& handle, int version) {
+    Summary output;
+
+    try {
+        inspect_inputs(handle, output.inputs, version);
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to inspect 'inputs'");
+    }
+
+    try {
+        with_group(handle, "quality_control", "parameters", [&](const H5::Group& phandle) -> void {
+            fill_float(phandle, "nmads", output.quality_control_nmads);
+        });
+        with_group(handle, "adt_quality_control", "parameters", [&](const H5::Group& phandle) -> void {
+            fill_float(phandle, "nmads", output.adt_quality_control_nmads);
+        });
+
+        inspect_pca(handle, "pca", output.pca, output.num_filtered_cells);
+        inspect_pca(handle, "adt_pca", output.adt_pca, output.num_filtered_cells);
+
+        with_group(handle, "combine_embeddings", "results", [&](const H5::Group& rhandle) -> void {
+            fill_extent(rhandle, "combined", 1, output.num_combined_dims);
+        });
+        with_group(handle, "batch_correction", "parameters", [&](const H5::Group& phandle) -> void {
+            fill_string(phandle, "method", output.batch_correction_method);
+        });
+        with_group(handle, "batch_correction", "results", [&](const H5::Group& rhandle) -> void {
+            fill_extent(rhandle, "corrected", 1, output.num_corrected_dims);
+        });
+
+        with_group(handle, "choose_clustering", "parameters", [&](const H5::Group& phandle) -> void {
+            fill_string(phandle, "method", output.clustering_method);
+        });
+        with_group(handle, "kmeans_cluster", "parameters", [&](const H5::Group& phandle) -> void {
+            fill_integer(phandle, "k", output.kmeans_k);
+        });
+        with_group(handle, "snn_graph_cluster", "parameters", [&](const H5::Group& phandle) -> void {
+            fill_integer(phandle, "k", output.snn_k);
+            fill_string(phandle, "scheme", output.snn_scheme);
+            fill_float(phandle, "resolution", output.snn_resolution);
+        });
+
+        with_group(handle, "tsne", "parameters", [&](const H5::Group& phandle) -> void {
+            fill_float(phandle, "perplexity", output.tsne_perplexity);
+            fill_integer(phandle, "iterations", output.tsne_iterations);
+        });
+        with_group(handle, "umap", "parameters", [&](const H5::Group& phandle) -> void {
+            fill_integer(phandle, "num_neighbors", output.umap_num_neighbors);
+            fill_integer(phandle, "num_epochs", output.umap_num_epochs);
+            fill_float(phandle, "min_dist", output.umap_min_dist);
+        });
+
+        with_group(handle, "marker_detection", "results", [&](const H5::Group& rhandle) -> void {
+            if (version >= 2000000) {
+                if (has_group(rhandle, "per_cluster")) {
+                    auto chandle = rhandle.openGroup("per_cluster");
+                    if (chandle.getNumObjs()) {
+                        auto mhandle = chandle.openGroup(chandle.getObjnameByIdx(0));
+                        output.num_clusters = mhandle.getNumObjs();
+                    }
+                }
+            } else if (has_group(rhandle, "clusters")) {
+                output.num_clusters = rhandle.openGroup("clusters").getNumObjs();
+            }
+        });
+
+        with_group(handle, "custom_selections", "parameters", [&](const H5::Group& phandle) -> void {
+            if (has_group(phandle, "selections")) {
+                output.num_custom_selections = phandle.openGroup("selections").getNumObjs();
+            }
+        });
+
+        with_group(handle, "cell_labelling", "parameters", [&](const H5::Group& phandle) -> void {
+            for (std::string species : { "human_references", "mouse_references" }) {
+                if (has_dataset(phandle, species)) {
+                    auto refs = utils::load_string_vector(phandle, species);
+                    output.labelling_references.insert(output.labelling_references.end(), refs.begin(), refs.end());
+                }
+            }
+        });
+
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to inspect the analysis steps");
+    }
+
+    return output;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,282 @@
+#ifndef KANAVAL_INSTRUMENTATION_HPP
+#define KANAVAL_INSTRUMENTATION_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+
+/**
+ * @file instrumentation.hpp
+ *
+ * @brief Record the time and memory used by each step of the validation.
+ */
+
+namespace kanaval {
+
+namespace instrumentation {
+
+/**
+ * @brief Time and memory used by a single step.
+ */
+struct StepReport {
+    /**
+     * Name of the step.
+     */
+    std::string name;
+
+    /**
+     * Wall time taken by the step, in seconds.
+     */
+    double seconds = 0;
+
+    /**
+     * Total number of bytes allocated for buffers during the step.
+     */
+    size_t allocated_bytes = 0;
+
+    /**
+     * Peak number of bytes in buffers that were alive at the same time during the step.
+     * Buffers returned by the loading functions in `utils` are assumed to be alive until the end of the step, so this is an upper bound.
+     */
+    size_t peak_bytes = 0;
+
+    /**
+     * Total capacity of the HDF5 chunk caches for all chunked datasets opened during the step, in bytes.
+     * This is an upper bound on the memory used by the chunk caches.
+     */
+    size_t chunk_cache_bytes = 0;
+
+    /**
+     * Size of the HDF5 metadata cache for the file at the end of the step, in bytes.
+     */
+    size_t metadata_cache_bytes = 0;
+};
+
+/**
+ * @brief Accumulate time and memory usage across the steps of a validation.
+ *
+ * Buffer allocations are only recorded in the thread that runs each step.
+ * This covers all buffers that scale with the number of cells or features, as the validation itself is single-threaded.
+ */
+class Context {
+public:
+    /**
+     * Start recording a new step.
+     * @param name Name of the step.
+     */
+    void begin(std::string name) {
+        reports.emplace_back();
+        reports.back().name = std::move(name);
+        release(unscoped); // in case the previous step failed before end().
+        unscoped = 0;
+        start = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * Finish recording the current step.
+     * @param handle Handle to the file being validated, used to query the size of the metadata cache.
+     */
+    void end(const H5::H5File& handle) {
+        auto& current = reports.back();
+        current.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        size_t max_size = 0, min_clean = 0, cur_size = 0;
+        int num_entries = 0;
+        if (H5Fget_mdc_size(handle.getId(), &max_size, &min_clean, &cur_size, &num_entries) >= 0) {
+            current.metadata_cache_bytes = cur_size;
+        }
+
+        release(unscoped);
+        unscoped = 0;
+    }
+
+    /**
+     * Record the allocation of a buffer.
+     * Each call should be paired with a later call to `release()`, usually via `Allocation`.
+     *
+     * @param bytes Size of the buffer.
+     */
+    void allocate(size_t bytes) {
+        live += bytes;
+        peak_ = std::max(peak_, live);
+        if (!reports.empty()) {
+            auto& current = reports.back();
+            current.allocated_bytes += bytes;
+            current.peak_bytes = std::max(current.peak_bytes, live);
+        }
+    }
+
+    /**
+     * Record the allocation of a buffer whose lifetime is not known, e.g., because it is returned to the caller.
+     * The buffer is assumed to be alive until the end of the current step.
+     *
+     * @param bytes Size of the buffer.
+     */
+    void allocate_until_end(size_t bytes) {
+        allocate(bytes);
+        unscoped += bytes;
+    }
+
+    /**
+     * Record the release of a buffer.
+     * @param bytes Size of the buffer.
+     */
+    void release(size_t bytes) {
+        live -= std::min(live, bytes);
+    }
+
+    /**
+     * Record the opening of a chunked dataset.
+     * @param bytes Capacity of the dataset's chunk cache.
+     */
+    void open_chunked(size_t bytes) {
+        if (!reports.empty()) {
+            reports.back().chunk_cache_bytes += bytes;
+        }
+    }
+
+    /**
+     * @return Reports for all steps, in the order in which they were run.
+     */
+    const std::vector<StepReport>& steps() const {
+        return reports;
+    }
+
+    /**
+     * @return Peak number of bytes in buffers that were alive at the same time, across all steps.
+     */
+    size_t peak_bytes() const {
+        return peak_;
+    }
+
+private:
+    std::vector<StepReport> reports;
+    std::chrono::steady_clock::time_point start;
+    size_t live = 0, unscoped = 0, peak_ = 0;
+};
+
+/**
+ * @return Reference to a pointer to the active context for the current thread.
+ * This is `NULL` if no recording is being performed.
+ */
+inline Context*& active() {
+    static thread_local Context* context = NULL;
+    return context;
+}
+
+/**
+ * @brief Scoped record of a buffer allocation in the active context.
+ *
+ * This should be constructed alongside the buffer so that its release is recorded when both go out of scope.
+ */
+class Allocation {
+public:
+    /**
+     * @param bytes Size of the buffer.
+     */
+    Allocation(size_t bytes) : context(active()), bytes_(bytes) {
+        if (context) {
+            context->allocate(bytes_);
+        }
+    }
+
+    /**
+     * @cond
+     */
+    ~Allocation() {
+        if (context) {
+            context->release(bytes_);
+        }
+    }
+
+    Allocation(const Allocation&) = delete;
+    Allocation& operator=(const Allocation&) = delete;
+    /**
+     * @endcond
+     */
+
+private:
+    Context* context;
+    size_t bytes_;
+};
+
+/**
+ * Record the allocation of a buffer that is returned to the caller, if there is an active context.
+ * @param bytes Size of the buffer.
+ */
+inline void record_allocation(size_t bytes) {
+    if (auto context = active()) {
+        context->allocate_until_end(bytes);
+    }
+}
+
+/**
+ * Record the opening of a dataset, if there is an active context.
+ * If the dataset is chunked, the capacity of its chunk cache is added to the current step.
+ *
+ * @param dhandle Handle to the dataset.
+ */
+inline void record_dataset(const H5::DataSet& dhandle) {
+    auto context = active();
+    if (!context) {
+        return;
+    }
+
+    auto cplist = dhandle.getCreatePlist();
+    if (cplist.getLayout() != H5D_CHUNKED) {
+        return;
+    }
+
+    auto aplist = dhandle.getAccessPlist();
+    size_t nslots = 0, nbytes = 0;
+    double w0 = 0;
+    aplist.getChunkCache(nslots, nbytes, w0);
+    context->open_chunked(nbytes);
+}
+
+/**
+ * Run a step with `context` as the active context.
+ *
+ * @tparam Function Function that accepts no arguments.
+ *
+ * @param context Pointer to a context in which to record the step.
+ * If `NULL`, the step is run without any recording.
+ * @param name Name of the step.
+ * @param handle Handle to the file being validated.
+ * @param fun Function that runs the step.
+ *
+ * @return The return value of `fun`.
+ */
+template<class Function>
+auto run_step(Context* context, const std::string& name, const H5::H5File& handle, Function fun) -> decltype(fun()) {
+    if (!context) {
+        return fun();
+    }
+
+    struct Restore {
+        Context* previous;
+        ~Restore() {
+            active() = previous;
+        }
+    } restore{ active() };
+
+    active() = context;
+    context->begin(name);
+    if constexpr(std::is_void<decltype(fun())>::value) {
+        fun();
+        context->end(handle);
+    } else {
+        auto output = fun();
+        context->end(handle);
+        return output;
+    }
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef KANAVAL_INTERNING_HPP
+#define KANAVAL_INTERNING_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include "utils.hpp"
+
+/**
+ * @file interning.hpp
+ *
+ * @brief Load string datasets as integer codes into a shared dictionary.
+ */
+
+namespace kanaval {
+
+namespace interning {
+
+/**
+ * @brief Dictionary of unique strings.
+ *
+ * Each unique string is assigned an integer code in order of its first insertion.
+ * The same dictionary can be shared across multiple datasets so that identical strings always receive the same code,
+ * allowing downstream code to compare integers instead of strings.
+ */
+class Dictionary {
+public:
+    /**
+     * @cond
+     */
+    Dictionary() = default;
+
+    // The keys of 'codes' are views into 'strings', so a copy needs to rebuild them to point into its own strings.
+    // Moves keep the deque's elements in place, so the views remain valid.
+    Dictionary(const Dictionary& other) : strings(other.strings) {
+        rebuild();
+    }
+
+    Dictionary& operator=(const Dictionary& other) {
+        if (this != &other) {
+            strings = other.strings;
+            rebuild();
+        }
+        return *this;
+    }
+
+    Dictionary(Dictionary&&) = default;
+    Dictionary& operator=(Dictionary&&) = default;
+    /**
+     * @endcond
+     */
+
+    /**
+     * @param value String to intern.
+     * @return Code for `value`, which is assigned if `value` has not been seen before.
+     */
+    int intern(std::string_view value) {
+        auto it = codes.find(value);
+        if (it != codes.end()) {
+            return it->second;
+        }
+        int code = strings.size();
+        strings.emplace_back(value);
+        codes.emplace(strings.back(), code); // deque elements are never moved, so the view stays valid.
+        return code;
+    }
+
+    /**
+     * @param value String of interest.
+     * @return Code for `value`, or -1 if it has not been interned.
+     */
+    int find(std::string_view value) const {
+        auto it = codes.find(value);
+        return (it == codes.end() ? -1 : it->second);
+    }
+
+    /**
+     * @param code Code for an interned string.
+     * @return The interned string.
+     */
+    const std::string& get(int code) const {
+        return strings[code];
+    }
+
+    /**
+     * @return Number of unique strings.
+     */
+    size_t size() const {
+        return strings.size();
+    }
+
+    /**
+     * @return Vector of all unique strings, indexed by their codes.
+     */
+    std::vector<std::string> levels() const {
+        return std::vector<std::string>(strings.begin(), strings.end());
+    }
+
+private:
+    std::deque<std::string> strings;
+    std::unordered_map<std::string_view, int> codes;
+
+    void rebuild() {
+        codes.clear();
+        codes.reserve(strings.size());
+        for (size_t i = 0; i < strings.size(); ++i) {
+            codes.emplace(strings[i], i);
+        }
+    }
+};
+
+/**
+ * Load a 1-dimensional string dataset as codes into a dictionary.
+ * Unlike `utils::load_string_vector()`, a `std::string` is only created for each unique value.
+ *
+ * @param handle Handle to a 1-dimensional string dataset.
+ * @param dictionary Dictionary in which to intern the strings.
+ * This may already contain strings, e.g., from other datasets.
+ *
+ * @return Vector of codes for the strings in the dataset.
+ */
+inline std::vector<int> load_codes(const H5::DataSet& handle, Dictionary& dictionary) {
+    auto dspace = handle.getSpace();
+    if (dspace.getSimpleExtentNdims() != 1) {
+        throw std::runtime_error("expected a 1-dimensional string dataset");
+    }
+
+    hsize_t len;
+    dspace.getSimpleExtentDims(&len);
+    std::vector<int> output;
+    output.reserve(len);
+    instrumentation::record_allocation(len * sizeof(int));
+    if (len == 0) {
+        return output;
+    }
+
+    auto dtype = handle.getStrType();
+    if (dtype.isVariableStr()) {
+        std::vector<char*> buffer(len);
+        instrumentation::Allocation tracked(len * sizeof(char*));
+        handle.read(buffer.data(), dtype);
+        for (auto b : buffer) {
+            output.push_back(dictionary.intern(b));
+        }
+        H5Dvlen_reclaim(dtype.getId(), dspace.getId(), H5P_DEFAULT, buffer.data());
+
+    } else {
+        size_t size = dtype.getSize();
+        std::vector<char> buffer(len * size);
+        instrumentation::Allocation tracked(buffer.size());
+        handle.read(buffer.data(), dtype);
+        auto start = buffer.data();
+        for (hsize_t i = 0; i < len; ++i, start += size) {
+            size_t j = 0;
+            for (; j < size && start[j] != '\0'; ++j) {}
+            output.push_back(dictionary.intern(std::string_view(start, j)));
+        }
+    }
+
+    return output;
+}
+
+/**
+ * @tparam Object HDF5 group or file handle.
+ *
+ * @param handle Handle to the parent group.
+ * @param name Name of a 1-dimensional string dataset.
+ * @param dictionary Dictionary in which to intern the strings.
+ *
+ * @return Vector of codes for the strings in the dataset.
+ */
+template<class Object>
+std::vector<int> load_codes(const Object& handle, const std::string& name, Dictionary& dictionary) {
+    auto dhandle = utils::check_and_open_dataset(handle, name, H5T_STRING);
+    std::vector<int> output;
+    try {
+        output = load_codes(dhandle, dictionary);
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to load string codes from '" + name + "'");
+    }
+    return output;
+}
+
+}
+
+}
+
+#endif
@@ -27,7 +27,7 @@ inline int validate_parameters(const H5::Group& handle) {
     return k;
 }
 
-inline int validate_results(const H5::Group& handle, int k, int num_cells, bool in_use) {
+inline int validate_results(const H5::Group& handle, int k, int num_cells, bool in_use, std::vector<int>* cluster_sizes) {
     auto phandle = utils::check_and_open_group(handle, "results");
 
     int nclusters = 0;
@@ -35,6 +35,7 @@ inline int validate_results(const H5::Group& handle, int k, int num_cells, bool
         std::vector<size_t> dim { static_cast<size_t>(num_cells) };
         auto clushandle = utils::check_and_open_dataset(phandle, "clusters", H5T_INTEGER, dim);
         std::vector<int> clusters(num_cells);
+        instrumentation::Allocation tracked(clusters.size() * sizeof(int));
         clushandle.read(clusters.data(), H5::PredType::NATIVE_INT);
 
         if (num_cells) {
@@ -46,6 +47,7 @@ inline int validate_results(const H5::Group& handle, int k, int num_cells, bool
 
             nclusters = maxed + 1;
             std::vector<int> counts(nclusters);
+            instrumentation::Allocation tracked_counts(counts.size() * sizeof(int));
             for (auto c : clusters) {
                 ++counts[c];
             }
@@ -55,6 +57,9 @@ inline int validate_results(const H5::Group& handle, int k, int num_cells, bool
                 }
             }
 
+            if (cluster_sizes) {
+                *cluster_sizes = std::move(counts);
+            }
         }
     }
 
@@ -89,11 +94,13 @@ inline int validate_results(const H5::Group& handle, int k, int num_cells, bool
  * @param handle An open HDF5 file handle.
  * @param num_cells Number of cells in the dataset after any quality filtering is applied.
  * @param in_use Was k-means clustering used by downstream steps?
+ * @param[out] cluster_sizes Pointer to a vector in which to store the number of cells in each cluster.
+ * This is only filled if `clusters` is present, and is ignored if `NULL`.
  *
  * @return The total number of clusters.
  * If the format is invalid, an error is raised.
  */
-inline int validate(const H5::H5File& handle, int num_cells, bool in_use = true) {
+inline int validate(const H5::H5File& handle, int num_cells, bool in_use = true, std::vector<int>* cluster_sizes = NULL) {
     auto nhandle = utils::check_and_open_group(handle, "kmeans_cluster");
 
     int k;
@@ -105,7 +112,7 @@ inline int validate(const H5::H5File& handle, int num_cells, bool in_use = true)
 
     int nclusters;
     try {
-        nclusters = validate_results(nhandle, k, num_cells, in_use);
+        nclusters = validate_results(nhandle, k, num_cells, in_use, cluster_sizes);
     } catch (std::exception& e) {
         throw utils::combine_errors(e, "failed to retrieve results from 'kmeans_cluster'");
     }
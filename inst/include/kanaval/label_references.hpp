@@ -0,0 +1,100 @@
+#ifndef KANAVAL_LABEL_REFERENCES_HPP
+#define KANAVAL_LABEL_REFERENCES_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include "cell_labelling.hpp"
+#include "embedded.hpp"
+
+/**
+ * @file label_references.hpp
+ *
+ * @brief Load reference label vocabularies from disk.
+ */
+
+namespace kanaval {
+
+namespace cell_labelling {
+
+/**
+ * @param contents Contents of a label file, after any decompression.
+ * @return Vector of labels, one per non-empty line.
+ * Surrounding double quotes are removed.
+ */
+inline std::vector<std::string> parse_labels(const std::string& contents) {
+    std::vector<std::string> output;
+    size_t pos = 0;
+    while (pos < contents.size()) {
+        size_t end = contents.find('\n', pos);
+        if (end == std::string::npos) {
+            end = contents.size();
+        }
+
+        size_t last = end;
+        if (last > pos && contents[last - 1] == '\r') {
+            --last;
+        }
+        if (last - pos >= 2 && contents[pos] == '"' && contents[last - 1] == '"') {
+            ++pos;
+            --last;
+        }
+        if (last > pos) {
+            output.emplace_back(contents.begin() + pos, contents.begin() + last);
+        }
+
+        pos = end + 1;
+    }
+    return output;
+}
+
+/**
+ * Load a registry of reference vocabularies from a directory.
+ * Each file in the directory should be named after a reference with a `.txt` or `.csv` extension, possibly followed by `.gz` (e.g., `BlueprintEncode.txt.gz`).
+ * Each line of a file contains the name of one label in the reference; duplicate labels are allowed.
+ * Files with other extensions are ignored.
+ *
+ * @param dir Path to the directory.
+ * @return Registry containing all references in `dir`.
+ */
+inline Registry load_registry(const std::string& dir) {
+    Registry output;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+
+        std::string name = entry.path().filename().string();
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0) {
+            name.resize(name.size() - 3);
+        }
+        if (name.size() <= 4) {
+            continue;
+        }
+        std::string ext = name.substr(name.size() - 4);
+        if (ext != ".txt" && ext != ".csv") {
+            continue;
+        }
+        name.resize(name.size() - 4);
+
+        std::ifstream input(entry.path(), std::ios::binary);
+        std::stringstream buffer;
+        buffer << input.rdbuf();
+        std::string contents = buffer.str();
+        if (embedded::is_gzip(contents)) {
+            contents = embedded::gunzip(contents);
+        }
+
+        output.add(name, parse_labels(contents));
+    }
+
+    return output;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,322 @@
+#ifndef KANAVAL_MAPPING_HPP
+#define KANAVAL_MAPPING_HPP
+
+#include "H5Cpp.h"
+#include <string>
+#include <vector>
+#include <type_traits>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @file mapping.hpp
+ *
+ * @brief Memory-map contiguous, uncompressed datasets for zero-copy access.
+ */
+
+namespace kanaval {
+
+namespace mapping {
+
+/**
+ * @brief Location of a dataset's values in a file.
+ */
+struct Region {
+    /**
+     * Path to the file.
+     */
+    std::string path;
+
+    /**
+     * Offset of the first value from the start of the file.
+     */
+    hsize_t offset = 0;
+
+    /**
+     * Number of values.
+     */
+    hsize_t count = 0;
+};
+
+/**
+ * Check whether the values of a dataset are stored with the same representation as `T` in memory,
+ * such that they can be used directly without any conversion.
+ *
+ * @tparam T Type of the values in memory.
+ * @param dtype Datatype of the dataset in the file.
+ *
+ * @return Whether the datatype is bit-identical to `T`.
+ */
+template<typename T>
+bool matches_type(const H5::DataType& dtype) {
+    static_assert(std::is_arithmetic<T>::value, "only arithmetic types are supported");
+    if (dtype.getSize() != sizeof(T)) {
+        return false;
+    }
+
+    auto cls = dtype.getClass();
+    if constexpr(std::is_floating_point<T>::value) {
+        if (cls != H5T_FLOAT) {
+            return false;
+        }
+    } else {
+        if (cls != H5T_INTEGER) {
+            return false;
+        }
+        if ((H5Tget_sign(dtype.getId()) == H5T_SGN_2) != std::is_signed<T>::value) {
+            return false;
+        }
+    }
+
+    return H5Tget_order(dtype.getId()) == H5Tget_order(H5T_NATIVE_INT);
+}
+
+/**
+ * Find the location of a dataset's values in its file, assuming that the dataset is stored in contiguous layout without any filters.
+ * Compressed datasets always use chunked layout and are not supported.
+ *
+ * @param dhandle Handle to a dataset.
+ * @param base Offset of the HDF5 file from the start of `path`, e.g., 24 for the state file inside a `*.kana` file.
+ * @param[out] region On success, the location of the dataset's values, with `Region::path` set to the name of the HDF5 file.
+ *
+ * @return Whether the dataset's values are stored contiguously at a fixed offset in the file.
+ * This is false for chunked or compact datasets, datasets with external storage, and datasets without allocated storage (e.g., with zero length).
+ */
+inline bool locate(const H5::DataSet& dhandle, hsize_t base, Region& region) {
+    auto cplist = dhandle.getCreatePlist();
+    if (cplist.getLayout() != H5D_CONTIGUOUS || cplist.getExternalCount() != 0) {
+        return false;
+    }
+
+    haddr_t offset = H5Dget_offset(dhandle.getId());
+    if (offset == HADDR_UNDEF) {
+        return false;
+    }
+
+    auto dspace = dhandle.getSpace();
+    region.path = dhandle.getFileName();
+    region.offset = base + offset;
+    region.count = dspace.getSimpleExtentNpoints();
+    return true;
+}
+
+/**
+ * @brief Read-only view of a memory-mapped region of a file.
+ *
+ * @tparam T Type of the values.
+ *
+ * The mapping is released when the view is destroyed.
+ * Pages are only read from disk when they are first accessed, so creating a view does not allocate or copy any values.
+ */
+template<typename T>
+class View {
+public:
+    /**
+     * @cond
+     */
+    View() = default;
+
+    View(void* mapped, size_t mapped_size, const T* ptr, hsize_t count) : mapped_(mapped), mapped_size_(mapped_size), ptr_(ptr), count_(count) {}
+
+    ~View() {
+        release();
+    }
+
+    View(const View&) = delete;
+    View& operator=(const View&) = delete;
+
+    View(View&& other) {
+        *this = std::move(other);
+    }
+
+    View& operator=(View&& other) {
+        if (this != &other) {
+            release();
+            mapped_ = other.mapped_;
+            mapped_size_ = other.mapped_size_;
+            ptr_ = other.ptr_;
+            count_ = other.count_;
+            other.mapped_ = NULL;
+            other.mapped_size_ = 0;
+            other.ptr_ = NULL;
+            other.count_ = 0;
+        }
+        return *this;
+    }
+    /**
+     * @endcond
+     */
+
+    /**
+     * @return Pointer to the first value.
+     */
+    const T* data() const {
+        return ptr_;
+    }
+
+    /**
+     * @return Number of values.
+     */
+    hsize_t size() const {
+        return count_;
+    }
+
+    /**
+     * @param i Index of a value.
+     * @return The `i`-th value.
+     */
+    const T& operator[](hsize_t i) const {
+        return ptr_[i];
+    }
+
+private:
+    void* mapped_ = NULL;
+    size_t mapped_size_ = 0;
+    const T* ptr_ = NULL;
+    hsize_t count_ = 0;
+
+    void release() {
+#ifndef _WIN32
+        if (mapped_) {
+            munmap(mapped_, mapped_size_);
+            mapped_ = NULL;
+        }
+#endif
+    }
+};
+
+/**
+ * Map a region of a file into memory.
+ *
+ * @tparam T Type of the values.
+ * @param region Location of the values, e.g., from `locate()`.
+ * The offset should be a multiple of the alignment of `T`.
+ *
+ * @return A read-only view of the values.
+ */
+template<typename T>
+View<T> map(const Region& region) {
+#ifdef _WIN32
+    throw std::runtime_error("memory mapping is not supported on Windows");
+#else
+    if (region.offset % alignof(T) != 0) {
+        throw std::runtime_error("values in '" + region.path + "' are not aligned for direct access");
+    }
+    if (region.count == 0) {
+        return View<T>();
+    }
+
+    // mmap() requires the offset to be a multiple of the page size.
+    hsize_t page = sysconf(_SC_PAGESIZE);
+    hsize_t start = (region.offset / page) * page;
+    size_t len = (region.offset - start) + region.count * sizeof(T);
+
+    int fd = open(region.path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open '" + region.path + "' for memory mapping");
+    }
+    void* mapped = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, start);
+    close(fd); // the mapping remains valid after the descriptor is closed.
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("failed to memory-map '" + region.path + "'");
+    }
+
+    auto ptr = reinterpret_cast<const T*>(static_cast<const unsigned char*>(mapped) + (region.offset - start));
+    return View<T>(mapped, len, ptr, region.count);
+#endif
+}
+
+/**
+ * Check whether a dataset can be mapped with `map()`.
+ * This requires:
+ *
+ * - the dataset to be stored contiguously at a fixed offset, see `locate()`.
+ * - the file datatype to be bit-identical to `T`, see `matches_type()`.
+ * - the offset to be aligned for `T`.
+ * - the file to be opened read-only with the default (`sec2`) driver, so that the bytes on disk are exactly those seen by HDF5.
+ *
+ * @tparam T Type of the values in memory.
+ * @param dhandle Handle to a dataset.
+ *
+ * @return Whether the dataset can be mapped.
+ */
+template<typename T>
+bool can_map(const H5::DataSet& dhandle) {
+#ifdef _WIN32
+    return false;
+#else
+    if (!matches_type<T>(dhandle.getDataType())) {
+        return false;
+    }
+
+    hid_t fid = H5Iget_file_id(dhandle.getId());
+    if (fid < 0) {
+        return false;
+    }
+    unsigned intent = 0;
+    H5Fget_intent(fid, &intent);
+    hid_t fapl = H5Fget_access_plist(fid);
+    bool sec2 = (H5Pget_driver(fapl) == H5FD_SEC2);
+    H5Pclose(fapl);
+    H5Fclose(fid);
+    if (!sec2 || (intent & H5F_ACC_RDWR)) {
+        return false;
+    }
+
+    Region region;
+    return locate(dhandle, 0, region) && region.offset % alignof(T) == 0;
+#endif
+}
+
+/**
+ * Map a dataset into memory.
+ *
+ * @tparam T Type of the values in memory.
+ * @param dhandle Handle to a dataset for which `can_map()` is true.
+ *
+ * @return A read-only view of the dataset's values, in row-major order.
+ */
+template<typename T>
+View<T> map(const H5::DataSet& dhandle) {
+    if (!can_map<T>(dhandle)) {
+        throw std::runtime_error("dataset cannot be memory-mapped");
+    }
+    Region region;
+    locate(dhandle, 0, region);
+    return map<T>(region);
+}
+
+/**
+ * Map a dataset from a HDF5 file that is stored inside another file, e.g., the state file inside a `*.kana` file.
+ * This is useful when the HDF5 file was opened from an in-memory image or through another driver.
+ *
+ * @tparam T Type of the values in memory.
+ * @param dhandle Handle to a dataset.
+ * @param path Path to the file containing the HDF5 file.
+ * @param base Offset of the HDF5 file from the start of `path`, e.g., as returned by `object_store::locate_state()`.
+ *
+ * @return A read-only view of the dataset's values, in row-major order.
+ */
+template<typename T>
+View<T> map(const H5::DataSet& dhandle, const std::string& path, hsize_t base) {
+    if (!matches_type<T>(dhandle.getDataType())) {
+        throw std::runtime_error("dataset type does not match the requested type");
+    }
+    Region region;
+    if (!locate(dhandle, base, region)) {
+        throw std::runtime_error("dataset is not stored contiguously");
+    }
+    region.path = path;
+    return map<T>(region);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef KANAVAL_MARKER_QUERY_HPP
+#define KANAVAL_MARKER_QUERY_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include "utils.hpp"
+#include "misc.hpp"
+
+/**
+ * @file marker_query.hpp
+ *
+ * @brief Look up the marker statistics for individual features across all clusters.
+ */
+
+namespace kanaval {
+
+namespace marker_query {
+
+/**
+ * @return Names of all marker statistics, i.e., `"means"`, `"detected"`, and each effect size and summary separated by a slash (e.g., `"cohen/mean"`).
+ * These are paths relative to each cluster's group, as described in `marker_detection::validate()`.
+ */
+inline std::vector<std::string> all_statistics() {
+    std::vector<std::string> stats { "means", "detected" };
+    for (const auto& eff : markers::effects) {
+        for (std::string summary : { "mean", "min", "min_rank" }) {
+            stats.push_back(eff + "/" + summary);
+        }
+    }
+    return stats;
+}
+
+/**
+ * @brief Options for the `Query` constructor.
+ */
+struct Options {
+    /**
+     * Statistics to retrieve, see `all_statistics()` for possible values.
+     * If empty, all statistics are retrieved.
+     */
+    std::vector<std::string> statistics;
+
+    /**
+     * Maximum number of features for which statistics are cached.
+     * If zero, no caching is performed.
+     */
+    size_t cache_size = 1000;
+};
+
+/**
+ * @brief Gene-centric queries on the marker statistics.
+ *
+ * The marker statistics are stored separately for each cluster, so extracting a feature's statistics across all clusters would typically involve opening hundreds of datasets.
+ * Instead, this class opens each dataset once upon construction and holds on to the handles.
+ * Statistics for a batch of features are then extracted with a single point selection per dataset,
+ * and the resulting feature-by-cluster slices are cached for subsequent requests.
+ */
+class Query {
+public:
+    /**
+     * @param handle Open handle to a HDF5 state file.
+     * This is assumed to have been validated with `validate()`.
+     * @param modality Modality of interest, typically `"RNA"` or `"ADT"`.
+     * Ignored for `version < 2000000`.
+     * @param version Version of the format.
+     * @param options Further options.
+     */
+    Query(const H5::Group& handle, const std::string& modality, int version, const Options& options = Options()) :
+        stats(options.statistics.empty() ? all_statistics() : options.statistics),
+        cache_size(options.cache_size)
+    {
+        auto rhandle = utils::check_and_open_group(utils::check_and_open_group(handle, "marker_detection"), "results");
+        auto chandle = (version >= 2000000 ?
+            utils::check_and_open_group(utils::check_and_open_group(rhandle, "per_cluster"), modality) :
+            utils::check_and_open_group(rhandle, "clusters"));
+
+        nclusters = chandle.getNumObjs();
+        datasets.reserve(nclusters * stats.size());
+        for (size_t c = 0; c < nclusters; ++c) {
+            auto ihandle = utils::check_and_open_group(chandle, std::to_string(c));
+            for (const auto& s : stats) {
+                auto dhandle = utils::check_and_open_dataset(ihandle, s, H5T_FLOAT);
+                auto dims = utils::get_dimensions(dhandle);
+                if (dims.size() != 1) {
+                    throw std::runtime_error("'" + s + "' for cluster " + std::to_string(c) + " should be a 1-dimensional dataset");
+                }
+                if (datasets.empty()) {
+                    nfeatures = dims[0];
+                } else if (dims[0] != nfeatures) {
+                    throw std::runtime_error("'" + s + "' for cluster " + std::to_string(c) + " has an inconsistent number of features");
+                }
+                datasets.push_back(dhandle);
+            }
+        }
+    }
+
+public:
+    /**
+     * @return Number of clusters.
+     */
+    size_t num_clusters() const {
+        return nclusters;
+    }
+
+    /**
+     * @return Number of features.
+     */
+    size_t num_features() const {
+        return nfeatures;
+    }
+
+    /**
+     * @return Names of the statistics returned by `fetch()`.
+     */
+    const std::vector<std::string>& statistics() const {
+        return stats;
+    }
+
+    /**
+     * Define names for the features, to enable lookup with `find()`.
+     * These are usually the gene symbols or identifiers for each row of the loaded dataset, see `inputs::validate()` for details.
+     * Names are resolved to indices once here, so subsequent lookups are constant-time.
+     *
+     * @param names Vector of length equal to `num_features()`, containing the name of each feature.
+     * For duplicated names, only the first occurrence is reported by `find()`.
+     */
+    void set_names(const std::vector<std::string>& names) {
+        if (names.size() != nfeatures) {
+            throw std::runtime_error("length of 'names' should be equal to the number of features");
+        }
+        name_index.clear();
+        name_index.reserve(names.size());
+        for (size_t f = 0; f < names.size(); ++f) {
+            name_index.emplace(names[f], f);
+        }
+    }
+
+    /**
+     * @param name Name of a feature.
+     * @return Index of the feature with the specified name, or -1 if no such feature exists.
+     * This requires an earlier call to `set_names()`.
+     */
+    int find(const std::string& name) const {
+        auto it = name_index.find(name);
+        if (it == name_index.end()) {
+            return -1;
+        }
+        return it->second;
+    }
+
+    /**
+     * @param feature Index of the feature of interest.
+     *
+     * @return Vector of length equal to the product of the number of statistics and `num_clusters()`.
+     * This contains a statistic-by-cluster matrix in row-major format, i.e., all clusters for the first statistic, then all clusters for the second statistic, and so on.
+     * The order of statistics is the same as that in `statistics()`.
+     */
+    std::vector<double> fetch(int feature) {
+        return fetch(std::vector<int>{ feature })[0];
+    }
+
+    /**
+     * @param features Indices of the features of interest.
+     *
+     * @return Vector of length equal to `features`.
+     * Each entry contains the statistic-by-cluster matrix for the corresponding feature, see the single-feature overload for details.
+     */
+    std::vector<std::vector<double> > fetch(const std::vector<int>& features) {
+        std::vector<std::vector<double> > output(features.size());
+
+        // Identifying the features that need to be read from file.
+        std::vector<hsize_t> missing;
+        for (size_t i = 0; i < features.size(); ++i) {
+            int f = features[i];
+            if (f < 0 || static_cast<size_t>(f) >= nfeatures) {
+                throw std::runtime_error("feature index " + std::to_string(f) + " is out of range");
+            }
+            auto it = cache.find(f);
+            if (it != cache.end()) {
+                recent.splice(recent.begin(), recent, it->second.second);
+                output[i] = it->second.first;
+            } else {
+                missing.push_back(f);
+            }
+        }
+
+        std::sort(missing.begin(), missing.end());
+        missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+        if (missing.empty()) {
+            return output;
+        }
+
+        // One point selection per dataset; the datasets themselves were opened in the constructor.
+        size_t nmissing = missing.size();
+        size_t nstats = stats.size();
+        std::vector<std::vector<double> > loaded(nmissing, std::vector<double>(nstats * nclusters));
+        std::vector<double> buffer(nmissing);
+        hsize_t mdims = nmissing;
+        H5::DataSpace mspace(1, &mdims);
+
+        for (size_t c = 0; c < nclusters; ++c) {
+            for (size_t s = 0; s < nstats; ++s) {
+                const auto& dhandle = datasets[c * nstats + s];
+                auto dspace = dhandle.getSpace();
+                dspace.selectElements(H5S_SELECT_SET, nmissing, missing.data());
+                dhandle.read(buffer.data(), H5::PredType::NATIVE_DOUBLE, mspace, dspace);
+                for (size_t m = 0; m < nmissing; ++m) {
+                    loaded[m][s * nclusters + c] = buffer[m];
+                }
+            }
+        }
+
+        for (size_t i = 0; i < features.size(); ++i) {
+            if (output[i].empty()) {
+                size_t m = std::lower_bound(missing.begin(), missing.end(), static_cast<hsize_t>(features[i])) - missing.begin();
+                output[i] = loaded[m];
+            }
+        }
+
+        for (size_t m = 0; m < nmissing; ++m) {
+            store(missing[m], std::move(loaded[m]));
+        }
+
+        return output;
+    }
+
+private:
+    void store(int feature, std::vector<double> values) {
+        if (cache_size == 0) {
+            return;
+        }
+        if (cache.size() >= cache_size) {
+            cache.erase(recent.back());
+            recent.pop_back();
+        }
+        recent.push_front(feature);
+        cache.emplace(feature, std::make_pair(std::move(values), recent.begin()));
+    }
+
+    std::vector<std::string> stats;
+    size_t cache_size;
+    size_t nclusters = 0;
+    size_t nfeatures = 0;
+    std::vector<H5::DataSet> datasets;
+
+    std::unordered_map<std::string, int> name_index;
+
+    std::list<int> recent;
+    std::unordered_map<int, std::pair<std::vector<double>, std::list<int>::iterator> > cache;
+};
+
+}
+
+}
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "H5Cpp.h"
 #include <vector>
+#include <string>
+#include <algorithm>
 #include "utils.hpp"
 
 namespace kanaval {
@@ -70,6 +72,23 @@ int check_discard_vector(const Object& rhandle, size_t num_cells) {
     return remaining;
 }
 
+/*
+ * Which discard vector was used to define the filtered cells, following the same logic as validate().
+ */
+template<class Object>
+H5::DataSet open_discard_vector(const Object& handle, const std::vector<std::string>& modalities, int version) {
+    std::string step;
+    if (version >= 2000000 && modalities.size() > 1) {
+        step = "cell_filtering";
+    } else if (std::find(modalities.begin(), modalities.end(), std::string("RNA")) != modalities.end()) {
+        step = "quality_control";
+    } else {
+        step = "adt_quality_control";
+    }
+    auto rhandle = utils::check_and_open_group(utils::check_and_open_group(handle, step), "results");
+    return utils::check_and_open_dataset(rhandle, "discards", H5T_INTEGER);
+}
+
 }
 
 namespace markers {
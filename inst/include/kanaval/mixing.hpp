@@ -0,0 +1,270 @@
+#ifndef KANAVAL_MIXING_HPP
+#define KANAVAL_MIXING_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "utils.hpp"
+#include "inspect.hpp"
+#include "embeddings.hpp"
+#include "neighbors.hpp"
+#include "blocks.hpp"
+
+/**
+ * @file mixing.hpp
+ *
+ * @brief Diagnose the mixing of batches in corrected embeddings.
+ */
+
+namespace kanaval {
+
+namespace mixing {
+
+/**
+ * @brief Options for `compare()`.
+ */
+struct Options {
+    /**
+     * Number of neighbors used to compute the batch entropy of each cell.
+     */
+    int num_neighbors = 20;
+
+    /**
+     * Options for the neighbor search.
+     */
+    neighbors::Options search;
+};
+
+/**
+ * @brief Summary of the batch entropies for one embedding.
+ */
+struct Summary {
+    /**
+     * Batch entropy of each cell.
+     */
+    std::vector<double> per_cell;
+
+    /**
+     * Mean batch entropy across the cells of each batch.
+     * This is NaN for batches without any cells.
+     */
+    std::vector<double> per_block;
+
+    /**
+     * Mean batch entropy across the cells of each cluster.
+     * This is NaN for clusters without any cells.
+     */
+    std::vector<double> per_cluster;
+
+    /**
+     * Mean batch entropy across all cells.
+     */
+    double overall = 0;
+};
+
+/**
+ * @brief Batch entropies before and after correction.
+ */
+struct Comparison {
+    /**
+     * Summary for the uncorrected embedding.
+     */
+    Summary uncorrected;
+
+    /**
+     * Summary for the corrected embedding.
+     */
+    Summary corrected;
+};
+
+/**
+ * Compute the batch entropy of each cell from the batches of its neighbors.
+ * The entropy is divided by its maximum possible value, i.e., the log-minimum of the number of batches and neighbors, so that it lies in `[0, 1]`;
+ * where 0 indicates that all neighbors are from the same batch and 1 indicates that all batches are equally represented.
+ *
+ * @param found Nearest neighbors of each cell.
+ * @param blocks Pointer to an array containing the batch of each cell, as integers in `[0, num_blocks)`.
+ * @param num_blocks Number of batches.
+ * @param num_threads Number of threads to use.
+ *
+ * @return Batch entropy of each cell.
+ */
+inline std::vector<double> entropy(const neighbors::Neighbors& found, const int* blocks, int num_blocks, int num_threads = 1) {
+    size_t n = found.size();
+    int k = found.num_neighbors;
+    std::vector<double> output(n);
+    int max_represented = std::min(num_blocks, k);
+    if (max_represented <= 1) {
+        return output;
+    }
+
+    double normalizer = std::log(static_cast<double>(max_represented));
+    neighbors::parallelize(n, num_threads, [&](size_t, size_t start, size_t len) -> void {
+        std::vector<int> counts(num_blocks);
+        for (size_t i = start, end = start + len; i < end; ++i) {
+            const int* nptr = found.indices.data() + i * k;
+            for (int x = 0; x < k; ++x) {
+                ++counts[blocks[nptr[x]]];
+            }
+
+            double current = 0;
+            for (int x = 0; x < k; ++x) {
+                auto& c = counts[blocks[nptr[x]]];
+                if (c) {
+                    double p = static_cast<double>(c) / k;
+                    current -= p * std::log(p);
+                    c = 0; // also resets the counts for the next cell.
+                }
+            }
+            output[i] = current / normalizer;
+        }
+    });
+
+    return output;
+}
+
+/**
+ * @cond
+ */
+inline std::vector<double> group_means(const std::vector<double>& values, const int* groups, int num_groups) {
+    std::vector<double> sums(num_groups);
+    std::vector<size_t> counts(num_groups);
+    for (size_t i = 0; i < values.size(); ++i) {
+        sums[groups[i]] += values[i];
+        ++counts[groups[i]];
+    }
+    for (int g = 0; g < num_groups; ++g) {
+        sums[g] = (counts[g] ? sums[g] / counts[g] : std::numeric_limits<double>::quiet_NaN());
+    }
+    return sums;
+}
+
+inline Summary summarize(const H5::DataSet& embedding, const int* blocks, int num_blocks, const int* clusters, int num_clusters, const Options& options) {
+    auto found = neighbors::find(embedding, options.num_neighbors, options.search);
+    Summary output;
+    output.per_cell = entropy(found, blocks, num_blocks, options.search.num_threads);
+    output.per_block = group_means(output.per_cell, blocks, num_blocks);
+    output.per_cluster = group_means(output.per_cell, clusters, num_clusters);
+
+    double total = 0;
+    for (auto e : output.per_cell) {
+        total += e;
+    }
+    output.overall = (output.per_cell.empty() ? 0 : total / output.per_cell.size());
+    return output;
+}
+
+inline void check_groups(const int* groups, size_t n, int num_groups, const std::string& message) {
+    for (size_t i = 0; i < n; ++i) {
+        if (groups[i] < 0 || groups[i] >= num_groups) {
+            throw std::runtime_error(message);
+        }
+    }
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Compare the mixing of batches in the uncorrected and corrected embeddings.
+ * The nearest neighbors of each cell are identified in each embedding, and the entropy of the batches among the neighbors is computed for each cell.
+ * An effective correction should increase the entropy, at least for clusters that are expected to be shared between batches.
+ *
+ * @param uncorrected Handle to a 2-dimensional float dataset containing the uncorrected embedding, with one row per cell.
+ * @param corrected Handle to a 2-dimensional float dataset containing the corrected embedding, with one row per cell.
+ * @param blocks Pointer to an array containing the batch of each cell, as integers in `[0, num_blocks)`.
+ * @param num_blocks Number of batches.
+ * @param clusters Pointer to an array containing the cluster assignment of each cell, as integers in `[0, num_clusters)`.
+ * @param num_clusters Number of clusters.
+ * @param options Further options.
+ *
+ * @return Batch entropies for both embeddings.
+ */
+inline Comparison compare(const H5::DataSet& uncorrected, const H5::DataSet& corrected, const int* blocks, int num_blocks, const int* clusters, int num_clusters, const Options& options = Options()) {
+    auto dims = utils::get_dimensions(uncorrected);
+    auto cdims = utils::get_dimensions(corrected);
+    if (dims.size() != 2 || cdims.size() != 2 || dims[0] != cdims[0]) {
+        throw std::runtime_error("uncorrected and corrected embeddings should be 2-dimensional with the same number of cells");
+    }
+    check_groups(blocks, dims[0], num_blocks, "batch assignments should be non-negative and less than the number of batches");
+    check_groups(clusters, dims[0], num_clusters, "cluster assignments should be non-negative and less than the number of clusters");
+
+    Comparison output;
+    output.uncorrected = summarize(uncorrected, blocks, num_blocks, clusters, num_clusters, options);
+    output.corrected = summarize(corrected, blocks, num_blocks, clusters, num_clusters, options);
+    return output;
+}
+
+/**
+ * @cond
+ */
+inline void check_mnn(const H5::H5File& handle, int version) {
+    // Pre-v2.0 files record the correction method as the 'block_method' of the 'pca' step.
+    std::string step = (version >= 2000000 ? "batch_correction" : "pca");
+    std::string name = (version >= 2000000 ? "method" : "block_method");
+    auto phandle = utils::check_and_open_group(utils::check_and_open_group(handle, step), "parameters");
+    if (!inspect::has_dataset(phandle, name)) {
+        throw std::runtime_error("batch correction method should be 'mnn' to compare mixing, but '" + step + "/parameters/" + name + "' is absent");
+    }
+    auto method = utils::load_string(phandle, name);
+    if (method != "mnn") {
+        throw std::runtime_error("batch correction method should be 'mnn' to compare mixing, but '" + step + "/parameters/" + name + "' is '" + method + "'");
+    }
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Compare the mixing of batches before and after correction in a state file.
+ * The corrected embedding is taken from `embeddings::open()` with `type = "corrected"`, and the uncorrected embedding is taken from `embeddings::open_uncorrected()`.
+ * The batch correction method must be `"mnn"`, i.e., `batch_correction/parameters/method` (or `pca/parameters/block_method`, for pre-v2.0 files), otherwise an error is raised.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param blocks Pointer to an array containing the batch of each cell after QC filtering, as integers in `[0, num_blocks)`.
+ * @param num_blocks Number of batches.
+ * @param clusters Pointer to an array containing the cluster assignment of each cell after QC filtering, as integers in `[0, num_clusters)`.
+ * @param num_clusters Number of clusters.
+ * @param version Version of the state file.
+ * @param options Further options.
+ *
+ * @return Batch entropies for both embeddings.
+ */
+inline Comparison compare(const H5::H5File& handle, const int* blocks, int num_blocks, const int* clusters, int num_clusters, int version, const Options& options = Options()) {
+    check_mnn(handle, version);
+    auto corrected = embeddings::open(handle, "corrected", version);
+    auto uncorrected = embeddings::open_uncorrected(handle, version);
+    return compare(uncorrected, corrected, blocks, num_blocks, clusters, num_clusters, options);
+}
+
+/**
+ * Compare the mixing of batches before and after correction in a state file, using the samples from `blocks::materialize()` as batches.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param blocks Samples of each cell.
+ * @param clusters Pointer to an array containing the cluster assignment of each cell after QC filtering, as integers in `[0, num_clusters)`.
+ * @param num_clusters Number of clusters.
+ * @param version Version of the state file.
+ * @param options Further options.
+ *
+ * @return Batch entropies for both embeddings.
+ */
+inline Comparison compare(const H5::H5File& handle, const blocks::Blocks& blocks, const int* clusters, int num_clusters, int version, const Options& options = Options()) {
+    check_mnn(handle, version);
+
+    // Checked before reading 'blocks.filtered', which would otherwise be indexed out of bounds.
+    auto dims = utils::get_dimensions(embeddings::open(handle, "corrected", version));
+    if (dims[0] != blocks.filtered.size()) {
+        throw std::runtime_error("number of cells in the embeddings should be equal to the number of cells after filtering");
+    }
+    return compare(handle, blocks.filtered.data(), blocks.num_blocks(), clusters, num_clusters, version, options);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,453 @@
+#ifndef KANAVAL_NEIGHBORS_HPP
+#define KANAVAL_NEIGHBORS_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <thread>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include "utils.hpp"
+#include "embeddings.hpp"
+#include "mapping.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @file neighbors.hpp
+ *
+ * @brief Find the nearest neighbors of each cell in a low-dimensional embedding.
+ */
+
+namespace kanaval {
+
+namespace neighbors {
+
+/**
+ * @brief Options for `find()`.
+ */
+struct Options {
+    /**
+     * Whether to perform an approximate search.
+     * If false, an exact brute-force search is performed.
+     * Small datasets are always searched exactly, as the approximate search offers no benefit.
+     */
+    bool approximate = true;
+
+    /**
+     * Number of random projection trees used to generate the initial candidates in the approximate search.
+     * More trees improve accuracy at the cost of speed.
+     */
+    int num_trees = 8;
+
+    /**
+     * Maximum number of cells in each leaf of the trees.
+     * This is increased to at least the number of neighbors plus 1.
+     */
+    int leaf_size = 32;
+
+    /**
+     * Number of refinement iterations in the approximate search.
+     * In each iteration, the neighbors of each cell's neighbors are considered as candidates.
+     */
+    int num_refinements = 2;
+
+    /**
+     * Number of threads to use.
+     */
+    int num_threads = 1;
+
+    /**
+     * Seed for the random number generator used to build the trees.
+     */
+    uint64_t seed = 42;
+};
+
+/**
+ * @brief Nearest neighbors of each cell.
+ */
+struct Neighbors {
+    /**
+     * Number of neighbors for each cell.
+     */
+    int num_neighbors = 0;
+
+    /**
+     * Row-major matrix with one row per cell and `num_neighbors` columns, containing the indices of the neighbors of each cell in order of increasing distance.
+     * Each cell is excluded from its own neighbors.
+     */
+    std::vector<int> indices;
+
+    /**
+     * Row-major matrix of the same dimensions as `indices`, containing the Euclidean distance to each neighbor.
+     */
+    std::vector<double> distances;
+
+    /**
+     * @return Number of cells.
+     */
+    size_t size() const {
+        return (num_neighbors ? indices.size() / num_neighbors : 0);
+    }
+};
+
+/**
+ * Compute the squared Euclidean distance between two points.
+ * This uses SSE2 instructions where available.
+ *
+ * @param x Pointer to the coordinates of the first point.
+ * @param y Pointer to the coordinates of the second point.
+ * @param ndim Number of dimensions.
+ *
+ * @return The squared distance.
+ */
+inline double squared_distance(const double* x, const double* y, size_t ndim) {
+    size_t d = 0;
+    double output = 0;
+#ifdef __SSE2__
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    for (; d + 4 <= ndim; d += 4) {
+        __m128d diff0 = _mm_sub_pd(_mm_loadu_pd(x + d), _mm_loadu_pd(y + d));
+        __m128d diff1 = _mm_sub_pd(_mm_loadu_pd(x + d + 2), _mm_loadu_pd(y + d + 2));
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(diff0, diff0));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(diff1, diff1));
+    }
+    double partial[2];
+    _mm_storeu_pd(partial, _mm_add_pd(acc0, acc1));
+    output = partial[0] + partial[1];
+#endif
+    for (; d < ndim; ++d) {
+        double diff = x[d] - y[d];
+        output += diff * diff;
+    }
+    return output;
+}
+
+/**
+ * @cond
+ */
+// Bounded max-heap of the closest candidates, ordered by distance and then index for reproducibility.
+class Queue {
+public:
+    Queue(int k) : k(k) {
+        heap.reserve(k + 1);
+    }
+
+    void push(double dist, int index) {
+        if (static_cast<int>(heap.size()) < k) {
+            heap.emplace_back(dist, index);
+            std::push_heap(heap.begin(), heap.end());
+        } else if (k && std::make_pair(dist, index) < heap.front()) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = std::make_pair(dist, index);
+            std::push_heap(heap.begin(), heap.end());
+        }
+    }
+
+    size_t size() const {
+        return heap.size();
+    }
+
+    void report(int* indices, double* distances) {
+        if (static_cast<int>(heap.size()) < k) {
+            throw std::runtime_error("fewer than " + std::to_string(k) + " neighbor candidates were found");
+        }
+        std::sort_heap(heap.begin(), heap.end());
+        for (size_t i = 0; i < heap.size(); ++i) {
+            indices[i] = heap[i].second;
+            distances[i] = std::sqrt(heap[i].first);
+        }
+        heap.clear();
+    }
+
+private:
+    int k;
+    std::vector<std::pair<double, int> > heap;
+};
+
+template<class Function>
+void parallelize(size_t n, int num_threads, Function fun) {
+    size_t nthreads = std::max(1, num_threads);
+    if (nthreads == 1 || n < 2) {
+        fun(0, 0, n);
+        return;
+    }
+
+    size_t per_thread = (n + nthreads - 1) / nthreads;
+    std::vector<std::thread> workers;
+    workers.reserve(nthreads);
+    for (size_t t = 0, start = 0; start < n; ++t, start += per_thread) {
+        workers.emplace_back(fun, t, start, std::min(per_thread, n - start));
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+inline void check_arguments(size_t n, int k) {
+    if (k < 0) {
+        throw std::runtime_error("number of neighbors should be non-negative");
+    }
+    if (n && static_cast<size_t>(k) >= n) {
+        throw std::runtime_error("number of neighbors should be less than the number of cells");
+    }
+}
+
+/*
+ * Split the cells into leaves by recursive random projections. We only need
+ * the leaf membership as the queries are the indexed cells themselves, so
+ * the trees are not stored. Each leaf is a contiguous run of 'order'.
+ */
+inline void build_leaves(const double* data, size_t n, size_t ndim, size_t leaf_size, uint64_t seed, std::vector<int>& order, std::vector<size_t>& bounds) {
+    order.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    bounds.clear();
+
+    std::mt19937_64 rng(seed);
+    std::vector<double> normal(ndim);
+    std::vector<std::pair<size_t, size_t> > stack{ { 0, n } };
+
+    while (!stack.empty()) {
+        auto current = stack.back();
+        stack.pop_back();
+        size_t start = current.first, len = current.second;
+        if (len <= leaf_size) {
+            bounds.push_back(start);
+            continue;
+        }
+
+        // Using the perpendicular bisector of two random cells as the hyperplane.
+        std::uniform_int_distribution<size_t> pick(0, len - 1);
+        size_t a = order[start + pick(rng)], b = order[start + pick(rng)];
+        const double* aptr = data + a * ndim;
+        const double* bptr = data + b * ndim;
+        double offset = 0;
+        for (size_t d = 0; d < ndim; ++d) {
+            normal[d] = aptr[d] - bptr[d];
+            offset += normal[d] * (aptr[d] + bptr[d]) / 2;
+        }
+
+        auto first = order.begin() + start, last = first + len;
+        auto middle = std::partition(first, last, [&](int i) -> bool {
+            const double* ptr = data + static_cast<size_t>(i) * ndim;
+            double proj = 0;
+            for (size_t d = 0; d < ndim; ++d) {
+                proj += normal[d] * ptr[d];
+            }
+            return proj < offset;
+        });
+
+        // Falling back to an arbitrary split for duplicated cells, to guarantee termination.
+        size_t left = middle - first;
+        if (left == 0 || left == len) {
+            left = len / 2;
+        }
+        stack.emplace_back(start, left);
+        stack.emplace_back(start + left, len - left);
+    }
+
+    std::sort(bounds.begin(), bounds.end());
+    bounds.push_back(n);
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Find the exact nearest neighbors of each cell by brute force.
+ * The cells are split across threads, each of which computes the distances from its cells to all other cells.
+ *
+ * @param data Pointer to a row-major array with one row per cell and `ndim` columns.
+ * @param n Number of cells.
+ * @param ndim Number of dimensions.
+ * @param k Number of neighbors, which should be less than `n`.
+ * @param num_threads Number of threads to use.
+ *
+ * @return The nearest neighbors of each cell.
+ */
+inline Neighbors find_exact(const double* data, size_t n, size_t ndim, int k, int num_threads = 1) {
+    check_arguments(n, k);
+    Neighbors output;
+    output.num_neighbors = k;
+    output.indices.resize(n * k);
+    output.distances.resize(n * k);
+
+    parallelize(n, num_threads, [&](size_t, size_t start, size_t len) -> void {
+        Queue queue(k);
+        for (size_t i = start, end = start + len; i < end; ++i) {
+            const double* iptr = data + i * ndim;
+            for (size_t j = 0; j < n; ++j) {
+                if (j != i) {
+                    queue.push(squared_distance(iptr, data + j * ndim, ndim), j);
+                }
+            }
+            queue.report(output.indices.data() + i * k, output.distances.data() + i * k);
+        }
+    });
+
+    return output;
+}
+
+/**
+ * Find the approximate nearest neighbors of each cell.
+ * Candidates are initially taken from the leaves of several random projection trees that contain each cell;
+ * these are refined by considering the neighbors of each cell's neighbors, as in NN-descent.
+ * Trees are built and cells are searched in parallel, and the results do not depend on the number of threads.
+ *
+ * @param data Pointer to a row-major array with one row per cell and `ndim` columns.
+ * @param n Number of cells.
+ * @param ndim Number of dimensions.
+ * @param k Number of neighbors, which should be less than `n`.
+ * @param options Further options.
+ *
+ * @return The nearest neighbors of each cell.
+ */
+inline Neighbors find_approximate(const double* data, size_t n, size_t ndim, int k, const Options& options = Options()) {
+    check_arguments(n, k);
+    size_t leaf_size = std::max<size_t>(options.leaf_size, k + 1);
+    size_t ntrees = std::max(1, options.num_trees);
+
+    // Each tree is built by a single thread, as the partitioning is not easily parallelized.
+    std::vector<std::vector<int> > orders(ntrees);
+    std::vector<std::vector<size_t> > bounds(ntrees);
+    std::vector<std::vector<int> > leaf_of(ntrees);
+    parallelize(ntrees, options.num_threads, [&](size_t, size_t start, size_t len) -> void {
+        for (size_t t = start, end = start + len; t < end; ++t) {
+            build_leaves(data, n, ndim, leaf_size, options.seed + t, orders[t], bounds[t]);
+            auto& current = leaf_of[t];
+            current.resize(n);
+            for (size_t l = 0; l + 1 < bounds[t].size(); ++l) {
+                for (size_t p = bounds[t][l]; p < bounds[t][l + 1]; ++p) {
+                    current[orders[t][p]] = l;
+                }
+            }
+        }
+    });
+
+    Neighbors output;
+    output.num_neighbors = k;
+    output.indices.resize(n * k);
+    output.distances.resize(n * k);
+
+    // Marking visited candidates with the index of the current cell, so that each candidate is only considered once.
+    parallelize(n, options.num_threads, [&](size_t, size_t start, size_t len) -> void {
+        Queue queue(k);
+        std::vector<size_t> visited(n, -1);
+        for (size_t i = start, end = start + len; i < end; ++i) {
+            const double* iptr = data + i * ndim;
+            visited[i] = i;
+            for (size_t t = 0; t < ntrees; ++t) {
+                auto leaf = leaf_of[t][i];
+                for (size_t p = bounds[t][leaf], last = bounds[t][leaf + 1]; p < last; ++p) {
+                    int j = orders[t][p];
+                    if (visited[j] != i) {
+                        visited[j] = i;
+                        queue.push(squared_distance(iptr, data + static_cast<size_t>(j) * ndim, ndim), j);
+                    }
+                }
+            }
+
+            // Leaves can be smaller than 'leaf_size' after a lopsided split, so we top up with arbitrary cells for the refinement to improve upon.
+            for (size_t j = 0; j < n && queue.size() < static_cast<size_t>(k); ++j) {
+                if (visited[j] != i) {
+                    visited[j] = i;
+                    queue.push(squared_distance(iptr, data + j * ndim, ndim), j);
+                }
+            }
+            queue.report(output.indices.data() + i * k, output.distances.data() + i * k);
+        }
+    });
+
+    // Refining from a copy of the previous iteration, so that the results are independent of the thread scheduling.
+    for (int r = 0; r < options.num_refinements; ++r) {
+        Neighbors next = output;
+        parallelize(n, options.num_threads, [&](size_t, size_t start, size_t len) -> void {
+            Queue queue(k);
+            std::vector<size_t> visited(n, -1);
+            for (size_t i = start, end = start + len; i < end; ++i) {
+                const double* iptr = data + i * ndim;
+                const int* current = output.indices.data() + i * k;
+                visited[i] = i;
+                for (int x = 0; x < k; ++x) {
+                    int j = current[x];
+                    visited[j] = i;
+                    double dist = output.distances[i * k + x];
+                    queue.push(dist * dist, j);
+                }
+
+                for (int x = 0; x < k; ++x) {
+                    const int* second = output.indices.data() + static_cast<size_t>(current[x]) * k;
+                    for (int y = 0; y < k; ++y) {
+                        int j = second[y];
+                        if (visited[j] != i) {
+                            visited[j] = i;
+                            queue.push(squared_distance(iptr, data + static_cast<size_t>(j) * ndim, ndim), j);
+                        }
+                    }
+                }
+                queue.report(next.indices.data() + i * k, next.distances.data() + i * k);
+            }
+        });
+        output = std::move(next);
+    }
+
+    return output;
+}
+
+/**
+ * Find the nearest neighbors of each cell, using an approximate search for large datasets and an exact search otherwise.
+ *
+ * @param data Pointer to a row-major array with one row per cell and `ndim` columns.
+ * @param n Number of cells.
+ * @param ndim Number of dimensions.
+ * @param k Number of neighbors, which should be less than `n`.
+ * @param options Further options.
+ *
+ * @return The nearest neighbors of each cell.
+ */
+inline Neighbors find(const double* data, size_t n, size_t ndim, int k, const Options& options = Options()) {
+    // Below this size, the leaves cover most of the dataset anyway.
+    size_t min_size = static_cast<size_t>(std::max(options.leaf_size, k + 1)) * 4;
+    if (!options.approximate || n <= min_size) {
+        return find_exact(data, n, ndim, k, options.num_threads);
+    } else {
+        return find_approximate(data, n, ndim, k, options);
+    }
+}
+
+/**
+ * Find the nearest neighbors of each cell in an embedding from the state file, e.g., the PCs.
+ * The embedding is memory-mapped if possible (see `mapping::can_map()`), otherwise it is read in blocks with `embeddings::read()`.
+ *
+ * @param dhandle Handle to a 2-dimensional float dataset with one row per cell.
+ * @param k Number of neighbors, which should be less than the number of cells.
+ * @param options Further options.
+ *
+ * @return The nearest neighbors of each cell.
+ */
+inline Neighbors find(const H5::DataSet& dhandle, int k, const Options& options = Options()) {
+    auto dims = utils::get_dimensions(dhandle);
+    if (dims.size() != 2) {
+        throw std::runtime_error("expected a 2-dimensional dataset");
+    }
+
+    if (mapping::can_map<double>(dhandle)) {
+        auto view = mapping::map<double>(dhandle);
+        return find(view.data(), dims[0], dims[1], k, options);
+    }
+
+    auto embedding = embeddings::read<double>(dhandle);
+    return find(embedding.values.data(), dims[0], dims[1], k, options);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,838 @@
+#ifndef KANAVAL_OBJECT_STORE_HPP
+#define KANAVAL_OBJECT_STORE_HPP
+
+#include "H5Cpp.h"
+#include "H5FDpublic.h"
+#if H5_VERSION_GE(1, 13, 0)
+#include "H5FDdevelop.h"
+#endif
+#include "curl/curl.h"
+
+#include <vector>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * @file object_store.hpp
+ *
+ * @brief Read state files and `*.kana` files from an object store via HTTP range requests.
+ */
+
+namespace kanaval {
+
+namespace object_store {
+
+/**
+ * @brief Transport for fetching byte ranges of a remote object.
+ *
+ * This is an interface so that the caching in `Source` can be used with other transports, e.g., a local file in tests.
+ */
+class Transport {
+public:
+    /**
+     * @cond
+     */
+    virtual ~Transport() = default;
+    /**
+     * @endcond
+     */
+
+    /**
+     * @return Size of the object in bytes.
+     */
+    virtual hsize_t size() = 0;
+
+    /**
+     * Fetch a contiguous range of bytes.
+     * This may be called concurrently from multiple threads.
+     *
+     * @param start Offset of the first byte.
+     * @param len Number of bytes to fetch.
+     * @param[out] output Pointer to an array of length `len`, filled with the requested bytes.
+     */
+    virtual void fetch(hsize_t start, hsize_t len, unsigned char* output) = 0;
+};
+
+/**
+ * @brief Transport for objects served over HTTP(S), e.g., from an S3-compatible store.
+ *
+ * Each request is a `GET` with a `Range` header, so the server must support range requests.
+ * Private objects can be accessed through pre-signed URLs or by supplying the appropriate headers.
+ */
+class HttpTransport : public Transport {
+public:
+    /**
+     * @param url URL of the object.
+     * @param headers Additional HTTP headers for each request, e.g., `"Authorization: ..."`.
+     * @param timeout Timeout for each request, in seconds.
+     */
+    HttpTransport(std::string url, std::vector<std::string> headers = std::vector<std::string>(), long timeout = 60) :
+        url_(std::move(url)), headers_(std::move(headers)), timeout_(timeout)
+    {
+        static std::once_flag initialized;
+        std::call_once(initialized, []() -> void { curl_global_init(CURL_GLOBAL_DEFAULT); });
+    }
+
+    hsize_t size() {
+        std::lock_guard<std::mutex> lock(size_lock);
+        if (size_ >= 0) {
+            return size_;
+        }
+
+        // Using a single-byte GET rather than a HEAD request, as pre-signed S3 URLs are only valid for one method.
+        // The size is then taken from the 'Content-Range' header of the response.
+        auto curl = prepare();
+        curl_easy_setopt(curl.get(), CURLOPT_RANGE, "0-0");
+        unsigned char first;
+        Sink sink{ &first, 1, 0 };
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, Sink::write);
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &sink);
+        ContentRange range;
+        curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION, ContentRange::write);
+        curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &range);
+
+        auto res = curl_easy_perform(curl.get());
+        long code = 0;
+        curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &code);
+
+        long long len = -1;
+        if (code == 206 || code == 416) { // 416 is returned for empty objects, with a Content-Range of '*/0'.
+            auto slash = range.value.find('/');
+            if (slash != std::string::npos) {
+                char* end = NULL;
+                len = std::strtoll(range.value.c_str() + slash + 1, &end, 10);
+                if (end == range.value.c_str() + slash + 1) {
+                    len = -1;
+                }
+            }
+        } else if (code == 200 && (res == CURLE_OK || res == CURLE_WRITE_ERROR)) {
+            // The server ignored the range, so the sink aborted the transfer after the headers; the size is the length of the entire object.
+            curl_off_t clen = -1;
+            curl_easy_getinfo(curl.get(), CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &clen);
+            len = clen;
+        } else if (res != CURLE_OK) {
+            throw std::runtime_error("failed to request GET 0-0 from '" + url_ + "': " + curl_easy_strerror(res));
+        } else {
+            throw std::runtime_error("failed to request GET 0-0 from '" + url_ + "' (HTTP " + std::to_string(code) + ")");
+        }
+
+        if (len < 0) {
+            throw std::runtime_error("failed to determine the size of '" + url_ + "'");
+        }
+        size_ = len;
+        return size_;
+    }
+
+    void fetch(hsize_t start, hsize_t len, unsigned char* output) {
+        if (len == 0) {
+            return;
+        }
+
+        auto curl = prepare();
+        std::string range = std::to_string(start) + "-" + std::to_string(start + len - 1);
+        curl_easy_setopt(curl.get(), CURLOPT_RANGE, range.c_str());
+
+        Sink sink{ output, len, 0 };
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, Sink::write);
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &sink);
+        long code = perform(curl.get(), "GET " + range);
+
+        if (code != 206 && !(code == 200 && start == 0)) {
+            throw std::runtime_error("server for '" + url_ + "' does not support range requests");
+        }
+        if (sink.filled != len) {
+            throw std::runtime_error("expected " + std::to_string(len) + " bytes from '" + url_ + "' but got " + std::to_string(sink.filled));
+        }
+    }
+
+private:
+    std::string url_;
+    std::vector<std::string> headers_;
+    long timeout_;
+    std::mutex size_lock;
+    long long size_ = -1;
+
+    struct Sink {
+        unsigned char* output;
+        hsize_t capacity;
+        hsize_t filled;
+
+        static size_t write(char* ptr, size_t size, size_t nmemb, void* data) {
+            auto sink = static_cast<Sink*>(data);
+            size_t n = size * nmemb;
+            if (sink->filled + n > sink->capacity) {
+                return 0; // aborts the transfer, e.g., if the server ignored the range and sent everything.
+            }
+            std::memcpy(sink->output + sink->filled, ptr, n);
+            sink->filled += n;
+            return n;
+        }
+    };
+
+    struct ContentRange {
+        std::string value;
+
+        static size_t write(char* ptr, size_t size, size_t nmemb, void* data) {
+            auto range = static_cast<ContentRange*>(data);
+            size_t n = size * nmemb;
+            std::string line(ptr, n);
+            if (line.compare(0, 5, "HTTP/") == 0) {
+                range->value.clear(); // start of a new response, e.g., after a redirect.
+            }
+
+            static const std::string name = "content-range:";
+            if (line.size() > name.size() && std::equal(name.begin(), name.end(), line.begin(), [](char x, char y) -> bool { return x == std::tolower(static_cast<unsigned char>(y)); })) {
+                range->value = line.substr(name.size());
+            }
+            return n;
+        }
+    };
+
+    struct Deleter {
+        curl_slist* headers = NULL;
+        void operator()(CURL* curl) const {
+            curl_easy_cleanup(curl);
+            curl_slist_free_all(headers);
+        }
+    };
+
+    std::unique_ptr<CURL, Deleter> prepare() const {
+        Deleter del;
+        for (const auto& h : headers_) {
+            del.headers = curl_slist_append(del.headers, h.c_str());
+        }
+        std::unique_ptr<CURL, Deleter> curl(curl_easy_init(), del);
+        if (!curl) {
+            throw std::runtime_error("failed to initialize a HTTP request");
+        }
+        curl_easy_setopt(curl.get(), CURLOPT_URL, url_.c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT, timeout_);
+        curl_easy_setopt(curl.get(), CURLOPT_NOSIGNAL, 1L); // required for use in multiple threads.
+        if (curl.get_deleter().headers) {
+            curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, curl.get_deleter().headers);
+        }
+        return curl;
+    }
+
+    long perform(CURL* curl, const std::string& what) const {
+        auto res = curl_easy_perform(curl);
+        if (res != CURLE_OK) {
+            throw std::runtime_error("failed to request " + what + " from '" + url_ + "': " + curl_easy_strerror(res));
+        }
+        long code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+        if (code >= 400) {
+            throw std::runtime_error("failed to request " + what + " from '" + url_ + "' (HTTP " + std::to_string(code) + ")");
+        }
+        return code;
+    }
+};
+
+/**
+ * @brief Options for `Source`.
+ */
+struct Options {
+    /**
+     * Size of each cached block in bytes.
+     * All requests are aligned to block boundaries.
+     */
+    hsize_t block_size = 65536;
+
+    /**
+     * Maximum number of blocks to hold in the cache.
+     */
+    size_t cache_blocks = 512;
+
+    /**
+     * Maximum number of consecutive blocks to coalesce into a single request.
+     */
+    size_t max_request_blocks = 64;
+
+    /**
+     * Maximum number of blocks to prefetch in the background after sequential reads.
+     * Set to zero to disable prefetching.
+     */
+    size_t prefetch_blocks = 8;
+
+    /**
+     * Maximum number of concurrent requests for a single read.
+     */
+    int num_threads = 4;
+};
+
+/**
+ * @brief Statistics for the requests made by a `Source`.
+ */
+struct Statistics {
+    /**
+     * Number of range requests.
+     */
+    size_t requests = 0;
+
+    /**
+     * Total number of bytes fetched from the transport.
+     */
+    hsize_t bytes_fetched = 0;
+
+    /**
+     * Number of block lookups that were served from the cache.
+     */
+    size_t cache_hits = 0;
+
+    /**
+     * Number of block lookups that required a request.
+     */
+    size_t cache_misses = 0;
+};
+
+/**
+ * @brief Cached random-access reader for a remote object.
+ *
+ * Reads are split into fixed-size blocks that are held in a LRU cache.
+ * Missing blocks are coalesced into runs of consecutive blocks, each of which is fetched with a single range request;
+ * independent runs are fetched in parallel and copied directly into the output, so reads larger than the cache are fetched only once.
+ * Only the blocks at either end of a read, which are partially requested and are likely to be needed by the next read, are added to the cache.
+ * When reads are sequential, the following blocks are prefetched in the background so that they are already available for the next read.
+ *
+ * Reads may be performed from multiple threads.
+ */
+class Source {
+public:
+    /**
+     * @param transport Transport for the remote object.
+     * @param options Further options.
+     */
+    Source(std::unique_ptr<Transport> transport, Options options = Options()) : transport_(std::move(transport)), options_(std::move(options)) {
+        if (options_.block_size == 0) {
+            throw std::runtime_error("block size should be positive");
+        }
+        options_.cache_blocks = std::max(options_.cache_blocks, options_.max_request_blocks + options_.prefetch_blocks);
+        size_ = transport_->size();
+    }
+
+    /**
+     * @param url URL of the object, see `HttpTransport`.
+     * @param options Further options.
+     */
+    Source(std::string url, Options options = Options()) : Source(std::unique_ptr<Transport>(new HttpTransport(std::move(url))), std::move(options)) {}
+
+    /**
+     * @param url URL of the object, see `HttpTransport`.
+     * @param headers Additional HTTP headers for each request, e.g., `"Authorization: ..."`.
+     * @param options Further options.
+     */
+    Source(std::string url, std::vector<std::string> headers, Options options = Options()) :
+        Source(std::unique_ptr<Transport>(new HttpTransport(std::move(url), std::move(headers))), std::move(options)) {}
+
+    /**
+     * @cond
+     */
+    ~Source() {
+        for (auto& p : prefetches) {
+            p.wait();
+        }
+    }
+
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+    /**
+     * @endcond
+     */
+
+    /**
+     * @return Size of the object in bytes.
+     */
+    hsize_t size() const {
+        return size_;
+    }
+
+    /**
+     * @param start Offset of the first byte.
+     * @param len Number of bytes to read.
+     * This should not extend past `size()`.
+     * @param[out] output Pointer to an array of length `len`, filled with the requested bytes.
+     */
+    void read(hsize_t start, hsize_t len, unsigned char* output) {
+        if (len == 0) {
+            return;
+        }
+        if (start + len > size_) {
+            throw std::runtime_error("requested range extends past the end of the object");
+        }
+
+        hsize_t first = start / options_.block_size;
+        hsize_t last = (start + len - 1) / options_.block_size;
+
+        std::vector<std::pair<hsize_t, hsize_t> > runs, prefetch_runs;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (hsize_t b = first; b <= last; ++b) {
+                if (cache.count(b) || inflight.count(b)) {
+                    ++stats.cache_hits;
+                } else {
+                    ++stats.cache_misses;
+                    add_to_runs(runs, b);
+                    inflight.insert(b);
+                }
+            }
+
+            // Only prefetching for sequential access, which is common when HDF5 reads contiguous datasets or chunks.
+            // The readahead doubles with each consecutive sequential read, so scattered metadata reads do not trigger large prefetches.
+            if (first == last_block + 1) {
+                ++streak;
+            } else if (first != last_block) {
+                streak = 0;
+            }
+            last_block = last;
+            if (streak && options_.prefetch_blocks) {
+                hsize_t nblocks = (size_ + options_.block_size - 1) / options_.block_size;
+                hsize_t ahead = std::min<hsize_t>(options_.prefetch_blocks, static_cast<hsize_t>(1) << std::min<size_t>(streak - 1, 20));
+                hsize_t end = std::min(nblocks, last + 1 + ahead);
+                for (hsize_t b = last + 1; b < end; ++b) {
+                    if (!cache.count(b) && !inflight.count(b)) {
+                        add_to_runs(prefetch_runs, b);
+                        inflight.insert(b);
+                    }
+                }
+            }
+        }
+
+        if (!prefetch_runs.empty()) {
+            launch_prefetch(std::move(prefetch_runs));
+        }
+
+        // Missing blocks are copied straight into 'output' as they are fetched, and only partially requested blocks are cached.
+        // Otherwise, a read larger than the cache would evict its own blocks before they could be copied.
+        Destination dest{ output, start, len };
+        fetch_runs(runs, &dest);
+        std::vector<unsigned char> copied(last - first + 1);
+        for (const auto& r : runs) {
+            std::fill_n(copied.begin() + (r.first - first), r.second, 1);
+        }
+
+        // Copying the remaining blocks from the cache, waiting for any blocks that are still being fetched by a prefetch.
+        std::unique_lock<std::mutex> lock(mutex);
+        for (hsize_t b = first; b <= last; ++b) {
+            if (copied[b - first]) {
+                continue;
+            }
+
+            // Repeating the lookup after every wait or fetch, as other threads may evict the block whenever the lock is released.
+            auto it = cache.find(b);
+            while (it == cache.end()) {
+                if (inflight.count(b)) {
+                    fetched.wait(lock, [&]() -> bool { return !inflight.count(b); });
+                } else {
+                    // Prefetch failed or the block was evicted, so we fetch it ourselves.
+                    inflight.insert(b);
+                    lock.unlock();
+                    std::vector<std::pair<hsize_t, hsize_t> > single{ { b, 1 } };
+                    fetch_runs(single, NULL);
+                    lock.lock();
+                }
+                it = cache.find(b);
+            }
+
+            lru.splice(lru.begin(), lru, it->second.position);
+            const auto& block = it->second.data;
+            hsize_t block_start = b * options_.block_size;
+            hsize_t from = std::max(start, block_start);
+            hsize_t to = std::min(start + len, block_start + block.size());
+            std::memcpy(output + (from - start), block.data() + (from - block_start), to - from);
+        }
+    }
+
+    /**
+     * @param start Offset of the first byte.
+     * @param len Number of bytes to read.
+     * This should not extend past `size()`.
+     * @return The requested bytes.
+     */
+    std::string read(hsize_t start, hsize_t len) {
+        std::string output(len, '\0');
+        read(start, len, reinterpret_cast<unsigned char*>(&output[0]));
+        return output;
+    }
+
+    /**
+     * @return Statistics for the requests made so far.
+     */
+    Statistics statistics() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+    std::unique_ptr<Transport> transport_;
+    Options options_;
+    hsize_t size_;
+
+    struct Block {
+        std::vector<unsigned char> data;
+        std::list<hsize_t>::iterator position;
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable fetched;
+    std::unordered_map<hsize_t, Block> cache;
+    std::list<hsize_t> lru;
+    std::unordered_set<hsize_t> inflight;
+    Statistics stats;
+    hsize_t last_block = static_cast<hsize_t>(-2);
+    size_t streak = 0;
+    std::vector<std::future<void> > prefetches;
+
+    struct Destination {
+        unsigned char* output;
+        hsize_t start;
+        hsize_t len;
+    };
+
+private:
+    void add_to_runs(std::vector<std::pair<hsize_t, hsize_t> >& runs, hsize_t b) const {
+        if (!runs.empty()) {
+            auto& back = runs.back();
+            if (back.first + back.second == b && back.second < options_.max_request_blocks) {
+                ++back.second;
+                return;
+            }
+        }
+        runs.emplace_back(b, 1);
+    }
+
+    void fetch_run(hsize_t first, hsize_t count, const Destination* dest) {
+        hsize_t start = first * options_.block_size;
+        hsize_t len = std::min(count * options_.block_size, size_ - start);
+        std::vector<unsigned char> buffer(len);
+
+        try {
+            transport_->fetch(start, len, buffer.data());
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (hsize_t b = first; b < first + count; ++b) {
+                inflight.erase(b);
+            }
+            fetched.notify_all();
+            throw;
+        }
+
+        if (dest) {
+            hsize_t from = std::max(start, dest->start);
+            hsize_t to = std::min(start + len, dest->start + dest->len);
+            std::memcpy(dest->output + (from - dest->start), buffer.data() + (from - start), to - from);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats.requests;
+        stats.bytes_fetched += len;
+        for (hsize_t i = 0; i < count; ++i) {
+            hsize_t b = first + i;
+            auto offset = i * options_.block_size;
+            auto end = std::min(offset + options_.block_size, len);
+
+            // Blocks that were entirely copied into the destination are unlikely to be requested again, so they are not cached.
+            if (dest && start + offset >= dest->start && start + end <= dest->start + dest->len) {
+                inflight.erase(b);
+                continue;
+            }
+
+            auto& block = cache[b];
+            if (!block.data.empty()) {
+                lru.erase(block.position); // fetched twice, e.g., after a failed prefetch.
+            }
+            lru.push_front(b);
+            block.data.assign(buffer.begin() + offset, buffer.begin() + end);
+            block.position = lru.begin();
+            inflight.erase(b);
+        }
+
+        while (cache.size() > options_.cache_blocks) {
+            cache.erase(lru.back());
+            lru.pop_back();
+        }
+        fetched.notify_all();
+    }
+
+    void fetch_runs(const std::vector<std::pair<hsize_t, hsize_t> >& runs, const Destination* dest) {
+        if (runs.empty()) {
+            return;
+        }
+        size_t nthreads = std::min(runs.size(), static_cast<size_t>(std::max(1, options_.num_threads)));
+        if (nthreads == 1) {
+            for (const auto& r : runs) {
+                fetch_run(r.first, r.second, dest);
+            }
+            return;
+        }
+
+        // Each worker takes every nthreads-th run, and all runs are attempted even if one fails.
+        std::vector<std::future<void> > workers;
+        workers.reserve(nthreads);
+        for (size_t t = 0; t < nthreads; ++t) {
+            workers.push_back(std::async(std::launch::async, [&, t]() -> void {
+                std::exception_ptr err;
+                for (size_t r = t; r < runs.size(); r += nthreads) {
+                    try {
+                        fetch_run(runs[r].first, runs[r].second, dest);
+                    } catch (...) {
+                        err = std::current_exception();
+                    }
+                }
+                if (err) {
+                    std::rethrow_exception(err);
+                }
+            }));
+        }
+        for (auto& w : workers) {
+            w.wait();
+        }
+        for (auto& w : workers) {
+            w.get();
+        }
+    }
+
+    void launch_prefetch(std::vector<std::pair<hsize_t, hsize_t> > runs) {
+        // Discarding completed prefetches; their errors are ignored as the blocks will be fetched again on demand.
+        std::vector<std::future<void> > remaining;
+        for (auto& p : prefetches) {
+            if (p.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                remaining.push_back(std::move(p));
+            }
+        }
+        prefetches.swap(remaining);
+
+        prefetches.push_back(std::async(std::launch::async, [this, runs]() -> void {
+            for (const auto& r : runs) {
+                try {
+                    fetch_run(r.first, r.second, NULL);
+                } catch (...) {}
+            }
+        }));
+    }
+};
+
+/**
+ * @cond
+ */
+namespace vfd {
+
+struct Config {
+    Source* source;
+    hsize_t offset;
+    hsize_t size;
+};
+
+struct File {
+    H5FD_t pub; // must be first.
+    Config config;
+    haddr_t eoa;
+};
+
+inline H5FD_t* open(const char*, unsigned flags, hid_t fapl, haddr_t) {
+    if (flags & (H5F_ACC_RDWR | H5F_ACC_CREAT | H5F_ACC_TRUNC)) {
+        return NULL;
+    }
+    auto config = static_cast<const Config*>(H5Pget_driver_info(fapl));
+    if (config == NULL || config->source == NULL) {
+        return NULL;
+    }
+    auto file = new File();
+    file->config = *config;
+    file->eoa = 0;
+    return &(file->pub);
+}
+
+inline herr_t close(H5FD_t* file) {
+    delete reinterpret_cast<File*>(file);
+    return 0;
+}
+
+inline herr_t query(const H5FD_t*, unsigned long* flags) {
+    // Data sieving and metadata accumulation turn HDF5's many small reads into fewer, larger ones.
+    *flags = H5FD_FEAT_DATA_SIEVE | H5FD_FEAT_ACCUMULATE_METADATA | H5FD_FEAT_AGGREGATE_METADATA;
+    return 0;
+}
+
+inline haddr_t get_eoa(const H5FD_t* file, H5FD_mem_t) {
+    return reinterpret_cast<const File*>(file)->eoa;
+}
+
+inline herr_t set_eoa(H5FD_t* file, H5FD_mem_t, haddr_t addr) {
+    reinterpret_cast<File*>(file)->eoa = addr;
+    return 0;
+}
+
+inline haddr_t get_eof(const H5FD_t* file, H5FD_mem_t) {
+    return reinterpret_cast<const File*>(file)->config.size;
+}
+
+inline herr_t read(H5FD_t* file, H5FD_mem_t, hid_t, haddr_t addr, size_t size, void* buffer) {
+    const auto& config = reinterpret_cast<File*>(file)->config;
+    auto output = static_cast<unsigned char*>(buffer);
+
+    // Reads past the end of the file are filled with zeros, consistent with the default drivers.
+    size_t available = (addr >= config.size ? 0 : std::min<hsize_t>(size, config.size - addr));
+    try {
+        config.source->read(config.offset + addr, available, output);
+    } catch (...) {
+        return -1;
+    }
+    std::fill(output + available, output + size, 0);
+    return 0;
+}
+
+inline herr_t write(H5FD_t*, H5FD_mem_t, hid_t, haddr_t, size_t, const void*) {
+    return -1;
+}
+
+inline hid_t driver() {
+    static H5FD_class_t cls = []() -> H5FD_class_t {
+        H5FD_class_t cls;
+        std::memset(&cls, 0, sizeof(cls));
+#if H5_VERSION_GE(1, 13, 0)
+        cls.version = H5FD_CLASS_VERSION;
+        cls.value = static_cast<H5FD_class_value_t>(510); // in the range set aside for drivers outside of the HDF5 library.
+#endif
+        cls.name = "kanaval_object_store";
+        cls.maxaddr = HADDR_MAX;
+        cls.fc_degree = H5F_CLOSE_WEAK;
+        cls.fapl_size = sizeof(Config);
+        cls.open = open;
+        cls.close = close;
+        cls.query = query;
+        cls.get_eoa = get_eoa;
+        cls.set_eoa = set_eoa;
+        cls.get_eof = get_eof;
+        cls.read = read;
+        cls.write = write;
+        return cls;
+    }();
+
+    static hid_t id = H5FDregister(&cls);
+    if (id < 0) {
+        throw std::runtime_error("failed to register the object store driver for HDF5");
+    }
+    return id;
+}
+
+}
+/**
+ * @endcond
+ */
+
+/**
+ * @param path Path to a file.
+ * @return Whether `path` is a HTTP(S) URL that should be read with a `Source`.
+ */
+inline bool is_url(const std::string& path) {
+    return path.rfind("http://", 0) == 0 || path.rfind("https://", 0) == 0;
+}
+
+/**
+ * @brief Location of the state file inside a remote object.
+ */
+struct StateLocation {
+    /**
+     * Offset of the state file from the start of the object.
+     */
+    hsize_t offset = 0;
+
+    /**
+     * Size of the state file in bytes.
+     */
+    hsize_t size = 0;
+
+    /**
+     * Whether the object is a `*.kana` file with embedded inputs.
+     * If true, the embedded files start at `offset + size`, see `embedded::list_files()` for their positions.
+     */
+    bool embedded = false;
+};
+
+/**
+ * Find the state file in a remote object, which may be either a HDF5 state file or a `*.kana` file.
+ * In the latter case, only the 24-byte header is read to locate the state file, see `embedded::kana_data_offset()` for details.
+ *
+ * @param source Source for the remote object.
+ * @return Location of the state file.
+ */
+inline StateLocation locate_state(Source& source) {
+    StateLocation output;
+    output.size = source.size();
+    if (source.size() < 24) {
+        return output;
+    }
+
+    unsigned char header[24];
+    source.read(0, 24, header);
+    const unsigned char signature[8] = { 0x89, 'H', 'D', 'F', '\r', '\n', 0x1a, '\n' };
+    if (std::memcmp(header, signature, 8) == 0) {
+        return output;
+    }
+
+    auto decode = [&](int start) -> hsize_t {
+        hsize_t value = 0;
+        for (int i = 7; i >= 0; --i) {
+            value = (value << 8) | header[start + i];
+        }
+        return value;
+    };
+
+    output.offset = 24;
+    output.size = decode(16);
+    output.embedded = (decode(0) == 0);
+    if (output.offset + output.size > source.size()) {
+        throw std::runtime_error("state file extends past the end of the kana file");
+    }
+    return output;
+}
+
+/**
+ * Open a HDF5 file stored in a remote object.
+ * All HDF5 reads are served by `source`, so only the parts of the file that are actually accessed are fetched.
+ *
+ * @param source Source for the remote object.
+ * This should not be destroyed while the returned file handle is in use.
+ * @param location Location of the HDF5 file in the object, usually from `locate_state()`.
+ *
+ * @return Read-only handle to the HDF5 file.
+ */
+inline H5::H5File open_hdf5(Source& source, const StateLocation& location) {
+    H5::FileAccPropList fapl;
+    vfd::Config config{ &source, location.offset, location.size };
+    if (H5Pset_driver(fapl.getId(), vfd::driver(), &config) < 0) {
+        throw std::runtime_error("failed to set the object store driver for HDF5");
+    }
+    return H5::H5File("object_store", H5F_ACC_RDONLY, H5::FileCreatPropList::DEFAULT, fapl);
+}
+
+/**
+ * Overload of `open_hdf5()` that locates the state file with `locate_state()`.
+ *
+ * @param source Source for the remote object.
+ * This should not be destroyed while the returned file handle is in use.
+ *
+ * @return Read-only handle to the state file.
+ */
+inline H5::H5File open_hdf5(Source& source) {
+    return open_hdf5(source, locate_state(source));
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef KANAVAL_PROGRESS_HPP
+#define KANAVAL_PROGRESS_HPP
+
+#include "H5Cpp.h"
+#include <string>
+#include <stdexcept>
+
+/**
+ * @file progress.hpp
+ *
+ * @brief Write and read state files while an analysis is still in progress.
+ */
+
+namespace kanaval {
+
+namespace progress {
+
+/**
+ * Name of the marker dataset inside each step group.
+ * This is a scalar integer that is non-zero once all contents of the step have been written.
+ */
+inline const char* marker_name() {
+    return "completed";
+}
+
+/**
+ * Check whether an analysis step has been completed, i.e., its group contains a non-zero marker.
+ *
+ * @param handle Open handle to a HDF5 state file.
+ * @param step Name of the analysis step.
+ *
+ * @return Whether the step is complete.
+ * This is false if the step group or its marker does not exist.
+ */
+inline bool is_complete(const H5::Group& handle, const std::string& step) {
+    if (!handle.exists(step) || handle.childObjType(step) != H5O_TYPE_GROUP) {
+        return false;
+    }
+    auto shandle = handle.openGroup(step);
+    if (!shandle.exists(marker_name()) || shandle.childObjType(marker_name()) != H5O_TYPE_DATASET) {
+        return false;
+    }
+
+    auto dhandle = shandle.openDataSet(marker_name());
+    if (dhandle.getSpace().getSimpleExtentNdims() != 0 || dhandle.getTypeClass() != H5T_INTEGER) {
+        return false;
+    }
+    int val = 0;
+    dhandle.read(&val, H5::PredType::NATIVE_INT);
+    return val != 0;
+}
+
+/**
+ * Open a state file that may still be being written.
+ * If the file was created by a `Writer`, it is opened in single-writer/multiple-reader (SWMR) mode so that it can be read safely while the writer is active.
+ * Otherwise, it is opened as a regular read-only file.
+ *
+ * @param path Path to the state file.
+ *
+ * @return Handle to the file.
+ */
+inline H5::H5File open(const std::string& path) {
+    hid_t fid;
+    H5E_BEGIN_TRY {
+        fid = H5Fopen(path.c_str(), H5F_ACC_RDONLY | H5F_ACC_SWMR_READ, H5P_DEFAULT);
+    } H5E_END_TRY;
+
+    if (fid < 0) {
+        return H5::H5File(path, H5F_ACC_RDONLY);
+    }
+    H5Fclose(fid);
+    return H5::H5File(path, H5F_ACC_RDONLY | H5F_ACC_SWMR_READ);
+}
+
+/**
+ * @brief Write a state file step by step, so that completed steps can be read before the analysis is finished.
+ *
+ * The file is created with the latest HDF5 format, which is required for single-writer/multiple-reader (SWMR) access.
+ * Each step is marked as complete with `complete()`, which flushes all of its contents to disk before setting its marker.
+ * Readers that open the file with `open()` can then use `is_complete()` to decide which steps are safe to read,
+ * e.g., with `validate()` in completed-only mode.
+ *
+ * Other processes cannot open the file at all until `start_swmr()` is called, as HDF5 locks the file for the writer until then.
+ * However, HDF5 does not allow objects to be created once SWMR writing has started.
+ * Callers should therefore create all groups and datasets first - per-cell results can be created with their final dimensions,
+ * or as extendible datasets with `streaming::RowWriter::append()` - and call `declare()` for each step so that its marker exists.
+ * Once `start_swmr()` has been called, the contents of each step can be filled and marked with `complete()`.
+ * Steps that are completed before `start_swmr()` only become visible to readers after it is called.
+ */
+class Writer {
+public:
+    /**
+     * @param path Path to the output state file.
+     * This is overwritten if it already exists.
+     */
+    Writer(const std::string& path) : handle(path, H5F_ACC_TRUNC, H5::FileCreatPropList::DEFAULT, access_plist()) {}
+
+private:
+    static H5::FileAccPropList access_plist() {
+        H5::FileAccPropList fapl;
+        fapl.setLibverBounds(H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+        return fapl;
+    }
+
+public:
+    /**
+     * @return Handle to the file.
+     */
+    const H5::H5File& file() const {
+        return handle;
+    }
+
+    /**
+     * Create the group for an analysis step, along with its marker in the incomplete state.
+     * If the group already exists, it is returned without modification.
+     *
+     * @param step Name of the analysis step.
+     *
+     * @return Handle to the step group.
+     */
+    H5::Group declare(const std::string& step) {
+        if (handle.exists(step)) {
+            return handle.openGroup(step);
+        }
+        if (swmr) {
+            throw std::runtime_error("cannot create '" + step + "' after SWMR writing has started");
+        }
+
+        auto shandle = handle.createGroup(step);
+        int val = 0;
+        auto dhandle = shandle.createDataSet(marker_name(), H5::PredType::NATIVE_INT8, H5S_SCALAR);
+        dhandle.write(&val, H5::PredType::NATIVE_INT);
+        return shandle;
+    }
+
+    /**
+     * Switch to SWMR mode.
+     * After this call, existing datasets can be written and extended but no new objects can be created.
+     */
+    void start_swmr() {
+        handle.flush(H5F_SCOPE_GLOBAL);
+        if (H5Fstart_swmr_write(handle.getId()) < 0) {
+            throw std::runtime_error("failed to start SWMR writing");
+        }
+        swmr = true;
+    }
+
+    /**
+     * Mark an analysis step as complete.
+     * All contents of the file are flushed to disk before and after the marker is set,
+     * so that readers never see a marked step with partially written contents.
+     *
+     * @param step Name of the analysis step.
+     * This should have been created with `declare()`.
+     */
+    void complete(const std::string& step) {
+        auto shandle = declare(step);
+        handle.flush(H5F_SCOPE_GLOBAL);
+
+        int val = 1;
+        auto dhandle = shandle.openDataSet(marker_name());
+        dhandle.write(&val, H5::PredType::NATIVE_INT);
+        handle.flush(H5F_SCOPE_GLOBAL);
+    }
+
+private:
+    H5::H5File handle;
+    bool swmr = false;
+};
+
+}
+
+}
+
+#endif
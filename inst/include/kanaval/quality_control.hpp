@@ -3,8 +3,11 @@
 
 #include "H5Cpp.h"
 #include <vector>
+#include <limits>
+#include <algorithm>
 #include "utils.hpp"
 #include "misc.hpp"
+#include "streaming.hpp"
 
 /**
  * @file quality_control.hpp
@@ -30,15 +33,60 @@ inline void validate_parameters(const H5::Group& qhandle) {
     return;
 }
 
-inline int validate_results(const H5::Group& qhandle, int num_cells, int num_samples) {
+/*
+ * All metrics are checked in a single pass over blocks of cells. The inner
+ * loop is branch-free so that the compiler can vectorize it; we only need
+ * to know whether any value is out of range, not which one.
+ */
+inline void check_metric_values(const H5::DataSet& shandle, const H5::DataSet& dhandle, const H5::DataSet& phandle, hsize_t num_cells, int num_features, hsize_t block_size = 65536) {
+    block_size = std::max<hsize_t>(1, std::min(block_size, num_cells));
+    std::vector<double> sums(block_size), proportions(block_size);
+    std::vector<int> detected(block_size);
+    instrumentation::Allocation tracked(block_size * (2 * sizeof(double) + sizeof(int)));
+
+    const double max_sum = std::numeric_limits<double>::max();
+    const int max_detected = (num_features < 0 ? std::numeric_limits<int>::max() : num_features);
+
+    for (hsize_t start = 0; start < num_cells; start += block_size) {
+        hsize_t len = std::min(block_size, num_cells - start);
+        streaming::read_block(shandle, start, len, 0, sums.data());
+        streaming::read_block(dhandle, start, len, 0, detected.data());
+        streaming::read_block(phandle, start, len, 0, proportions.data());
+
+        int bad_sums = 0, bad_detected = 0, bad_proportions = 0;
+        const double* sptr = sums.data();
+        const int* dptr = detected.data();
+        const double* pptr = proportions.data();
+        for (hsize_t i = 0; i < len; ++i) {
+            double s = sptr[i], p = pptr[i];
+            int d = dptr[i];
+            bad_sums |= !((s >= 0) & (s <= max_sum)); // also catches NaNs.
+            bad_detected |= !((d >= 0) & (d <= max_detected));
+            bad_proportions |= !(((p >= 0) & (p <= 100)) | ((p != p) & (s == 0))); // NaN proportions are allowed for empty cells.
+        }
+
+        if (bad_sums) {
+            throw std::runtime_error("'sums' should contain non-negative and finite values");
+        }
+        if (bad_detected) {
+            throw std::runtime_error("'detected' should contain values between zero and the number of features");
+        }
+        if (bad_proportions) {
+            throw std::runtime_error("'proportion' should contain values between 0 and 100");
+        }
+    }
+}
+
+inline int validate_results(const H5::Group& qhandle, int num_cells, int num_samples, int num_features) {
     auto rhandle = utils::check_and_open_group(qhandle, "results");
 
     try {
         auto mhandle = utils::check_and_open_group(rhandle, "metrics");
         std::vector<size_t> dims{ static_cast<size_t>(num_cells) };
-        utils::check_and_open_dataset(mhandle, "sums", H5T_FLOAT, dims);
-        utils::check_and_open_dataset(mhandle, "detected", H5T_INTEGER, dims);
-        utils::check_and_open_dataset(mhandle, "proportion", H5T_FLOAT, dims);
+        auto shandle = utils::check_and_open_dataset(mhandle, "sums", H5T_FLOAT, dims);
+        auto dhandle = utils::check_and_open_dataset(mhandle, "detected", H5T_INTEGER, dims);
+        auto phandle = utils::check_and_open_dataset(mhandle, "proportion", H5T_FLOAT, dims);
+        check_metric_values(shandle, dhandle, phandle, num_cells, num_features);
     } catch (std::exception& e) {
         throw utils::combine_errors(e, "failed to retrieve metrics from 'results'");
     }
@@ -82,8 +130,11 @@ inline int validate_results(const H5::Group& qhandle, int num_cells, int num_sam
  * - `metrics`, a group containing per-cell QC metrics derived from the RNA count data.
  *   This contains:
  *   - `sums`: a float dataset of length equal to the number of cells, containing the total count for each cell.
+ *     Values should be non-negative and finite.
  *   - `detected`:  an integer dataset of length equal to the number of cells, containing the total number of detected genes for each cell.
+ *     Values should lie in `[0, num_features]`.
  *   - `proportion`: a float dataset of length equal to the number of cells, containing the percentage of counts in (mitochondrial) genes.
+ *     Values should lie in `[0, 100]`, or be NaN for cells where `sums` is zero.
  * - `thresholds`, a group containing thresholds on the metrics for each batch.
  *   This contains:
  *   - `sums`: a float dataset of length equal to the number of batches, containing the total count threshold for each batch.
@@ -96,11 +147,13 @@ inline int validate_results(const H5::Group& qhandle, int num_cells, int num_sam
  * @param handle An open HDF5 file handle.
  * @param num_cells Number of cells in the dataset before any quality filtering is applied.
  * @param num_samples Number of batches in the dataset.
+ * @param num_features Number of features in the RNA count matrix.
+ * If negative, `detected` is only checked for non-negative values.
  * 
  * @return The number of high-quality cells, according to the RNA-based metrics.
  * If the format is invalid, an error is raised instead.
  */ 
-inline int validate(const H5::H5File& handle, int num_cells, int num_samples) {
+inline int validate(const H5::H5File& handle, int num_cells, int num_samples, int num_features = -1) {
     auto qhandle = utils::check_and_open_group(handle, "quality_control");
 
     try {
@@ -111,7 +164,7 @@ inline int validate(const H5::H5File& handle, int num_cells, int num_samples) {
 
     int remaining = 0;
     try {
-        remaining = validate_results(qhandle, num_cells, num_samples);
+        remaining = validate_results(qhandle, num_cells, num_samples, num_features);
     } catch (std::exception& e) {
         throw utils::combine_errors(e, "failed to retrieve results from 'quality_control'");
     }
@@ -0,0 +1,260 @@
+#ifndef KANAVAL_READER_HPP
+#define KANAVAL_READER_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include "utils.hpp"
+#include "streaming.hpp"
+#include "embeddings.hpp"
+#include "mapping.hpp"
+
+/**
+ * @file reader.hpp
+ *
+ * @brief Read the results of selected analysis steps into caller-allocated memory.
+ */
+
+namespace kanaval {
+
+namespace reader {
+
+/**
+ * @brief Kind of object in the results of an analysis step.
+ */
+enum class Kind { GROUP, INTEGER, FLOAT, STRING };
+
+/**
+ * @brief Description of a group or dataset in the results of an analysis step.
+ *
+ * This is used by callers to allocate the destination of each dataset before calling `read()`,
+ * e.g., so that values can be written directly into the memory of a R vector.
+ */
+struct Node {
+    /**
+     * Name of the object in its parent group.
+     */
+    std::string name;
+
+    /**
+     * Kind of the object.
+     */
+    Kind kind = Kind::GROUP;
+
+    /**
+     * Dimensions of the dataset, empty for scalars and groups.
+     */
+    std::vector<hsize_t> dims;
+
+    /**
+     * Whether the dataset can be accessed without copying via `mapping::map()`,
+     * using `int` for `Kind::INTEGER` and `double` for `Kind::FLOAT`.
+     * Always false for groups and strings.
+     */
+    bool mappable = false;
+
+    /**
+     * Children of the group, empty for datasets.
+     * Children are sorted by name, or by number if all names are non-negative integers (e.g., cluster indices).
+     */
+    std::vector<Node> children;
+
+    /**
+     * @return Number of values in the dataset.
+     */
+    hsize_t size() const {
+        hsize_t len = 1;
+        for (auto d : dims) {
+            len *= d;
+        }
+        return len;
+    }
+};
+
+/**
+ * @cond
+ */
+inline bool is_number(const std::string& name) {
+    return !name.empty() && std::all_of(name.begin(), name.end(), [](char c) -> bool { return c >= '0' && c <= '9'; });
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Describe a group and all of its contents, without reading any values.
+ *
+ * @param handle Handle to the parent group.
+ * @param name Name of the group to describe.
+ *
+ * @return Description of the group.
+ */
+inline Node scan(const H5::Group& handle, const std::string& name) {
+    Node output;
+    output.name = name;
+    auto ghandle = utils::check_and_open_group(handle, name);
+
+    size_t nchildren = ghandle.getNumObjs();
+    output.children.reserve(nchildren);
+    for (size_t i = 0; i < nchildren; ++i) {
+        auto child = ghandle.getObjnameByIdx(i);
+        auto type = ghandle.childObjType(child);
+
+        if (type == H5O_TYPE_GROUP) {
+            output.children.push_back(scan(ghandle, child));
+
+        } else if (type == H5O_TYPE_DATASET) {
+            Node current;
+            current.name = child;
+            auto dhandle = ghandle.openDataSet(child);
+            auto cls = dhandle.getTypeClass();
+            if (cls == H5T_INTEGER) {
+                current.kind = Kind::INTEGER;
+                current.mappable = mapping::can_map<int>(dhandle);
+            } else if (cls == H5T_FLOAT) {
+                current.kind = Kind::FLOAT;
+                current.mappable = mapping::can_map<double>(dhandle);
+            } else if (cls == H5T_STRING) {
+                current.kind = Kind::STRING;
+            } else {
+                throw std::runtime_error("unsupported datatype for '" + child + "' in '" + name + "'");
+            }
+
+            current.dims = utils::get_dimensions(dhandle);
+            if (current.dims.size() > 2 || (current.kind == Kind::STRING && current.dims.size() > 1)) {
+                throw std::runtime_error("unsupported dimensionality for '" + child + "' in '" + name + "'");
+            }
+            output.children.push_back(std::move(current));
+        }
+    }
+
+    auto& children = output.children;
+    if (std::all_of(children.begin(), children.end(), [](const Node& n) -> bool { return is_number(n.name); })) {
+        std::sort(children.begin(), children.end(), [](const Node& left, const Node& right) -> bool {
+            return std::stoll(left.name) < std::stoll(right.name);
+        });
+    } else {
+        std::sort(children.begin(), children.end(), [](const Node& left, const Node& right) -> bool {
+            return left.name < right.name;
+        });
+    }
+
+    return output;
+}
+
+/**
+ * @param handle Open handle to a HDF5 state file.
+ * @return Names of all analysis steps with a `results` group, sorted alphabetically.
+ */
+inline std::vector<std::string> available_steps(const H5::Group& handle) {
+    std::vector<std::string> output;
+    size_t nsteps = handle.getNumObjs();
+    for (size_t i = 0; i < nsteps; ++i) {
+        auto step = handle.getObjnameByIdx(i);
+        if (handle.childObjType(step) != H5O_TYPE_GROUP) {
+            continue;
+        }
+        auto shandle = handle.openGroup(step);
+        if (shandle.exists("results") && shandle.childObjType("results") == H5O_TYPE_GROUP) {
+            output.push_back(step);
+        }
+    }
+    std::sort(output.begin(), output.end());
+    return output;
+}
+
+/**
+ * Read a numeric dataset into a user-supplied array.
+ * Scalars and 1-dimensional datasets are read in a single call.
+ * 2-dimensional datasets are returned in column-major layout (i.e., the first dimension is the fastest-changing),
+ * using `embeddings::read()` to overlap the transposition of each block with the read of the next.
+ *
+ * @tparam T Type of the values in memory.
+ *
+ * @param dhandle Handle to a numeric dataset.
+ * @param[out] output Pointer to an array of length equal to the product of the dataset dimensions.
+ * @param num_threads Number of threads to use for transposition.
+ */
+template<typename T>
+void read(const H5::DataSet& dhandle, T* output, int num_threads = 1) {
+    auto dims = utils::get_dimensions(dhandle);
+    if (dims.size() <= 1) {
+        if (dims.empty() || dims[0]) {
+            dhandle.read(output, streaming::native_type<T>());
+        }
+    } else if (dims.size() == 2) {
+        embeddings::ReadOptions opt;
+        opt.layout = embeddings::Layout::DIMENSION_MAJOR;
+        opt.num_threads = num_threads;
+        embeddings::read(dhandle, output, opt);
+    } else {
+        throw std::runtime_error("expected a dataset with no more than 2 dimensions");
+    }
+}
+
+/**
+ * Read a numeric dataset described by `scan()` into a user-supplied array.
+ * If `Node::mappable` is true, values are copied from a memory-mapped view of the file created by `mapping::map()`, bypassing the HDF5 library;
+ * otherwise, this is equivalent to the other `read()` overload.
+ * In both cases, 2-dimensional datasets are returned in column-major layout.
+ *
+ * @tparam T Type of the values in memory.
+ * This should be `int` for `Kind::INTEGER` and `double` for `Kind::FLOAT`, consistent with `Node::mappable`.
+ *
+ * @param dhandle Handle to a numeric dataset.
+ * @param node Description of the dataset from `scan()`.
+ * @param[out] output Pointer to an array of length equal to `node.size()`.
+ * @param num_threads Number of threads to use for transposition.
+ */
+template<typename T>
+void read(const H5::DataSet& dhandle, const Node& node, T* output, int num_threads = 1) {
+    if (!node.mappable) {
+        read(dhandle, output, num_threads);
+        return;
+    }
+
+    auto view = mapping::map<T>(dhandle);
+    const T* ptr = view.data();
+    if (node.dims.size() <= 1) {
+        std::copy(ptr, ptr + view.size(), output);
+        return;
+    }
+
+    // Each thread transposes a contiguous range of rows into the corresponding columns of the output.
+    size_t nrows = node.dims[0], ncols = node.dims[1];
+    size_t nthreads = std::max<size_t>(1, std::min<size_t>(num_threads, nrows));
+    size_t per_thread = (nrows + nthreads - 1) / nthreads;
+    auto transpose_rows = [&](size_t start, size_t len) -> void {
+        streaming::transpose(ptr + start * ncols, len, ncols, output + start, nrows, 32);
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(nthreads - 1);
+    for (size_t start = per_thread; start < nrows; start += per_thread) {
+        workers.emplace_back(transpose_rows, start, std::min(per_thread, nrows - start));
+    }
+    transpose_rows(0, std::min(per_thread, nrows));
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+/**
+ * @param dhandle Handle to a scalar or 1-dimensional string dataset.
+ * @return Contents of the dataset.
+ */
+inline std::vector<std::string> read_strings(const H5::DataSet& dhandle) {
+    if (dhandle.getSpace().getSimpleExtentNdims() == 0) {
+        return std::vector<std::string>{ utils::load_string(dhandle) };
+    } else {
+        return utils::load_string_vector(dhandle);
+    }
+}
+
+}
+
+}
+
+#endif
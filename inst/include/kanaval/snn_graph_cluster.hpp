@@ -3,12 +3,18 @@
 
 #include "H5Cpp.h"
 #include <vector>
+#include <string>
+#include <algorithm>
 #include "utils.hpp"
+#include "write_utils.hpp"
+#include "inspect.hpp"
+#include "embeddings.hpp"
+#include "neighbors.hpp"
 
 /**
  * @file snn_graph_cluster.hpp
  *
- * @brief Validate SNN graph clustering contents.
+ * @brief Validate SNN graph clustering contents, and verify the clusters against the recorded parameters.
  */
 
 namespace kanaval {
@@ -39,7 +45,7 @@ inline void validate_parameters(const H5::Group& handle) {
     return;
 }
 
-inline int validate_results(const H5::Group& handle, int num_cells, bool in_use) {
+inline int validate_results(const H5::Group& handle, int num_cells, bool in_use, std::vector<int>* cluster_sizes) {
     auto phandle = utils::check_and_open_group(handle, "results");
 
     int nclusters = 0;
@@ -47,6 +53,7 @@ inline int validate_results(const H5::Group& handle, int num_cells, bool in_use)
         std::vector<size_t> dim { static_cast<size_t>(num_cells) };
         auto clushandle = utils::check_and_open_dataset(phandle, "clusters", H5T_INTEGER, dim);
         std::vector<int> clusters(num_cells);
+        instrumentation::Allocation tracked(clusters.size() * sizeof(int));
         clushandle.read(clusters.data(), H5::PredType::NATIVE_INT);
 
         if (num_cells) {
@@ -59,6 +66,7 @@ inline int validate_results(const H5::Group& handle, int num_cells, bool in_use)
             nclusters = maxed + 1;
 
             std::vector<int> counts(nclusters);
+            instrumentation::Allocation tracked_counts(counts.size() * sizeof(int));
             for (auto c : clusters) {
                 ++counts[c];
             }
@@ -67,6 +75,10 @@ inline int validate_results(const H5::Group& handle, int num_cells, bool in_use)
                     throw std::runtime_error("each cluster must be represented at least once in 'clusters'");
                 }
             }
+
+            if (cluster_sizes) {
+                *cluster_sizes = std::move(counts);
+            }
         }
     }
 
@@ -103,11 +115,13 @@ inline int validate_results(const H5::Group& handle, int num_cells, bool in_use)
  * @param handle An open HDF5 file handle.
  * @param num_cells Number of cells in the dataset after any quality filtering is applied.
  * @param in_use Was SNN clustering used by downstream steps?
+ * @param[out] cluster_sizes Pointer to a vector in which to store the number of cells in each cluster.
+ * This is only filled if `clusters` is present, and is ignored if `NULL`.
  *
  * @return The total number of clusters.
  * If the format is invalid, an error is raised.
  */
-inline int validate(const H5::H5File& handle, int num_cells, bool in_use = true) {
+inline int validate(const H5::H5File& handle, int num_cells, bool in_use = true, std::vector<int>* cluster_sizes = NULL) {
     auto nhandle = utils::check_and_open_group(handle, "snn_graph_cluster");
 
     try {
@@ -118,7 +132,7 @@ inline int validate(const H5::H5File& handle, int num_cells, bool in_use = true)
 
     int nclusters;
     try {
-        nclusters = validate_results(nhandle, num_cells, in_use);
+        nclusters = validate_results(nhandle, num_cells, in_use, cluster_sizes);
     } catch (std::exception& e) {
         throw utils::combine_errors(e, "failed to retrieve results from 'snn_graph_cluster'");
     }
@@ -126,6 +140,328 @@ inline int validate(const H5::H5File& handle, int num_cells, bool in_use = true)
     return nclusters;
 }
 
+/**
+ * @brief Options for `verify()`.
+ */
+struct VerifyOptions {
+    /**
+     * Options for the neighbor search.
+     * An exact search reproduces the original graph most faithfully, at the cost of speed.
+     */
+    neighbors::Options search;
+
+    /**
+     * Maximum increase in modularity from merging any pair of clusters, above which the clusters are flagged as inconsistent.
+     * A small positive tolerance accounts for differences between the rebuilt graph and the original, e.g., due to ties or an approximate neighbor search.
+     */
+    double tolerance = 1e-3;
+};
+
+/**
+ * @brief Result of `verify()`.
+ */
+struct Verification {
+    /**
+     * Modularity of the stored clusters in the rebuilt graph, at the recorded resolution.
+     */
+    double modularity = 0;
+
+    /**
+     * Largest increase in modularity from merging any pair of clusters.
+     * This is negative if all merges decrease the modularity.
+     */
+    double best_merge_gain = 0;
+
+    /**
+     * Clusters involved in the merge with the largest increase in modularity.
+     * These are set to -1 if there are fewer than two clusters.
+     */
+    int merge_first = -1;
+
+    /**
+     * See `merge_first`.
+     */
+    int merge_second = -1;
+
+    /**
+     * Whether the clusters are consistent with the recorded parameters, i.e., `best_merge_gain` is no greater than the tolerance.
+     */
+    bool consistent = true;
+
+    /**
+     * Whether verification was skipped because the recorded parameters are unknown, see `utils::mark_unknown()`.
+     * If true, all other fields are left at their defaults.
+     */
+    bool skipped = false;
+};
+
+/**
+ * @cond
+ */
+enum class Scheme { RANK, NUMBER, JACCARD };
+
+inline Scheme to_scheme(const std::string& scheme) {
+    if (scheme == "rank") {
+        return Scheme::RANK;
+    } else if (scheme == "number") {
+        return Scheme::NUMBER;
+    } else if (scheme == "jaccard") {
+        return Scheme::JACCARD;
+    }
+    throw std::runtime_error("'scheme' must be one of 'rank', 'jaccard' or 'number'");
+}
+
+// Total edge weights within and between clusters (in a dense row-major matrix), plus the total degree of each cluster.
+struct ClusterWeights {
+    ClusterWeights(int num_clusters) : num_clusters(num_clusters), between(static_cast<size_t>(num_clusters) * num_clusters), degrees(num_clusters) {}
+
+    void add(int first, int second, double weight) {
+        between[static_cast<size_t>(first) * num_clusters + second] += weight;
+        if (first != second) {
+            between[static_cast<size_t>(second) * num_clusters + first] += weight;
+        }
+        degrees[first] += weight;
+        degrees[second] += weight;
+        total += weight;
+    }
+
+    void merge(const ClusterWeights& other) {
+        for (size_t i = 0; i < between.size(); ++i) {
+            between[i] += other.between[i];
+        }
+        for (int c = 0; c < num_clusters; ++c) {
+            degrees[c] += other.degrees[c];
+        }
+        total += other.total;
+    }
+
+    int num_clusters;
+    std::vector<double> between;
+    std::vector<double> degrees;
+    double total = 0;
+};
+
+/*
+ * Each cell is considered to be its own nearest neighbor with rank 0, and
+ * two cells are connected if they share any neighbors, following the usual
+ * definition of the SNN graph in scran. Edges are never stored; the weight of
+ * each edge is added to the cluster totals as soon as it is computed.
+ */
+inline ClusterWeights accumulate_graph(const neighbors::Neighbors& found, Scheme scheme, const int* clusters, int num_clusters, int num_threads) {
+    size_t n = found.size();
+    int k = found.num_neighbors;
+
+    // For each cell, the cells that have it as a neighbor, along with its rank in their neighbor lists.
+    std::vector<size_t> offsets(n + 1);
+    for (size_t i = 0; i < n; ++i) {
+        ++offsets[i + 1];
+        for (int x = 0; x < k; ++x) {
+            ++offsets[found.indices[i * k + x] + 1];
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    std::vector<int> hosts(offsets[n]), ranks(offsets[n]);
+    {
+        std::vector<size_t> position(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < n; ++i) {
+            hosts[position[i]] = i;
+            ranks[position[i]] = 0;
+            ++position[i];
+            for (int x = 0; x < k; ++x) {
+                auto& pos = position[found.indices[i * k + x]];
+                hosts[pos] = i;
+                ranks[pos] = x + 1;
+                ++pos;
+            }
+        }
+    }
+
+    size_t nthreads = std::max(1, num_threads);
+    std::vector<ClusterWeights> partial(nthreads, ClusterWeights(num_clusters));
+    neighbors::parallelize(n, num_threads, [&](size_t t, size_t start, size_t len) -> void {
+        auto& current = partial[t];
+        std::vector<double> scores(n);
+        std::vector<char> added(n);
+        std::vector<int> touched;
+
+        for (size_t j = start, end = start + len; j < end; ++j) {
+            for (int x = 0; x <= k; ++x) {
+                int neighbor = (x == 0 ? j : found.indices[j * k + x - 1]);
+                for (size_t h = offsets[neighbor], hend = offsets[neighbor + 1]; h < hend; ++h) {
+                    int other = hosts[h];
+                    if (static_cast<size_t>(other) >= j) {
+                        continue;
+                    }
+
+                    if (scheme == Scheme::RANK) {
+                        double rank = ranks[h] + x;
+                        if (!added[other]) {
+                            scores[other] = rank;
+                        } else if (rank < scores[other]) {
+                            scores[other] = rank;
+                        }
+                    } else {
+                        ++scores[other];
+                    }
+
+                    if (!added[other]) {
+                        added[other] = 1;
+                        touched.push_back(other);
+                    }
+                }
+            }
+
+            for (auto other : touched) {
+                double weight;
+                if (scheme == Scheme::RANK) {
+                    weight = k - 0.5 * scores[other];
+                } else if (scheme == Scheme::JACCARD) {
+                    weight = scores[other] / (2 * (k + 1) - scores[other]);
+                } else {
+                    weight = scores[other];
+                }
+                current.add(clusters[j], clusters[other], std::max(weight, 1e-6));
+                scores[other] = 0;
+                added[other] = 0;
+            }
+            touched.clear();
+        }
+    });
+
+    for (size_t t = 1; t < nthreads; ++t) {
+        partial[0].merge(partial[t]);
+    }
+    return std::move(partial[0]);
+}
+
+inline H5::DataSet open_clustered_embedding(const H5::H5File& handle, int version) {
+    // Pre-v2.0 files store the batch-corrected embeddings in the 'pca' step.
+    std::string corrected_step = (version >= 2000000 ? "batch_correction" : "pca");
+    if (inspect::has_group(handle, corrected_step) && inspect::has_dataset(handle.openGroup(corrected_step + "/results"), "corrected")) {
+        return embeddings::open(handle, "corrected", version);
+    }
+    return embeddings::open_uncorrected(handle, version);
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Verify that SNN graph clusters are consistent with an SNN graph built from an embedding.
+ *
+ * The modularity is computed from the total edge weight within each cluster and the total degree of each cluster, at the specified resolution.
+ * The multi-level community detection algorithm terminates when no cluster can be moved into another cluster to increase the modularity,
+ * so merging any pair of its final clusters should not increase the modularity.
+ * Clusters that violate this condition (beyond the tolerance in `options`) were probably not generated from this graph, e.g., due to mismatched parameters or modified assignments.
+ *
+ * @param data Pointer to a row-major array with one row per cell and `ndim` columns, containing the embedding used for clustering.
+ * @param n Number of cells.
+ * @param ndim Number of dimensions.
+ * @param k Number of nearest neighbors used to build the graph.
+ * @param scheme Edge weighting scheme, one of `"rank"`, `"number"` or `"jaccard"`.
+ * @param resolution Resolution of the community detection.
+ * @param clusters Pointer to an array of length `n`, containing the cluster assignment of each cell as integers in `[0, num_clusters)`.
+ * @param num_clusters Number of clusters.
+ * @param options Further options.
+ *
+ * @return The modularity of the clusters and the best merge.
+ */
+inline Verification verify(const double* data, size_t n, size_t ndim, int k, const std::string& scheme, double resolution, const int* clusters, int num_clusters, const VerifyOptions& options = VerifyOptions()) {
+    auto wscheme = to_scheme(scheme);
+    for (size_t i = 0; i < n; ++i) {
+        if (clusters[i] < 0 || clusters[i] >= num_clusters) {
+            throw std::runtime_error("cluster assignments should be non-negative and less than the number of clusters");
+        }
+    }
+
+    auto found = neighbors::find(data, n, ndim, k, options.search);
+    auto weights = accumulate_graph(found, wscheme, clusters, num_clusters, options.search.num_threads);
+
+    Verification output;
+    if (weights.total == 0) {
+        return output;
+    }
+
+    double m = weights.total;
+    double scaling = resolution / (2 * m * m);
+    for (int c = 0; c < num_clusters; ++c) {
+        double within = weights.between[static_cast<size_t>(c) * num_clusters + c];
+        output.modularity += within / m - scaling * weights.degrees[c] * weights.degrees[c] / 2;
+    }
+
+    // Merging 'a' and 'b' adds twice the edges between them and removes twice the expected edges.
+    for (int a = 0; a < num_clusters; ++a) {
+        for (int b = a + 1; b < num_clusters; ++b) {
+            double gain = weights.between[static_cast<size_t>(a) * num_clusters + b] / m - scaling * weights.degrees[a] * weights.degrees[b];
+            if (output.merge_first < 0 || gain > output.best_merge_gain) {
+                output.best_merge_gain = gain;
+                output.merge_first = a;
+                output.merge_second = b;
+            }
+        }
+    }
+
+    output.consistent = (output.merge_first < 0 || output.best_merge_gain <= options.tolerance);
+    return output;
+}
+
+/**
+ * Verify the SNN graph clusters in a state file against the recorded `k`, `scheme` and `resolution`, see `verify()` for details.
+ * The graph is rebuilt from the embedding that was used for clustering,
+ * i.e., the batch-corrected embedding if available (from `batch_correction`, or from `pca` for pre-v2.0 files), otherwise the combined embeddings, otherwise the PCs from `pca` or `adt_pca`.
+ * The neighbor search is exact or approximate according to `neighbor_index/parameters/approximate`, if present, overriding the setting in `options`.
+ * If the parameters are marked as unknown (e.g., in state files created by `h5ad::import_state()`), no verification is performed.
+ * This should only be called after `validate()` has been run on the file.
+ *
+ * @param handle An open HDF5 file handle.
+ * @param version Version of the state file.
+ * @param options Further options.
+ *
+ * @return The modularity of the clusters and the best merge.
+ */
+inline Verification verify(const H5::H5File& handle, int version, const VerifyOptions& options = VerifyOptions()) {
+    auto nhandle = utils::check_and_open_group(handle, "snn_graph_cluster");
+    auto phandle = utils::check_and_open_group(nhandle, "parameters");
+    if (utils::is_unknown(phandle)) {
+        Verification output;
+        output.skipped = true;
+        return output;
+    }
+
+    int k = utils::load_integer_scalar<>(phandle, "k");
+    auto scheme = utils::load_string(phandle, "scheme");
+    double resolution = utils::load_float_scalar<>(phandle, "resolution");
+
+    auto clusters = utils::load_integer_vector(utils::check_and_open_group(nhandle, "results"), "clusters");
+    int num_clusters = (clusters.empty() ? 0 : *std::max_element(clusters.begin(), clusters.end()) + 1);
+
+    // Using the same type of search as the original analysis, so that the rebuilt graph is as close as possible to the original.
+    auto current = options;
+    if (inspect::has_group(handle, "neighbor_index")) {
+        auto ihandle = handle.openGroup("neighbor_index");
+        if (inspect::has_group(ihandle, "parameters") && inspect::has_dataset(ihandle.openGroup("parameters"), "approximate")) {
+            current.search.approximate = (utils::load_integer_scalar<>(ihandle.openGroup("parameters"), "approximate") != 0);
+        }
+    }
+
+    auto dhandle = open_clustered_embedding(handle, version);
+    auto dims = utils::get_dimensions(dhandle);
+    if (dims[0] != clusters.size()) {
+        throw std::runtime_error("number of rows in the clustered embedding should be equal to the length of 'clusters'");
+    }
+
+    if (mapping::can_map<double>(dhandle)) {
+        auto view = mapping::map<double>(dhandle);
+        return verify(view.data(), dims[0], dims[1], k, scheme, resolution, clusters.data(), num_clusters, current);
+    }
+
+    auto embedding = embeddings::read<double>(dhandle);
+    return verify(embedding.values.data(), dims[0], dims[1], k, scheme, resolution, clusters.data(), num_clusters, current);
+}
+
 }
 
 }
@@ -0,0 +1,361 @@
+#ifndef KANAVAL_STREAMING_HPP
+#define KANAVAL_STREAMING_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "utils.hpp"
+#include "mapping.hpp"
+
+/**
+ * @file streaming.hpp
+ *
+ * @brief Block-wise reading and writing of per-cell datasets.
+ */
+
+namespace kanaval {
+
+namespace streaming {
+
+/**
+ * @tparam T Type of the in-memory buffer.
+ * @return The native HDF5 datatype for `T`.
+ */
+template<typename T>
+const H5::PredType& native_type() {
+    if constexpr(std::is_same<T, double>::value) {
+        return H5::PredType::NATIVE_DOUBLE;
+    } else if constexpr(std::is_same<T, float>::value) {
+        return H5::PredType::NATIVE_FLOAT;
+    } else if constexpr(std::is_same<T, int>::value) {
+        return H5::PredType::NATIVE_INT;
+    } else if constexpr(std::is_same<T, int16_t>::value) {
+        return H5::PredType::NATIVE_INT16;
+    } else if constexpr(std::is_same<T, hsize_t>::value) {
+        return H5::PredType::NATIVE_HSIZE;
+    } else if constexpr(std::is_same<T, unsigned char>::value) {
+        return H5::PredType::NATIVE_UCHAR;
+    } else {
+        static_assert(!sizeof(T*), "this type is not yet supported");
+    }
+}
+
+/**
+ * Choose the number of rows in each block so that the block contains roughly `target` elements.
+ *
+ * @param ncols Number of columns in each row.
+ * @param target Target number of elements in each block.
+ *
+ * @return Number of rows in each block.
+ */
+inline hsize_t choose_block_size(hsize_t ncols, hsize_t target = 1048576) {
+    return std::max<hsize_t>(1, target / std::max<hsize_t>(1, ncols));
+}
+
+/**
+ * Read a block of consecutive rows from a 1- or 2-dimensional dataset.
+ *
+ * @tparam T Type of the in-memory buffer.
+ *
+ * @param dhandle Handle to a 1- or 2-dimensional dataset.
+ * @param start Index of the first row to read.
+ * @param len Number of rows to read.
+ * @param ncols Number of leading columns to read from a 2-dimensional dataset.
+ * This should be zero for 1-dimensional datasets.
+ * @param buffer Pointer to an array of length `len * ncols` (or `len`, for 1-dimensional datasets).
+ * On output, this is filled with the row-major values for rows `[start, start + len)`.
+ */
+template<typename T>
+void read_block(const H5::DataSet& dhandle, hsize_t start, hsize_t len, hsize_t ncols, T* buffer) {
+    if (len == 0) {
+        return;
+    }
+    hsize_t offset[2] = { start, 0 };
+    hsize_t count[2] = { len, ncols };
+    int ndims = (ncols ? 2 : 1);
+    auto dspace = dhandle.getSpace();
+    dspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+    H5::DataSpace mspace(ndims, count);
+    dhandle.read(buffer, native_type<T>(), mspace, dspace);
+}
+
+/**
+ * Iterate over blocks of consecutive rows in a 1- or 2-dimensional dataset.
+ * Only a single buffer is allocated and reused for all blocks, so memory usage is bounded by the block size.
+ * If the dataset is large enough and can be memory-mapped (see `mapping::can_map()`), no buffer is allocated and each block points directly into the mapping.
+ *
+ * @tparam T Type of the in-memory buffer.
+ * @tparam Function Function to apply to each block.
+ *
+ * @param dhandle Handle to a 1- or 2-dimensional dataset.
+ * For 2-dimensional datasets, each row corresponds to a cell and each column to a dimension, as described in `pca::validate()`.
+ * @param block_size Number of rows in each block.
+ * @param fun Function that accepts `(hsize_t start, hsize_t len, const T* buffer)`,
+ * where `buffer` contains the values for rows `[start, start + len)` in row-major order.
+ */
+template<typename T, class Function>
+void for_each_block(const H5::DataSet& dhandle, hsize_t block_size, Function fun) {
+    auto dims = utils::get_dimensions(dhandle);
+    if (dims.empty() || dims.size() > 2) {
+        throw std::runtime_error("expected a 1- or 2-dimensional dataset");
+    }
+
+    hsize_t nrows = dims[0];
+    hsize_t ncols = (dims.size() == 2 ? dims[1] : 1);
+    block_size = std::max<hsize_t>(1, block_size);
+
+    // Small datasets are cheaper to read than to map.
+    if (nrows * ncols * sizeof(T) >= 1048576 && mapping::can_map<T>(dhandle)) {
+        auto view = mapping::map<T>(dhandle);
+        for (hsize_t start = 0; start < nrows; start += block_size) {
+            hsize_t len = std::min(block_size, nrows - start);
+            fun(start, len, view.data() + start * ncols);
+        }
+        return;
+    }
+
+    std::vector<T> buffer(std::min(block_size, nrows) * ncols);
+    instrumentation::Allocation tracked(buffer.size() * sizeof(T));
+
+    for (hsize_t start = 0; start < nrows; start += block_size) {
+        hsize_t len = std::min(block_size, nrows - start);
+        read_block(dhandle, start, len, (dims.size() == 2 ? ncols : 0), buffer.data());
+        fun(start, len, static_cast<const T*>(buffer.data()));
+    }
+}
+
+/**
+ * Transpose a row-major matrix into a subset of the columns of a larger row-major matrix.
+ * The matrix is processed in square tiles so that both the reads from `input` and the writes to `output` stay in cache.
+ *
+ * @tparam T Type of the matrix values.
+ *
+ * @param input Pointer to a row-major array of `nrows * ncols` values.
+ * @param nrows Number of rows in `input`.
+ * @param ncols Number of columns in `input`.
+ * @param output Pointer to the first element of a row-major matrix with at least `ncols` rows and `stride` columns.
+ * On output, the first `nrows` columns of each of the first `ncols` rows are filled with the transposed values of `input`.
+ * @param stride Number of columns in the `output` matrix, i.e., the distance between consecutive rows.
+ * This should be no less than `nrows`.
+ * @param tile Width of each square tile.
+ */
+template<typename T>
+void transpose(const T* input, size_t nrows, size_t ncols, T* output, size_t stride, size_t tile) {
+    for (size_t r0 = 0; r0 < nrows; r0 += tile) {
+        size_t r1 = std::min(nrows, r0 + tile);
+        for (size_t c0 = 0; c0 < ncols; c0 += tile) {
+            size_t c1 = std::min(ncols, c0 + tile);
+            for (size_t r = r0; r < r1; ++r) {
+                const T* src = input + r * ncols;
+                for (size_t c = c0; c < c1; ++c) {
+                    output[c * stride + r] = src[c];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Transpose a row-major matrix using a cache-blocked kernel.
+ *
+ * @tparam T Type of the matrix values.
+ *
+ * @param input Pointer to a row-major array of `nrows * ncols` values.
+ * @param nrows Number of rows in `input`.
+ * @param ncols Number of columns in `input`.
+ * @param output Pointer to an array of length `nrows * ncols`.
+ * On output, this is filled with the transposed matrix, i.e., a row-major `ncols`-by-`nrows` matrix.
+ * @param tile Width of each square tile.
+ */
+template<typename T>
+void transpose(const T* input, size_t nrows, size_t ncols, T* output, size_t tile = 32) {
+    transpose(input, nrows, ncols, output, nrows, tile);
+}
+
+/**
+ * @brief Write a 1- or 2-dimensional dataset by appending blocks of rows.
+ *
+ * The dataset is chunked along the rows and optionally compressed,
+ * allowing callers to write per-cell results without holding the entire array in memory.
+ *
+ * If the number of rows is not known in advance, an extendible dataset can be created with `append()`.
+ * This grows with each call to `write()`, and `finalize()` should be called to check the final number of rows.
+ */
+class RowWriter {
+public:
+    /**
+     * @param handle Group in which to create the dataset.
+     * @param name Name of the dataset.
+     * @param type Datatype of the dataset in the file.
+     * @param nrows Number of rows.
+     * @param ncols Number of columns.
+     * If zero, a 1-dimensional dataset is created.
+     * @param compression Deflate compression level.
+     * If zero, no compression is performed.
+     * @param chunk_rows Number of rows in each chunk.
+     * If zero, this is chosen automatically.
+     */
+    RowWriter(const H5::Group& handle, const std::string& name, const H5::DataType& type, hsize_t nrows, hsize_t ncols = 0, int compression = 6, hsize_t chunk_rows = 0) :
+        num_rows(nrows), num_cols(ncols), mem_type(type)
+    {
+        hsize_t dims[2] = { nrows, ncols };
+        int ndims = (ncols ? 2 : 1);
+        H5::DataSpace dspace(ndims, dims);
+
+        H5::DSetCreatPropList plist;
+        if (nrows && (ncols || ndims == 1)) {
+            if (chunk_rows == 0) {
+                chunk_rows = choose_block_size(ncols, 65536);
+            }
+            hsize_t chunks[2] = { std::min(chunk_rows, nrows), ncols };
+            plist.setChunk(ndims, chunks);
+            if (compression) {
+                plist.setDeflate(compression);
+            }
+        }
+
+        dhandle = handle.createDataSet(name, type, dspace, plist);
+    }
+
+    /**
+     * Create an extendible dataset with no rows, to which blocks of rows can be appended without knowing the final number of rows.
+     * The dataset is always chunked, as required by HDF5 for unlimited dimensions.
+     *
+     * @param handle Group in which to create the dataset.
+     * @param name Name of the dataset.
+     * @param type Datatype of the dataset in the file.
+     * @param ncols Number of columns.
+     * If zero, a 1-dimensional dataset is created.
+     * @param compression Deflate compression level.
+     * If zero, no compression is performed.
+     * @param chunk_rows Number of rows in each chunk.
+     * If zero, this is chosen automatically.
+     *
+     * @return A writer for the extendible dataset.
+     */
+    static RowWriter append(const H5::Group& handle, const std::string& name, const H5::DataType& type, hsize_t ncols = 0, int compression = 6, hsize_t chunk_rows = 0) {
+        return RowWriter(Extendible(), handle, name, type, ncols, compression, chunk_rows);
+    }
+
+private:
+    struct Extendible {};
+
+    RowWriter(Extendible, const H5::Group& handle, const std::string& name, const H5::DataType& type, hsize_t ncols, int compression, hsize_t chunk_rows) :
+        num_rows(0), num_cols(ncols), mem_type(type), extendible(true)
+    {
+        hsize_t dims[2] = { 0, ncols };
+        hsize_t maxdims[2] = { H5S_UNLIMITED, ncols };
+        int ndims = (ncols ? 2 : 1);
+        H5::DataSpace dspace(ndims, dims, maxdims);
+
+        if (chunk_rows == 0) {
+            chunk_rows = choose_block_size(ncols, 65536);
+        }
+        hsize_t chunks[2] = { chunk_rows, std::max<hsize_t>(1, ncols) };
+        H5::DSetCreatPropList plist;
+        plist.setChunk(ndims, chunks);
+        if (compression) {
+            plist.setDeflate(compression);
+        }
+
+        dhandle = handle.createDataSet(name, type, dspace, plist);
+    }
+
+public:
+    /**
+     * Append a block of rows to the dataset.
+     *
+     * @tparam T Type of the in-memory buffer.
+     * @param ptr Pointer to an array of length `len * ncols` (or `len`, for 1-dimensional datasets), containing the row-major values for the next `len` rows.
+     * @param len Number of rows to write.
+     */
+    template<typename T>
+    void write(const T* ptr, hsize_t len) {
+        write_raw(ptr, native_type<T>(), len);
+    }
+
+    /**
+     * Append a block of strings to a 1-dimensional dataset of variable-length strings.
+     *
+     * @param values Vector of strings to append.
+     */
+    void write(const std::vector<std::string>& values) {
+        std::vector<const char*> ptrs;
+        ptrs.reserve(values.size());
+        for (const auto& v : values) {
+            ptrs.push_back(v.c_str());
+        }
+        write_raw(ptrs.data(), mem_type, values.size());
+    }
+
+    /**
+     * @return Number of rows that have been written so far.
+     */
+    hsize_t filled() const {
+        return position;
+    }
+
+    /**
+     * @return Handle to the dataset.
+     */
+    const H5::DataSet& dataset() const {
+        return dhandle;
+    }
+
+    /**
+     * Check that the dataset is complete, i.e., all rows have been written and the dataset has the expected number of rows.
+     * This should be called after the last block has been written, usually with the number of cells in the analysis.
+     * An error is raised if the number of rows is not as expected, e.g., if a block was lost or duplicated by the producer.
+     *
+     * @param expected Expected number of rows.
+     */
+    void finalize(hsize_t expected) const {
+        auto dims = utils::get_dimensions(dhandle);
+        std::string name = dhandle.getObjName();
+        if (dims.empty() || dims[0] != expected) {
+            throw std::runtime_error("expected '" + name + "' to have " + std::to_string(expected) + " rows");
+        }
+        if (num_cols && (dims.size() != 2 || dims[1] != num_cols)) {
+            throw std::runtime_error("expected '" + name + "' to have " + std::to_string(num_cols) + " columns");
+        }
+        if (position != expected) {
+            throw std::runtime_error("only " + std::to_string(position) + " of " + std::to_string(expected) + " rows were written to '" + name + "'");
+        }
+    }
+
+private:
+    void write_raw(const void* ptr, const H5::DataType& type, hsize_t len) {
+        if (len == 0) {
+            return;
+        }
+        if (extendible) {
+            num_rows = position + len;
+            hsize_t dims[2] = { num_rows, num_cols };
+            dhandle.extend(dims);
+        } else if (position + len > num_rows) {
+            throw std::runtime_error("attempting to write beyond the end of '" + dhandle.getObjName() + "'");
+        }
+
+        hsize_t offset[2] = { position, 0 };
+        hsize_t count[2] = { len, num_cols };
+        int ndims = (num_cols ? 2 : 1);
+        auto dspace = dhandle.getSpace();
+        dspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+        H5::DataSpace mspace(ndims, count);
+        dhandle.write(ptr, type, mspace, dspace);
+        position += len;
+    }
+
+    H5::DataSet dhandle;
+    hsize_t num_rows, num_cols;
+    H5::DataType mem_type;
+    hsize_t position = 0;
+    bool extendible = false;
+};
+
+}
+
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include "H5Cpp.h"
 #include <vector>
 #include "utils.hpp"
+#include "animation.hpp"
+#include "cluster_summaries.hpp"
 
 /**
  * @file tsne.hpp
@@ -18,7 +20,7 @@ namespace tsne {
 /**
  * @cond
  */
-inline void validate_parameters(const H5::Group& handle) {
+inline int validate_parameters(const H5::Group& handle) {
     auto phandle = utils::check_and_open_group(handle, "parameters");
 
     auto perp = utils::load_float_scalar<>(phandle, "perplexity");
@@ -32,16 +34,28 @@ inline void validate_parameters(const H5::Group& handle) {
     }
 
     utils::load_integer_scalar<>(phandle, "animate");
-    return; 
+    return iters;
 }
 
-inline void validate_results(const H5::Group& handle, int num_cells) {
+inline void validate_results(const H5::Group& handle, int num_cells, int iterations, const std::vector<int>* cluster_sizes) {
     auto rhandle = utils::check_and_open_group(handle, "results");
 
     std::vector<size_t> dims { static_cast<size_t>(num_cells) };
     utils::check_and_open_dataset(rhandle, "x", H5T_FLOAT, dims);
     utils::check_and_open_dataset(rhandle, "y", H5T_FLOAT, dims);
 
+    try {
+        animation::validate(rhandle, num_cells, iterations);
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to retrieve the animation");
+    }
+
+    try {
+        cluster_summaries::validate(rhandle, num_cells, cluster_sizes);
+    } catch (std::exception& e) {
+        throw utils::combine_errors(e, "failed to retrieve the cluster summaries");
+    }
+
     return;
 }
 /**
@@ -66,23 +80,29 @@ inline void validate_results(const H5::Group& handle, int num_cells) {
  * - `x`: a float dataset of length equal to the number of cells (after QC filtering), containing the x-coordinates for each cell.
  * - `y`: a float dataset of length equal to the number of cells (after QC filtering), containing the y-coordinates for each cell.
  *
+ * `results` may also contain an `animation` group with the intermediate frames of the embedding, see `animation::validate()` for details.
+ * It may also contain a `cluster_summaries` group with the centroid and range of the coordinates for each cluster, see `cluster_summaries::validate()` for details.
+ *
  * <HR>
  * @param handle An open HDF5 file handle.
  * @param num_cells Number of cells in the dataset after any quality filtering is applied.
+ * @param cluster_sizes Pointer to the number of cells in each cluster of the chosen clustering, used to check `cluster_summaries`.
+ * If `NULL`, the per-cluster counts are not checked.
  *
  * @return If the format is invalid, an error is raised.
  */
-inline void validate(const H5::H5File& handle, int num_cells) {
+inline void validate(const H5::H5File& handle, int num_cells, const std::vector<int>* cluster_sizes = NULL) {
     auto thandle = utils::check_and_open_group(handle, "tsne");
 
+    int iterations = 0;
     try {
-        validate_parameters(thandle);
+        iterations = validate_parameters(thandle);
     } catch (std::exception& e) {
         throw utils::combine_errors(e, "failed to retrieve parameters from 'tsne'");
     }
 
     try {
-        validate_results(thandle, num_cells);
+        validate_results(thandle, num_cells, iterations, cluster_sizes);
     } catch (std::exception& e) {
         throw utils::combine_errors(e, "failed to retrieve results from 'tsne'");
     }
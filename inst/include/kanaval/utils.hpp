@@ -3,6 +3,9 @@
 
 #include "H5Cpp.h"
 #include <vector>
+#include <string>
+#include <stdexcept>
+#include "instrumentation.hpp"
 
 namespace kanaval {
 
@@ -21,7 +24,9 @@ H5::DataSet check_and_open_dataset(const Object& handle, const std::string& name
     if (!handle.exists(name) || handle.childObjType(name) != H5O_TYPE_DATASET) {
         throw std::runtime_error("'" + name + "' dataset does not exist");
     }
-    return handle.openDataSet(name);
+    auto dhandle = handle.openDataSet(name);
+    instrumentation::record_dataset(dhandle);
+    return dhandle;
 }
 
 template<class Object>
@@ -64,6 +69,17 @@ H5::DataSet check_and_open_dataset(const Object& handle, const std::string& name
     return dhandle;
 }
 
+template<class Object>
+std::vector<hsize_t> get_dimensions(const Object& handle) {
+    auto dspace = handle.getSpace();
+    size_t ndims = dspace.getSimpleExtentNdims();
+    std::vector<hsize_t> observed(ndims);
+    if (ndims) {
+        dspace.getSimpleExtentDims(observed.data());
+    }
+    return observed;
+}
+
 template<class Object>
 H5::DataSet check_and_open_scalar(const Object& handle, const std::string& name, H5T_class_t expected_type) {
     auto dhandle = check_and_open_dataset(handle, name, expected_type);
@@ -133,6 +149,7 @@ std::vector<T> load_integer_vector(const Object& handle) {
     dspace.getSimpleExtentDims(observed.data());
     size_t len = observed.front();
     std::vector<T> output(len);
+    instrumentation::record_allocation(len * sizeof(T));
 
     if constexpr(std::is_same<T, hsize_t>::value) {
         handle.read(output.data(), H5::PredType::NATIVE_HSIZE);
@@ -173,26 +190,36 @@ std::vector<std::string> load_string_vector(const Object& handle) {
     output.reserve(len);
 
     auto dtype = handle.getStrType();
+    if (len == 0) {
+        return output;
+    }
+
+    size_t total = len * sizeof(std::string);
     if (dtype.isVariableStr()) {
         std::vector<char*> buffer(len);
+        instrumentation::Allocation tracked(len * sizeof(char*));
         handle.read(buffer.data(), dtype);
         for (size_t i = 0; i < len; ++i) {
             output.emplace_back(buffer[i]);
+            total += output.back().size();
         }
         H5Dvlen_reclaim(dtype.getId(), dspace.getId(), H5P_DEFAULT, buffer.data());
 
     } else {
         size_t size = dtype.getSize();
         std::vector<char> buffer(len * size);
+        instrumentation::Allocation tracked(buffer.size());
         handle.read(buffer.data(), dtype);
         auto start = buffer.data();
         for (size_t i = 0; i < len; ++i, start += size) {
             size_t j = 0;
             for (; j < size && start[j] != '\0'; ++j) {}
             output.emplace_back(start, start + j);
+            total += j;
         }
     }
 
+    instrumentation::record_allocation(total);
     return output;
 }
 
@@ -30,7 +30,12 @@
 #include "custom_selections.hpp"
 #include "cell_labelling.hpp"
 
+#include "instrumentation.hpp"
+#include "progress.hpp"
+
 #include <algorithm>
+#include <vector>
+#include <string>
 
 /**
  * @file validate.hpp
@@ -74,11 +79,38 @@ namespace kanaval {
  * @param handle Open handle to a HDF5 file.
  * @param embedded Whether the data files are embedded.
  * @param version Version of the kana file.
+ * @param registry Pointer to a registry of reference vocabularies for `cell_labelling::validate()`.
+ * If `NULL`, labels are not checked against the references.
+ * @param context Pointer to a context in which to record the time and memory used by each step.
+ * If `NULL`, no recording is performed.
+ * @param completed_only Whether to only validate the steps that have been marked as complete by a `progress::Writer`, e.g., for a state file that is still being written.
+ * A step is only validated if it has a marker (see `progress::is_complete()`) and all of the steps that it depends on were also validated;
+ * all other steps are skipped without error.
  *
- * @return An error is raised if an invalid structure is detected.
+ * @return Names of the steps that were validated, in the order in which they were checked.
+ * If `completed_only = false`, this contains all steps.
+ * An error is raised if an invalid structure is detected.
  */
-void validate(const H5::H5File& handle, bool embedded, int version) {
-    auto i_out = inputs::validate(handle, embedded, version);
+std::vector<std::string> validate(const H5::H5File& handle, bool embedded, int version, const cell_labelling::Registry* registry = NULL, instrumentation::Context* context = NULL, bool completed_only = false) {
+    std::vector<std::string> checked;
+
+    // Skipped steps return a default-constructed value, which is never used as all dependent steps are also skipped.
+    auto step = [&](const std::string& name, const std::vector<std::string>& depends, auto fun) -> decltype(fun()) {
+        if (completed_only) {
+            if (!progress::is_complete(handle, name)) {
+                return decltype(fun())();
+            }
+            for (const auto& d : depends) {
+                if (std::find(checked.begin(), checked.end(), d) == checked.end()) {
+                    return decltype(fun())();
+                }
+            }
+        }
+        checked.push_back(name);
+        return instrumentation::run_step(context, name, handle, fun);
+    };
+
+    auto i_out = step("inputs", {}, [&]() { return inputs::validate(handle, embedded, version); });
 
     size_t rna_idx = std::find(i_out.modalities.begin(), i_out.modalities.end(), std::string("RNA")) - i_out.modalities.begin();
     size_t adt_idx = std::find(i_out.modalities.begin(), i_out.modalities.end(), std::string("ADT")) - i_out.modalities.begin();
@@ -86,36 +118,47 @@ void validate(const H5::H5File& handle, bool embedded, int version) {
     bool adt_in_use = adt_idx != i_out.modalities.size();
 
     // Quality control.
-    auto rna_filtered = quality_control::validate(handle, i_out.num_cells, i_out.num_samples);
-    auto adt_filtered = adt_quality_control::validate(handle, i_out.num_cells, i_out.num_samples, adt_in_use, version);
-    auto filtered_cells = cell_filtering::validate(handle, i_out.num_cells, i_out.modalities.size(), version);
+    auto rna_filtered = step("quality_control", { "inputs" }, [&]() { return quality_control::validate(handle, i_out.num_cells, i_out.num_samples, rna_in_use ? i_out.num_features[rna_idx] : -1); });
+    auto adt_filtered = step("adt_quality_control", { "inputs" }, [&]() { return adt_quality_control::validate(handle, i_out.num_cells, i_out.num_samples, adt_in_use, version); });
+
+    std::vector<std::string> filtering_steps { "inputs", "quality_control", "adt_quality_control" };
+    auto filtered_cells = step("cell_filtering", filtering_steps, [&]() { return cell_filtering::validate(handle, i_out.num_cells, i_out.modalities.size(), version); });
     if (filtered_cells < 0) {
         filtered_cells = std::max(rna_filtered, adt_filtered);
     }
+    filtering_steps.push_back("cell_filtering");
 
     // Normalization.
-    normalization::validate(handle);
-    adt_normalization::validate(handle, filtered_cells, adt_in_use, version);
+    step("normalization", {}, [&]() -> void { normalization::validate(handle); });
+    step("adt_normalization", filtering_steps, [&]() -> void { adt_normalization::validate(handle, filtered_cells, adt_in_use, version); });
 
-    feature_selection::validate(handle, i_out.num_features[rna_idx]);
+    step("feature_selection", { "inputs" }, [&]() -> void { feature_selection::validate(handle, i_out.num_features[rna_idx]); });
 
     // Dimensionality reduction.
-    auto rna_pcs = pca::validate(handle, filtered_cells, version);
-    auto adt_pcs = adt_pca::validate(handle, filtered_cells, adt_in_use, version);
+    auto rna_pcs = step("pca", filtering_steps, [&]() { return pca::validate(handle, filtered_cells, version); });
+    auto adt_pcs = step("adt_pca", filtering_steps, [&]() { return adt_pca::validate(handle, filtered_cells, adt_in_use, version); });
+
+    std::vector<std::string> pca_steps = filtering_steps;
+    pca_steps.push_back("pca");
+    pca_steps.push_back("adt_pca");
 
     int total_pcs = (rna_in_use ? rna_pcs : 0) + (adt_in_use ? adt_pcs : 0);
-    kanaval::combine_embeddings::validate(handle, filtered_cells, i_out.modalities, total_pcs, version);
-    batch_correction::validate(handle, total_pcs, filtered_cells, i_out.num_samples, version);
+    step("combine_embeddings", pca_steps, [&]() -> void { kanaval::combine_embeddings::validate(handle, filtered_cells, i_out.modalities, total_pcs, version); });
+    step("batch_correction", pca_steps, [&]() -> void { batch_correction::validate(handle, total_pcs, filtered_cells, i_out.num_samples, version); });
 
-    neighbor_index::validate(handle);
+    step("neighbor_index", {}, [&]() -> void { neighbor_index::validate(handle); });
 
     // Clustering.
-    auto cluster_method = choose_clustering::validate(handle);
+    auto cluster_method = step("choose_clustering", {}, [&]() { return choose_clustering::validate(handle); });
     int nclusters = 0;
+    std::vector<int> snn_sizes, kmeans_sizes;
+
+    std::vector<std::string> clustering_steps = filtering_steps;
+    clustering_steps.push_back("choose_clustering");
 
     {
         bool is_snn = (cluster_method == "snn_graph");
-        int snn_found = snn_graph_cluster::validate(handle, filtered_cells, is_snn);
+        int snn_found = step("snn_graph_cluster", clustering_steps, [&]() { return snn_graph_cluster::validate(handle, filtered_cells, is_snn, &snn_sizes); });
         if (is_snn) {
             nclusters = snn_found;
         }
@@ -123,18 +166,30 @@ void validate(const H5::H5File& handle, bool embedded, int version) {
 
     {
         bool is_kmeans = (cluster_method == "kmeans");
-        int kmeans_found = kmeans_cluster::validate(handle, filtered_cells, is_kmeans);
+        int kmeans_found = step("kmeans_cluster", clustering_steps, [&]() { return kmeans_cluster::validate(handle, filtered_cells, is_kmeans, &kmeans_sizes); });
         if (is_kmeans) {
             nclusters = kmeans_found;
         }
     }
 
-    tsne::validate(handle, filtered_cells);
-    umap::validate(handle, filtered_cells);
+    // Only the chosen clustering step needs to be available for the per-cluster results.
+    std::vector<std::string> cluster_steps { "inputs", "choose_clustering", (cluster_method == "kmeans" ? "kmeans_cluster" : "snn_graph_cluster") };
+    bool has_clusters = std::all_of(cluster_steps.begin(), cluster_steps.end(), [&](const std::string& s) -> bool {
+        return std::find(checked.begin(), checked.end(), s) != checked.end();
+    });
+
+    const std::vector<int>* cluster_sizes = NULL;
+    if (has_clusters) {
+        cluster_sizes = (cluster_method == "kmeans" ? &kmeans_sizes : &snn_sizes);
+    }
+    step("tsne", filtering_steps, [&]() -> void { tsne::validate(handle, filtered_cells, cluster_sizes); });
+    step("umap", filtering_steps, [&]() -> void { umap::validate(handle, filtered_cells, cluster_sizes); });
+
+    step("marker_detection", cluster_steps, [&]() -> void { marker_detection::validate(handle, nclusters, i_out.modalities, i_out.num_features, version); });
+    step("custom_selections", filtering_steps, [&]() -> void { custom_selections::validate(handle, filtered_cells, i_out.modalities, i_out.num_features, version); });
+    step("cell_labelling", cluster_steps, [&]() -> void { cell_labelling::validate(handle, nclusters, registry); });
 
-    marker_detection::validate(handle, nclusters, i_out.modalities, i_out.num_features, version);
-    custom_selections::validate(handle, filtered_cells, i_out.modalities, i_out.num_features, version);
-    cell_labelling::validate(handle, nclusters);
+    return checked;
 }
 
 }
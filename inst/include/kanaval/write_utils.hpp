@@ -0,0 +1,165 @@
+#ifndef KANAVAL_WRITE_UTILS_HPP
+#define KANAVAL_WRITE_UTILS_HPP
+
+#include "H5Cpp.h"
+#include <vector>
+#include <string>
+#include <limits>
+#include <cmath>
+
+/**
+ * @file write_utils.hpp
+ *
+ * @brief Utilities for writing state files.
+ */
+
+namespace kanaval {
+
+namespace utils {
+
+/**
+ * @cond
+ */
+inline H5::StrType utf8_string_type() {
+    H5::StrType stype(0, H5T_VARIABLE);
+    stype.setCset(H5T_CSET_UTF8);
+    return stype;
+}
+/**
+ * @endcond
+ */
+
+/**
+ * @param handle Group in which to create the dataset.
+ * @param name Name of the dataset.
+ * @param val Value to write.
+ */
+template<class Object>
+void write_integer_scalar(const Object& handle, const std::string& name, int val) {
+    auto dhandle = handle.createDataSet(name, H5::PredType::NATIVE_INT, H5S_SCALAR);
+    dhandle.write(&val, H5::PredType::NATIVE_INT);
+}
+
+/**
+ * @param handle Group in which to create the dataset.
+ * @param name Name of the dataset.
+ * @param val Value to write.
+ */
+template<class Object>
+void write_float_scalar(const Object& handle, const std::string& name, double val) {
+    auto dhandle = handle.createDataSet(name, H5::PredType::NATIVE_DOUBLE, H5S_SCALAR);
+    dhandle.write(&val, H5::PredType::NATIVE_DOUBLE);
+}
+
+/**
+ * @param handle Group in which to create the dataset.
+ * @param name Name of the dataset.
+ * @param val Value to write.
+ */
+template<class Object>
+void write_string(const Object& handle, const std::string& name, const std::string& val) {
+    auto stype = utf8_string_type();
+    auto dhandle = handle.createDataSet(name, stype, H5S_SCALAR);
+    dhandle.write(val, stype);
+}
+
+/**
+ * @param handle Group in which to create the dataset.
+ * @param name Name of the dataset.
+ * @param vals Values to write.
+ */
+template<class Object>
+void write_string_vector(const Object& handle, const std::string& name, const std::vector<std::string>& vals) {
+    auto stype = utf8_string_type();
+    hsize_t len = vals.size();
+    auto dhandle = handle.createDataSet(name, stype, H5::DataSpace(1, &len));
+    std::vector<const char*> ptrs;
+    ptrs.reserve(vals.size());
+    for (const auto& v : vals) {
+        ptrs.push_back(v.c_str());
+    }
+    dhandle.write(ptrs.data(), stype);
+}
+
+/**
+ * @param handle Group in which to create the dataset.
+ * @param name Name of the dataset.
+ * @param vals Values to write.
+ */
+template<class Object>
+void write_integer_vector(const Object& handle, const std::string& name, const std::vector<int>& vals) {
+    hsize_t len = vals.size();
+    auto dhandle = handle.createDataSet(name, H5::PredType::NATIVE_INT, H5::DataSpace(1, &len));
+    dhandle.write(vals.data(), H5::PredType::NATIVE_INT);
+}
+
+/**
+ * @param handle Group in which to create the dataset.
+ * @param name Name of the dataset.
+ * @param vals Values to write.
+ */
+template<class Object>
+void write_float_vector(const Object& handle, const std::string& name, const std::vector<double>& vals) {
+    hsize_t len = vals.size();
+    auto dhandle = handle.createDataSet(name, H5::PredType::NATIVE_DOUBLE, H5::DataSpace(1, &len));
+    dhandle.write(vals.data(), H5::PredType::NATIVE_DOUBLE);
+}
+
+/**
+ * Create a dataset that is never written to, such that all reads return the fill value.
+ * No storage is allocated in the file, which is useful for results that are required by the format but are not available.
+ *
+ * @param handle Group in which to create the dataset.
+ * @param name Name of the dataset.
+ * @param type Class of the datatype, either `H5T_FLOAT` or `H5T_INTEGER`.
+ * @param dims Dimensions of the dataset.
+ * @param fill Fill value.
+ * This is NaN by default for floats, which is converted to zero for integers.
+ */
+template<class Object>
+void write_placeholder(const Object& handle, const std::string& name, H5T_class_t type, const std::vector<hsize_t>& dims, double fill = std::numeric_limits<double>::quiet_NaN()) {
+    H5::DataSpace dspace(dims.size(), dims.data());
+    H5::DSetCreatPropList plist;
+    plist.setAllocTime(H5D_ALLOC_TIME_LATE);
+
+    if (type == H5T_INTEGER) {
+        int ifill = (std::isnan(fill) ? 0 : fill);
+        plist.setFillValue(H5::PredType::NATIVE_INT, &ifill);
+        handle.createDataSet(name, H5::PredType::NATIVE_INT32, dspace, plist);
+    } else {
+        plist.setFillValue(H5::PredType::NATIVE_DOUBLE, &fill);
+        handle.createDataSet(name, H5::PredType::NATIVE_DOUBLE, dspace, plist);
+    }
+}
+
+/**
+ * Mark a group as containing values that are unknown, e.g., parameters that were not recorded by the original analysis.
+ * This is done by adding an integer `unknown` attribute set to 1,
+ * so that functions like `snn_graph_cluster::verify()` can skip checks that would otherwise be applied to made-up values.
+ *
+ * @param handle Group to be marked.
+ */
+inline void mark_unknown(const H5::H5Object& handle) {
+    int val = 1;
+    auto ahandle = handle.createAttribute("unknown", H5::PredType::NATIVE_INT, H5::DataSpace(H5S_SCALAR));
+    ahandle.write(H5::PredType::NATIVE_INT, &val);
+}
+
+/**
+ * @param handle Group to be checked.
+ * @return Whether `handle` was marked with `mark_unknown()`.
+ */
+inline bool is_unknown(const H5::H5Object& handle) {
+    if (!handle.attrExists("unknown")) {
+        return false;
+    }
+    int val = 0;
+    handle.openAttribute("unknown").read(H5::PredType::NATIVE_INT, &val);
+    return val != 0;
+}
+
+}
+
+}
+
+#endif
@@ -10,15 +10,296 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
+// validate_batch_
+SEXP validate_batch_(std::string dir, Rcpp::StringVector files, bool embedded, int version, SEXP registry, int shard_size, double lease_timeout, std::string owner, Rcpp::StringVector headers);
+RcppExport SEXP _kana_parser_validate_batch_(SEXP dirSEXP, SEXP filesSEXP, SEXP embeddedSEXP, SEXP versionSEXP, SEXP registrySEXP, SEXP shard_sizeSEXP, SEXP lease_timeoutSEXP, SEXP ownerSEXP, SEXP headersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type dir(dirSEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< bool >::type embedded(embeddedSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type registry(registrySEXP);
+    Rcpp::traits::input_parameter< int >::type shard_size(shard_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type lease_timeout(lease_timeoutSEXP);
+    Rcpp::traits::input_parameter< std::string >::type owner(ownerSEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type headers(headersSEXP);
+    rcpp_result_gen = Rcpp::wrap(validate_batch_(dir, files, embedded, version, registry, shard_size, lease_timeout, owner, headers));
+    return rcpp_result_gen;
+END_RCPP
+}
+// summarize_batch_
+SEXP summarize_batch_(std::string dir, std::string owner);
+RcppExport SEXP _kana_parser_summarize_batch_(SEXP dirSEXP, SEXP ownerSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type dir(dirSEXP);
+    Rcpp::traits::input_parameter< std::string >::type owner(ownerSEXP);
+    rcpp_result_gen = Rcpp::wrap(summarize_batch_(dir, owner));
+    return rcpp_result_gen;
+END_RCPP
+}
+// tabulate_clusters_
+SEXP tabulate_clusters_(std::string path, Rcpp::Nullable<Rcpp::String> files, bool is_dir, int version);
+RcppExport SEXP _kana_parser_tabulate_clusters_(SEXP pathSEXP, SEXP filesSEXP, SEXP is_dirSEXP, SEXP versionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::String> >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< bool >::type is_dir(is_dirSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    rcpp_result_gen = Rcpp::wrap(tabulate_clusters_(path, files, is_dir, version));
+    return rcpp_result_gen;
+END_RCPP
+}
+// compare_mixing_
+SEXP compare_mixing_(std::string path, Rcpp::Nullable<Rcpp::String> files, bool is_dir, int version, int num_neighbors, int num_threads);
+RcppExport SEXP _kana_parser_compare_mixing_(SEXP pathSEXP, SEXP filesSEXP, SEXP is_dirSEXP, SEXP versionSEXP, SEXP num_neighborsSEXP, SEXP num_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::String> >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< bool >::type is_dir(is_dirSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    Rcpp::traits::input_parameter< int >::type num_neighbors(num_neighborsSEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(compare_mixing_(path, files, is_dir, version, num_neighbors, num_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// export_arrow_
+SEXP export_arrow_(std::string path, std::string output, int version, int num_pcs, int block_size, Rcpp::Nullable<Rcpp::String> files, bool is_dir);
+RcppExport SEXP _kana_parser_export_arrow_(SEXP pathSEXP, SEXP outputSEXP, SEXP versionSEXP, SEXP num_pcsSEXP, SEXP block_sizeSEXP, SEXP filesSEXP, SEXP is_dirSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    Rcpp::traits::input_parameter< int >::type num_pcs(num_pcsSEXP);
+    Rcpp::traits::input_parameter< int >::type block_size(block_sizeSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::String> >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< bool >::type is_dir(is_dirSEXP);
+    rcpp_result_gen = Rcpp::wrap(export_arrow_(path, output, version, num_pcs, block_size, files, is_dir));
+    return rcpp_result_gen;
+END_RCPP
+}
+// export_h5ad_
+SEXP export_h5ad_(std::string path, std::string output, int version, int block_size, int compression_level, bool include_markers);
+RcppExport SEXP _kana_parser_export_h5ad_(SEXP pathSEXP, SEXP outputSEXP, SEXP versionSEXP, SEXP block_sizeSEXP, SEXP compression_levelSEXP, SEXP include_markersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    Rcpp::traits::input_parameter< int >::type block_size(block_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type compression_level(compression_levelSEXP);
+    Rcpp::traits::input_parameter< bool >::type include_markers(include_markersSEXP);
+    rcpp_result_gen = Rcpp::wrap(export_h5ad_(path, output, version, block_size, compression_level, include_markers));
+    return rcpp_result_gen;
+END_RCPP
+}
+// build_feature_index_
+SEXP build_feature_index_(std::string path, std::string files, bool is_dir, std::string output, int version);
+RcppExport SEXP _kana_parser_build_feature_index_(SEXP pathSEXP, SEXP filesSEXP, SEXP is_dirSEXP, SEXP outputSEXP, SEXP versionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< bool >::type is_dir(is_dirSEXP);
+    Rcpp::traits::input_parameter< std::string >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    rcpp_result_gen = Rcpp::wrap(build_feature_index_(path, files, is_dir, output, version));
+    return rcpp_result_gen;
+END_RCPP
+}
+// find_features_
+SEXP find_features_(std::string path, Rcpp::StringVector names, std::string modality, bool use_symbols);
+RcppExport SEXP _kana_parser_find_features_(SEXP pathSEXP, SEXP namesSEXP, SEXP modalitySEXP, SEXP use_symbolsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type names(namesSEXP);
+    Rcpp::traits::input_parameter< std::string >::type modality(modalitySEXP);
+    Rcpp::traits::input_parameter< bool >::type use_symbols(use_symbolsSEXP);
+    rcpp_result_gen = Rcpp::wrap(find_features_(path, names, modality, use_symbols));
+    return rcpp_result_gen;
+END_RCPP
+}
+// build_gzip_index_
+SEXP build_gzip_index_(std::string path, std::string files, bool is_dir, std::string output, double spacing);
+RcppExport SEXP _kana_parser_build_gzip_index_(SEXP pathSEXP, SEXP filesSEXP, SEXP is_dirSEXP, SEXP outputSEXP, SEXP spacingSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< bool >::type is_dir(is_dirSEXP);
+    Rcpp::traits::input_parameter< std::string >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< double >::type spacing(spacingSEXP);
+    rcpp_result_gen = Rcpp::wrap(build_gzip_index_(path, files, is_dir, output, spacing));
+    return rcpp_result_gen;
+END_RCPP
+}
+// read_embedded_file_
+SEXP read_embedded_file_(std::string path, std::string files, bool is_dir, int which, Rcpp::Nullable<Rcpp::String> index, int num_threads);
+RcppExport SEXP _kana_parser_read_embedded_file_(SEXP pathSEXP, SEXP filesSEXP, SEXP is_dirSEXP, SEXP whichSEXP, SEXP indexSEXP, SEXP num_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< bool >::type is_dir(is_dirSEXP);
+    Rcpp::traits::input_parameter< int >::type which(whichSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::String> >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_embedded_file_(path, files, is_dir, which, index, num_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// import_h5ad_
+SEXP import_h5ad_(std::string path, std::string output, std::string cluster_column, std::string pca_key, std::string tsne_key, std::string umap_key, int block_size, int compression_level, Rcpp::Nullable<Rcpp::Function> progress);
+RcppExport SEXP _kana_parser_import_h5ad_(SEXP pathSEXP, SEXP outputSEXP, SEXP cluster_columnSEXP, SEXP pca_keySEXP, SEXP tsne_keySEXP, SEXP umap_keySEXP, SEXP block_sizeSEXP, SEXP compression_levelSEXP, SEXP progressSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< std::string >::type cluster_column(cluster_columnSEXP);
+    Rcpp::traits::input_parameter< std::string >::type pca_key(pca_keySEXP);
+    Rcpp::traits::input_parameter< std::string >::type tsne_key(tsne_keySEXP);
+    Rcpp::traits::input_parameter< std::string >::type umap_key(umap_keySEXP);
+    Rcpp::traits::input_parameter< int >::type block_size(block_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type compression_level(compression_levelSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::Function> >::type progress(progressSEXP);
+    rcpp_result_gen = Rcpp::wrap(import_h5ad_(path, output, cluster_column, pca_key, tsne_key, umap_key, block_size, compression_level, progress));
+    return rcpp_result_gen;
+END_RCPP
+}
+// inspect_
+SEXP inspect_(std::string path, int version, Rcpp::StringVector headers);
+RcppExport SEXP _kana_parser_inspect_(SEXP pathSEXP, SEXP versionSEXP, SEXP headersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type headers(headersSEXP);
+    rcpp_result_gen = Rcpp::wrap(inspect_(path, version, headers));
+    return rcpp_result_gen;
+END_RCPP
+}
+// load_references_
+SEXP load_references_(std::string dir);
+RcppExport SEXP _kana_parser_load_references_(SEXP dirSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type dir(dirSEXP);
+    rcpp_result_gen = Rcpp::wrap(load_references_(dir));
+    return rcpp_result_gen;
+END_RCPP
+}
+// lookup_markers_
+SEXP lookup_markers_(std::string path, Rcpp::IntegerVector features, std::string modality, int version);
+RcppExport SEXP _kana_parser_lookup_markers_(SEXP pathSEXP, SEXP featuresSEXP, SEXP modalitySEXP, SEXP versionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type features(featuresSEXP);
+    Rcpp::traits::input_parameter< std::string >::type modality(modalitySEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    rcpp_result_gen = Rcpp::wrap(lookup_markers_(path, features, modality, version));
+    return rcpp_result_gen;
+END_RCPP
+}
+// find_neighbors_
+SEXP find_neighbors_(std::string path, std::string type, int version, int k, bool approximate, int num_threads);
+RcppExport SEXP _kana_parser_find_neighbors_(SEXP pathSEXP, SEXP typeSEXP, SEXP versionSEXP, SEXP kSEXP, SEXP approximateSEXP, SEXP num_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type type(typeSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< bool >::type approximate(approximateSEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(find_neighbors_(path, type, version, k, approximate, num_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// fetch_statistics_
+SEXP fetch_statistics_();
+RcppExport SEXP _kana_parser_fetch_statistics_() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    rcpp_result_gen = Rcpp::wrap(fetch_statistics_());
+    return rcpp_result_gen;
+END_RCPP
+}
+// read_annotations_
+SEXP read_annotations_(std::string path, std::string files, bool is_dir, int num_threads, Rcpp::Nullable<Rcpp::String> output);
+RcppExport SEXP _kana_parser_read_annotations_(SEXP pathSEXP, SEXP filesSEXP, SEXP is_dirSEXP, SEXP num_threadsSEXP, SEXP outputSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< bool >::type is_dir(is_dirSEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::String> >::type output(outputSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_annotations_(path, files, is_dir, num_threads, output));
+    return rcpp_result_gen;
+END_RCPP
+}
+// read_kana_
+SEXP read_kana_(std::string path, Rcpp::StringVector steps, bool embedded, int version, bool validate, SEXP registry, int num_threads);
+RcppExport SEXP _kana_parser_read_kana_(SEXP pathSEXP, SEXP stepsSEXP, SEXP embeddedSEXP, SEXP versionSEXP, SEXP validateSEXP, SEXP registrySEXP, SEXP num_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type steps(stepsSEXP);
+    Rcpp::traits::input_parameter< bool >::type embedded(embeddedSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    Rcpp::traits::input_parameter< bool >::type validate(validateSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type registry(registrySEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_kana_(path, steps, embedded, version, validate, registry, num_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// read_embedding_
+SEXP read_embedding_(std::string path, std::string type, int version, int num_threads);
+RcppExport SEXP _kana_parser_read_embedding_(SEXP pathSEXP, SEXP typeSEXP, SEXP versionSEXP, SEXP num_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type type(typeSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_embedding_(path, type, version, num_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// verify_clusters_
+SEXP verify_clusters_(std::string path, int version, double tolerance, int num_threads);
+RcppExport SEXP _kana_parser_verify_clusters_(SEXP pathSEXP, SEXP versionSEXP, SEXP toleranceSEXP, SEXP num_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< int >::type version(versionSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(verify_clusters_(path, version, tolerance, num_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // validate_
-SEXP validate_(std::string path, bool embedded, int version);
-RcppExport SEXP _kana_parser_validate_(SEXP pathSEXP, SEXP embeddedSEXP, SEXP versionSEXP) {
+SEXP validate_(std::string path, bool embedded, int version, SEXP registry, bool profile, bool completed_only, Rcpp::StringVector headers);
+RcppExport SEXP _kana_parser_validate_(SEXP pathSEXP, SEXP embeddedSEXP, SEXP versionSEXP, SEXP registrySEXP, SEXP profileSEXP, SEXP completed_onlySEXP, SEXP headersSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
     Rcpp::traits::input_parameter< bool >::type embedded(embeddedSEXP);
     Rcpp::traits::input_parameter< int >::type version(versionSEXP);
-    rcpp_result_gen = Rcpp::wrap(validate_(path, embedded, version));
+    Rcpp::traits::input_parameter< SEXP >::type registry(registrySEXP);
+    Rcpp::traits::input_parameter< bool >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< bool >::type completed_only(completed_onlySEXP);
+    Rcpp::traits::input_parameter< Rcpp::StringVector >::type headers(headersSEXP);
+    rcpp_result_gen = Rcpp::wrap(validate_(path, embedded, version, registry, profile, completed_only, headers));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -63,7 +344,27 @@ END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_kana_parser_validate_", (DL_FUNC) &_kana_parser_validate_, 3},
+    {"_kana_parser_validate_batch_", (DL_FUNC) &_kana_parser_validate_batch_, 9},
+    {"_kana_parser_summarize_batch_", (DL_FUNC) &_kana_parser_summarize_batch_, 2},
+    {"_kana_parser_tabulate_clusters_", (DL_FUNC) &_kana_parser_tabulate_clusters_, 4},
+    {"_kana_parser_compare_mixing_", (DL_FUNC) &_kana_parser_compare_mixing_, 6},
+    {"_kana_parser_export_arrow_", (DL_FUNC) &_kana_parser_export_arrow_, 7},
+    {"_kana_parser_export_h5ad_", (DL_FUNC) &_kana_parser_export_h5ad_, 6},
+    {"_kana_parser_build_feature_index_", (DL_FUNC) &_kana_parser_build_feature_index_, 5},
+    {"_kana_parser_find_features_", (DL_FUNC) &_kana_parser_find_features_, 4},
+    {"_kana_parser_build_gzip_index_", (DL_FUNC) &_kana_parser_build_gzip_index_, 5},
+    {"_kana_parser_read_embedded_file_", (DL_FUNC) &_kana_parser_read_embedded_file_, 6},
+    {"_kana_parser_import_h5ad_", (DL_FUNC) &_kana_parser_import_h5ad_, 9},
+    {"_kana_parser_inspect_", (DL_FUNC) &_kana_parser_inspect_, 3},
+    {"_kana_parser_load_references_", (DL_FUNC) &_kana_parser_load_references_, 1},
+    {"_kana_parser_lookup_markers_", (DL_FUNC) &_kana_parser_lookup_markers_, 4},
+    {"_kana_parser_find_neighbors_", (DL_FUNC) &_kana_parser_find_neighbors_, 6},
+    {"_kana_parser_fetch_statistics_", (DL_FUNC) &_kana_parser_fetch_statistics_, 0},
+    {"_kana_parser_read_annotations_", (DL_FUNC) &_kana_parser_read_annotations_, 5},
+    {"_kana_parser_read_kana_", (DL_FUNC) &_kana_parser_read_kana_, 7},
+    {"_kana_parser_read_embedding_", (DL_FUNC) &_kana_parser_read_embedding_, 4},
+    {"_kana_parser_verify_clusters_", (DL_FUNC) &_kana_parser_verify_clusters_, 4},
+    {"_kana_parser_validate_", (DL_FUNC) &_kana_parser_validate_, 7},
     {"_kana_parser_write_integer_scalar", (DL_FUNC) &_kana_parser_write_integer_scalar, 4},
     {"_kana_parser_write_double_scalar", (DL_FUNC) &_kana_parser_write_double_scalar, 4},
     {"_kana_parser_write_string_scalar", (DL_FUNC) &_kana_parser_write_string_scalar, 4},
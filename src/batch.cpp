@@ -0,0 +1,64 @@
+#include "Rcpp.h"
+#include "kanaval/validate.hpp"
+#include "kanaval/object_store.hpp"
+#include "kanaval/batch.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP validate_batch_(std::string dir, Rcpp::StringVector files, bool embedded, int version, SEXP registry, int shard_size, double lease_timeout, std::string owner, Rcpp::StringVector headers) {
+    const kanaval::cell_labelling::Registry* ptr = NULL;
+    if (!Rf_isNull(registry)) {
+        ptr = Rcpp::XPtr<kanaval::cell_labelling::Registry>(registry).get();
+    }
+
+    kanaval::batch::Options opt;
+    opt.shard_size = shard_size;
+    opt.lease_timeout = lease_timeout;
+    // Workers without any files can only join an existing workspace, so that they never create an empty manifest.
+    auto paths = Rcpp::as<std::vector<std::string> >(files);
+    auto workspace = (paths.empty() ? kanaval::batch::Workspace(dir, opt) : kanaval::batch::Workspace(dir, paths, opt));
+    auto http_headers = Rcpp::as<std::vector<std::string> >(headers);
+
+    size_t n = kanaval::batch::run(workspace, owner, [&](const std::string& path) -> void {
+        if (kanaval::object_store::is_url(path)) {
+            kanaval::object_store::Source source(path, http_headers);
+            auto handle = kanaval::object_store::open_hdf5(source);
+            kanaval::validate(handle, embedded, version, ptr);
+        } else {
+            H5::H5File handle(path, H5F_ACC_RDONLY);
+            kanaval::validate(handle, embedded, version, ptr);
+        }
+    });
+
+    return Rcpp::IntegerVector::create(n);
+}
+
+//[[Rcpp::export(rng=false)]]
+SEXP summarize_batch_(std::string dir, std::string owner) {
+    kanaval::batch::Workspace workspace(dir);
+    auto summary = kanaval::batch::merge(workspace, owner);
+
+    size_t n = summary.results.size();
+    Rcpp::StringVector path(n), message(n);
+    Rcpp::LogicalVector ok(n);
+    Rcpp::NumericVector seconds(n);
+    for (size_t i = 0; i < n; ++i) {
+        const auto& r = summary.results[i];
+        path[i] = r.path;
+        ok[i] = r.ok;
+        seconds[i] = r.seconds;
+        if (!r.ok) {
+            message[i] = r.message;
+        } else {
+            message[i] = NA_STRING;
+        }
+    }
+
+    return Rcpp::List::create(
+        Rcpp::Named("path") = path,
+        Rcpp::Named("ok") = ok,
+        Rcpp::Named("seconds") = seconds,
+        Rcpp::Named("message") = message,
+        Rcpp::Named("num_files") = static_cast<int>(summary.num_files),
+        Rcpp::Named("num_pending") = static_cast<int>(summary.num_pending)
+    );
+}
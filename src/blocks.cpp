@@ -0,0 +1,87 @@
+#include "Rcpp.h"
+#include "kanaval/blocks.hpp"
+#include "kanaval/mixing.hpp"
+
+static kanaval::blocks::Blocks materialize_blocks(const H5::H5File& handle, const kanaval::inspect::Summary& summary, Rcpp::Nullable<Rcpp::String> files, bool is_dir, int version) {
+    std::vector<kanaval::embedded::Location> locations;
+    if (files.isNotNull()) {
+        std::string fpath = Rcpp::as<std::string>(files.get());
+        auto info = kanaval::embedded::list_files(handle);
+        locations = (is_dir ? kanaval::embedded::locate_in_directory(info, fpath) : kanaval::embedded::locate_in_kana(info, fpath));
+    }
+
+    kanaval::inputs::Details details;
+    details.modalities = summary.inputs.modalities;
+    details.num_features = summary.inputs.num_features;
+    details.num_cells = summary.inputs.num_cells;
+    details.num_samples = summary.inputs.num_samples;
+    return kanaval::blocks::materialize(handle, locations, details, version);
+}
+
+static std::vector<int> load_chosen_clusters(const H5::H5File& handle, const kanaval::inspect::Summary& summary, int& num_clusters) {
+    std::string step = (summary.clustering_method == "kmeans" ? "kmeans_cluster" : "snn_graph_cluster");
+    auto clusters = kanaval::utils::load_integer_vector(kanaval::utils::check_and_open_group(handle.openGroup(step), "results"), "clusters");
+    num_clusters = (clusters.empty() ? 0 : *std::max_element(clusters.begin(), clusters.end()) + 1);
+    return clusters;
+}
+
+//[[Rcpp::export(rng=false)]]
+SEXP tabulate_clusters_(std::string path, Rcpp::Nullable<Rcpp::String> files, bool is_dir, int version) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    auto summary = kanaval::inspect::inspect(handle, version);
+    auto blocks = materialize_blocks(handle, summary, files, is_dir, version);
+    int nclusters = 0;
+    auto clusters = load_chosen_clusters(handle, summary, nclusters);
+    if (clusters.size() != blocks.filtered.size()) {
+        throw std::runtime_error("number of cluster assignments should be equal to the number of cells after filtering");
+    }
+
+    int nblocks = blocks.num_blocks();
+    auto tab = kanaval::blocks::contingency(clusters.data(), blocks.filtered.data(), clusters.size(), nclusters, nblocks);
+    Rcpp::IntegerMatrix output(nclusters, nblocks);
+    for (int c = 0; c < nclusters; ++c) {
+        for (int b = 0; b < nblocks; ++b) {
+            output(c, b) = tab[static_cast<size_t>(c) * nblocks + b];
+        }
+    }
+
+    Rcpp::CharacterVector rownames(nclusters);
+    for (int c = 0; c < nclusters; ++c) {
+        rownames[c] = std::to_string(c);
+    }
+    output.attr("dimnames") = Rcpp::List::create(rownames, Rcpp::CharacterVector(blocks.names.begin(), blocks.names.end()));
+    return output;
+}
+
+//[[Rcpp::export(rng=false)]]
+SEXP compare_mixing_(std::string path, Rcpp::Nullable<Rcpp::String> files, bool is_dir, int version, int num_neighbors, int num_threads) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    auto summary = kanaval::inspect::inspect(handle, version);
+    auto blocks = materialize_blocks(handle, summary, files, is_dir, version);
+    int nclusters = 0;
+    auto clusters = load_chosen_clusters(handle, summary, nclusters);
+    if (clusters.size() != blocks.filtered.size()) {
+        throw std::runtime_error("number of cluster assignments should be equal to the number of cells after filtering");
+    }
+
+    kanaval::mixing::Options opt;
+    opt.num_neighbors = num_neighbors;
+    opt.search.num_threads = num_threads;
+    auto res = kanaval::mixing::compare(handle, blocks, clusters.data(), nclusters, version, opt);
+
+    auto summary2list = [&](const kanaval::mixing::Summary& summary) -> Rcpp::List {
+        Rcpp::NumericVector per_block(summary.per_block.begin(), summary.per_block.end());
+        per_block.names() = Rcpp::CharacterVector(blocks.names.begin(), blocks.names.end());
+        return Rcpp::List::create(
+            Rcpp::Named("per_cell") = Rcpp::NumericVector(summary.per_cell.begin(), summary.per_cell.end()),
+            Rcpp::Named("per_block") = per_block,
+            Rcpp::Named("per_cluster") = Rcpp::NumericVector(summary.per_cluster.begin(), summary.per_cluster.end()),
+            Rcpp::Named("overall") = summary.overall
+        );
+    };
+
+    return Rcpp::List::create(
+        Rcpp::Named("uncorrected") = summary2list(res.uncorrected),
+        Rcpp::Named("corrected") = summary2list(res.corrected)
+    );
+}
@@ -0,0 +1,17 @@
+#include "Rcpp.h"
+#include "kanaval/cell_table.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP export_arrow_(std::string path, std::string output, int version, int num_pcs, int block_size, Rcpp::Nullable<Rcpp::String> files, bool is_dir) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    kanaval::cell_table::Options opt;
+    opt.num_pcs = num_pcs;
+    opt.block_size = block_size;
+    if (files.isNotNull()) {
+        std::string fpath = Rcpp::as<std::string>(files.get());
+        auto info = kanaval::embedded::list_files(handle);
+        opt.files = (is_dir ? kanaval::embedded::locate_in_directory(info, fpath) : kanaval::embedded::locate_in_kana(info, fpath));
+    }
+    kanaval::cell_table::export_arrow(handle, output, version, opt);
+    return R_NilValue;
+}
@@ -0,0 +1,13 @@
+#include "Rcpp.h"
+#include "kanaval/export_h5ad.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP export_h5ad_(std::string path, std::string output, int version, int block_size, int compression_level, bool include_markers) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    kanaval::h5ad::ExportOptions opt;
+    opt.block_size = block_size;
+    opt.compression_level = compression_level;
+    opt.include_markers = include_markers;
+    kanaval::h5ad::export_state(handle, output, version, opt);
+    return R_NilValue;
+}
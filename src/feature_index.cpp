@@ -0,0 +1,46 @@
+#include "Rcpp.h"
+#include "kanaval/feature_index.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP build_feature_index_(std::string path, std::string files, bool is_dir, std::string output, int version) {
+    auto build = [&](const H5::H5File& handle) {
+        auto info = kanaval::embedded::list_files(handle);
+        auto locations = (is_dir ? kanaval::embedded::locate_in_directory(info, files) : kanaval::embedded::locate_in_kana(info, files));
+        return kanaval::feature_index::build(handle, locations, version);
+    };
+
+    if (output == path) {
+        H5::H5File handle(path, H5F_ACC_RDWR);
+        auto indices = build(handle);
+        kanaval::feature_index::save(handle, indices);
+    } else {
+        H5::H5File handle(path, H5F_ACC_RDONLY);
+        auto indices = build(handle);
+        H5::H5File ohandle(output, H5F_ACC_TRUNC);
+        kanaval::feature_index::save(ohandle, indices);
+    }
+
+    return R_NilValue;
+}
+
+//[[Rcpp::export(rng=false)]]
+SEXP find_features_(std::string path, Rcpp::StringVector names, std::string modality, bool use_symbols) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    auto indices = kanaval::feature_index::load(handle);
+    auto it = indices.find(modality);
+    if (it == indices.end()) {
+        throw std::runtime_error("no index available for modality '" + modality + "'");
+    }
+    const auto& index = (use_symbols ? it->second.symbols : it->second.ids);
+
+    Rcpp::IntegerVector output(names.size());
+    for (size_t i = 0; i < output.size(); ++i) {
+        if (names[i] == NA_STRING) {
+            output[i] = NA_INTEGER;
+            continue;
+        }
+        int found = index.find(Rcpp::as<std::string>(names[i]));
+        output[i] = (found < 0 ? NA_INTEGER : found + 1);
+    }
+    return output;
+}
@@ -0,0 +1,53 @@
+#include "Rcpp.h"
+#include "kanaval/gzip_index.hpp"
+
+static std::vector<kanaval::embedded::Location> locate_files(const std::string& path, const std::string& files, bool is_dir) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    auto info = kanaval::embedded::list_files(handle);
+    return (is_dir ? kanaval::embedded::locate_in_directory(info, files) : kanaval::embedded::locate_in_kana(info, files));
+}
+
+//[[Rcpp::export(rng=false)]]
+SEXP build_gzip_index_(std::string path, std::string files, bool is_dir, std::string output, double spacing) {
+    auto locations = locate_files(path, files, is_dir);
+    H5::H5File ohandle(output, H5F_ACC_TRUNC);
+
+    Rcpp::IntegerVector indexed;
+    for (size_t i = 0; i < locations.size(); ++i) {
+        if (!kanaval::embedded::is_gzip(kanaval::embedded::read_bytes(locations[i], 0, 2))) {
+            continue;
+        }
+        auto index = kanaval::gzip_index::build(locations[i], spacing);
+        kanaval::gzip_index::save(ohandle, std::to_string(i), index);
+        indexed.push_back(i);
+    }
+
+    return indexed;
+}
+
+//[[Rcpp::export(rng=false)]]
+SEXP read_embedded_file_(std::string path, std::string files, bool is_dir, int which, Rcpp::Nullable<Rcpp::String> index, int num_threads) {
+    auto locations = locate_files(path, files, is_dir);
+    if (which < 0 || static_cast<size_t>(which) >= locations.size()) {
+        throw std::runtime_error("'which' is out of range for the embedded files");
+    }
+    const auto& loc = locations[which];
+
+    std::string contents;
+    std::string name = std::to_string(which);
+    bool indexed = false;
+    if (index.isNotNull()) {
+        H5::H5File ihandle(Rcpp::as<std::string>(index.get()), H5F_ACC_RDONLY);
+        if (ihandle.exists(name)) {
+            auto gzindex = kanaval::gzip_index::load(ihandle, name);
+            contents = kanaval::gzip_index::decompress(loc, gzindex, num_threads);
+            indexed = true;
+        }
+    }
+    if (!indexed) {
+        contents = kanaval::embedded::read_text(loc);
+    }
+
+    Rcpp::RawVector output(contents.begin(), contents.end());
+    return output;
+}
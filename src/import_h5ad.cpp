@@ -0,0 +1,21 @@
+#include "Rcpp.h"
+#include "kanaval/import_h5ad.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP import_h5ad_(std::string path, std::string output, std::string cluster_column, std::string pca_key, std::string tsne_key, std::string umap_key, int block_size, int compression_level, Rcpp::Nullable<Rcpp::Function> progress) {
+    kanaval::h5ad::ImportOptions opt;
+    opt.cluster_column = cluster_column;
+    opt.pca_key = pca_key;
+    opt.tsne_key = tsne_key;
+    opt.umap_key = umap_key;
+    opt.block_size = block_size;
+    opt.compression_level = compression_level;
+    if (progress.isNotNull()) {
+        Rcpp::Function fun(progress.get());
+        opt.on_complete = [&](const std::string& step) -> void {
+            fun(step);
+        };
+    }
+    kanaval::h5ad::import_state(path, output, opt);
+    return R_NilValue;
+}
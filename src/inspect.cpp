@@ -0,0 +1,72 @@
+#include "Rcpp.h"
+#include "kanaval/inspect.hpp"
+#include "object_store.h"
+
+static SEXP inspect_handle(const H5::H5File& handle, int version) {
+    auto summary = kanaval::inspect::inspect(handle, version);
+
+    auto pca2list = [](const kanaval::inspect::Summary::PCA& pca) -> Rcpp::List {
+        return Rcpp::List::create(
+            Rcpp::Named("num_hvgs") = pca.num_hvgs,
+            Rcpp::Named("num_pcs") = pca.num_pcs,
+            Rcpp::Named("num_pcs_stored") = pca.num_pcs_stored,
+            Rcpp::Named("block_method") = pca.block_method
+        );
+    };
+
+    Rcpp::IntegerVector nfeatures(summary.inputs.num_features.begin(), summary.inputs.num_features.end());
+    nfeatures.names() = Rcpp::CharacterVector(summary.inputs.modalities.begin(), summary.inputs.modalities.end());
+
+    return Rcpp::List::create(
+        Rcpp::Named("inputs") = Rcpp::List::create(
+            Rcpp::Named("formats") = Rcpp::CharacterVector(summary.inputs.formats.begin(), summary.inputs.formats.end()),
+            Rcpp::Named("num_features") = nfeatures,
+            Rcpp::Named("num_cells") = summary.inputs.num_cells,
+            Rcpp::Named("num_samples") = summary.inputs.num_samples
+        ),
+        Rcpp::Named("quality_control") = Rcpp::List::create(
+            Rcpp::Named("nmads") = summary.quality_control_nmads,
+            Rcpp::Named("adt_nmads") = summary.adt_quality_control_nmads,
+            Rcpp::Named("num_filtered_cells") = summary.num_filtered_cells
+        ),
+        Rcpp::Named("pca") = pca2list(summary.pca),
+        Rcpp::Named("adt_pca") = pca2list(summary.adt_pca),
+        Rcpp::Named("embeddings") = Rcpp::List::create(
+            Rcpp::Named("num_combined_dims") = summary.num_combined_dims,
+            Rcpp::Named("batch_correction_method") = summary.batch_correction_method,
+            Rcpp::Named("num_corrected_dims") = summary.num_corrected_dims
+        ),
+        Rcpp::Named("clustering") = Rcpp::List::create(
+            Rcpp::Named("method") = summary.clustering_method,
+            Rcpp::Named("kmeans_k") = summary.kmeans_k,
+            Rcpp::Named("snn_k") = summary.snn_k,
+            Rcpp::Named("snn_scheme") = summary.snn_scheme,
+            Rcpp::Named("snn_resolution") = summary.snn_resolution,
+            Rcpp::Named("num_clusters") = summary.num_clusters
+        ),
+        Rcpp::Named("tsne") = Rcpp::List::create(
+            Rcpp::Named("perplexity") = summary.tsne_perplexity,
+            Rcpp::Named("iterations") = summary.tsne_iterations
+        ),
+        Rcpp::Named("umap") = Rcpp::List::create(
+            Rcpp::Named("num_neighbors") = summary.umap_num_neighbors,
+            Rcpp::Named("num_epochs") = summary.umap_num_epochs,
+            Rcpp::Named("min_dist") = summary.umap_min_dist
+        ),
+        Rcpp::Named("num_custom_selections") = summary.num_custom_selections,
+        Rcpp::Named("labelling_references") = Rcpp::CharacterVector(summary.labelling_references.begin(), summary.labelling_references.end())
+    );
+}
+
+//[[Rcpp::export(rng=false)]]
+SEXP inspect_(std::string path, int version, Rcpp::StringVector headers) {
+    if (kanaval::object_store::is_url(path)) {
+        // Only the blocks containing the metadata and scalar datasets are fetched.
+        kanaval::object_store::Source source(path, Rcpp::as<std::vector<std::string> >(headers));
+        auto output = inspect_handle(kanaval::object_store::open_hdf5(source), version);
+        last_fetch_statistics() = source.statistics();
+        return output;
+    } else {
+        return inspect_handle(H5::H5File(path, H5F_ACC_RDONLY), version);
+    }
+}
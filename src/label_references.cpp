@@ -0,0 +1,8 @@
+#include "Rcpp.h"
+#include "kanaval/label_references.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP load_references_(std::string dir) {
+    auto registry = new kanaval::cell_labelling::Registry(kanaval::cell_labelling::load_registry(dir));
+    return Rcpp::XPtr<kanaval::cell_labelling::Registry>(registry, true);
+}
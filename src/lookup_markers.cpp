@@ -0,0 +1,30 @@
+#include "Rcpp.h"
+#include "kanaval/marker_query.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP lookup_markers_(std::string path, Rcpp::IntegerVector features, std::string modality, int version) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    kanaval::marker_query::Options opt;
+    opt.cache_size = 0;
+    kanaval::marker_query::Query query(handle, modality, version, opt);
+
+    std::vector<int> indices(features.begin(), features.end());
+    auto results = query.fetch(indices);
+    size_t nclusters = query.num_clusters();
+    const auto& stats = query.statistics();
+
+    // Each statistic is returned as a cluster-by-feature matrix.
+    Rcpp::List output(stats.size());
+    for (size_t s = 0; s < stats.size(); ++s) {
+        Rcpp::NumericMatrix current(nclusters, indices.size());
+        auto cIt = current.begin();
+        for (size_t f = 0; f < indices.size(); ++f) {
+            const auto& vals = results[f];
+            std::copy(vals.begin() + s * nclusters, vals.begin() + (s + 1) * nclusters, cIt + f * nclusters);
+        }
+        output[s] = current;
+    }
+
+    output.names() = Rcpp::wrap(stats);
+    return output;
+}
@@ -0,0 +1,31 @@
+#include "Rcpp.h"
+#include "kanaval/neighbors.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP find_neighbors_(std::string path, std::string type, int version, int k, bool approximate, int num_threads) {
+    kanaval::neighbors::Neighbors found;
+    {
+        H5::H5File handle(path, H5F_ACC_RDONLY);
+        auto dhandle = kanaval::embeddings::open(handle, type, version);
+        kanaval::neighbors::Options opt;
+        opt.approximate = approximate;
+        opt.num_threads = num_threads;
+        found = kanaval::neighbors::find(dhandle, k, opt);
+    }
+
+    // Converting the row-major results into column-major matrices with 1-based indices.
+    size_t n = found.size();
+    Rcpp::IntegerMatrix indices(n, k);
+    Rcpp::NumericMatrix distances(n, k);
+    for (size_t i = 0; i < n; ++i) {
+        for (int x = 0; x < k; ++x) {
+            indices(i, x) = found.indices[i * k + x] + 1;
+            distances(i, x) = found.distances[i * k + x];
+        }
+    }
+
+    return Rcpp::List::create(
+        Rcpp::Named("index") = indices,
+        Rcpp::Named("distance") = distances
+    );
+}
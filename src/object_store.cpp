@@ -0,0 +1,13 @@
+#include "Rcpp.h"
+#include "object_store.h"
+
+//[[Rcpp::export(rng=false)]]
+SEXP fetch_statistics_() {
+    const auto& stats = last_fetch_statistics();
+    return Rcpp::List::create(
+        Rcpp::Named("requests") = static_cast<double>(stats.requests),
+        Rcpp::Named("bytes_fetched") = static_cast<double>(stats.bytes_fetched),
+        Rcpp::Named("cache_hits") = static_cast<double>(stats.cache_hits),
+        Rcpp::Named("cache_misses") = static_cast<double>(stats.cache_misses)
+    );
+}
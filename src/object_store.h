@@ -0,0 +1,13 @@
+#ifndef KANA_PARSER_OBJECT_STORE_H
+#define KANA_PARSER_OBJECT_STORE_H
+
+#include "kanaval/object_store.hpp"
+
+// Statistics for the requests made by the most recent remote read, as reported by fetchStatistics().
+// This is defined inline so that all translation units share the same instance.
+inline kanaval::object_store::Statistics& last_fetch_statistics() {
+    static kanaval::object_store::Statistics stats;
+    return stats;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#include "Rcpp.h"
+#include "kanaval/annotations.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP read_annotations_(std::string path, std::string files, bool is_dir, int num_threads, Rcpp::Nullable<Rcpp::String> output) {
+    kanaval::annotations::Table table;
+    {
+        H5::H5File handle(path, H5F_ACC_RDONLY);
+        auto info = kanaval::embedded::list_files(handle);
+        auto locations = (is_dir ? kanaval::embedded::locate_in_directory(info, files) : kanaval::embedded::locate_in_kana(info, files));
+
+        int chosen = -1;
+        for (size_t i = 0; i < info.size(); ++i) {
+            if (info[i].type == "annotations") {
+                chosen = i;
+                break;
+            }
+        }
+        if (chosen < 0) {
+            throw std::runtime_error("no embedded 'annotations' file is available");
+        }
+
+        kanaval::annotations::ParseOptions opt;
+        opt.num_threads = num_threads;
+        table = kanaval::annotations::read(locations[chosen], opt);
+    }
+
+    if (output.isNotNull()) {
+        std::string opath = Rcpp::as<std::string>(output.get());
+        H5::H5File ohandle(opath, (opath == path ? H5F_ACC_RDWR : H5F_ACC_TRUNC));
+        kanaval::annotations::save(ohandle, "annotations", table);
+    }
+
+    Rcpp::List columns(table.columns.size());
+    Rcpp::CharacterVector names(table.columns.size());
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+        const auto& col = table.columns[c];
+        names[c] = col.name;
+        if (col.numeric) {
+            columns[c] = Rcpp::NumericVector(col.numbers.begin(), col.numbers.end());
+        } else {
+            Rcpp::IntegerVector codes(col.codes.size());
+            for (size_t r = 0; r < col.codes.size(); ++r) {
+                codes[r] = (col.codes[r] < 0 ? NA_INTEGER : col.codes[r] + 1);
+            }
+            codes.attr("levels") = Rcpp::wrap(col.levels);
+            codes.attr("class") = "factor";
+            columns[c] = codes;
+        }
+    }
+
+    columns.names() = names;
+    return columns;
+}
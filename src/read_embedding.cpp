@@ -0,0 +1,17 @@
+#include "Rcpp.h"
+#include "kanaval/embeddings.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP read_embedding_(std::string path, std::string type, int version, int num_threads) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    auto dhandle = kanaval::embeddings::open(handle, type, version);
+    auto dims = kanaval::utils::get_dimensions(dhandle);
+
+    // Column-major cell-by-dimension matrix is the same as the dimension-major layout.
+    Rcpp::NumericMatrix output(dims[0], dims[1]);
+    kanaval::embeddings::ReadOptions opt;
+    opt.layout = kanaval::embeddings::Layout::DIMENSION_MAJOR;
+    opt.num_threads = num_threads;
+    kanaval::embeddings::read(dhandle, static_cast<double*>(output.begin()), opt);
+    return output;
+}
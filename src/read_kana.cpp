@@ -0,0 +1,76 @@
+#include "Rcpp.h"
+#include "kanaval/validate.hpp"
+#include "kanaval/reader.hpp"
+
+template<class Vector, typename T>
+SEXP fill_numeric(const H5::DataSet& dhandle, const kanaval::reader::Node& node, int num_threads) {
+    // Values are read straight into the R vector (or copied from a memory-mapped view), no intermediate copy.
+    Vector output(node.size());
+    kanaval::reader::read(dhandle, node, static_cast<T*>(output.begin()), num_threads);
+    if (node.dims.size() == 2) {
+        output.attr("dim") = Rcpp::Dimension(node.dims[0], node.dims[1]);
+    }
+    return output;
+}
+
+static SEXP fill(const H5::Group& parent, const kanaval::reader::Node& node, int num_threads) {
+    if (node.kind == kanaval::reader::Kind::GROUP) {
+        auto ghandle = parent.openGroup(node.name);
+        size_t nchildren = node.children.size();
+        Rcpp::List output(nchildren);
+        Rcpp::CharacterVector names(nchildren);
+        for (size_t i = 0; i < nchildren; ++i) {
+            const auto& child = node.children[i];
+            output[i] = fill(ghandle, child, num_threads);
+            names[i] = child.name;
+        }
+        output.names() = names;
+        return output;
+    }
+
+    auto dhandle = parent.openDataSet(node.name);
+    if (node.kind == kanaval::reader::Kind::INTEGER) {
+        return fill_numeric<Rcpp::IntegerVector, int>(dhandle, node, num_threads);
+    } else if (node.kind == kanaval::reader::Kind::FLOAT) {
+        return fill_numeric<Rcpp::NumericVector, double>(dhandle, node, num_threads);
+    } else {
+        return Rcpp::wrap(kanaval::reader::read_strings(dhandle));
+    }
+}
+
+//[[Rcpp::export(rng=false)]]
+SEXP read_kana_(std::string path, Rcpp::StringVector steps, bool embedded, int version, bool validate, SEXP registry, int num_threads) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    if (validate) {
+        const kanaval::cell_labelling::Registry* ptr = NULL;
+        if (!Rf_isNull(registry)) {
+            ptr = Rcpp::XPtr<kanaval::cell_labelling::Registry>(registry).get();
+        }
+        kanaval::validate(handle, embedded, version, ptr);
+    }
+
+    std::vector<std::string> chosen;
+    if (steps.size()) {
+        chosen = Rcpp::as<std::vector<std::string> >(steps);
+    } else {
+        chosen = kanaval::reader::available_steps(handle);
+    }
+
+    // Describing everything first, so that a missing step fails before any reading is done.
+    std::vector<kanaval::reader::Node> nodes;
+    nodes.reserve(chosen.size());
+    for (const auto& step : chosen) {
+        try {
+            nodes.push_back(kanaval::reader::scan(kanaval::utils::check_and_open_group(handle, step), "results"));
+        } catch (std::exception& e) {
+            throw kanaval::utils::combine_errors(e, "failed to find the results for step '" + step + "'");
+        }
+    }
+
+    Rcpp::List output(chosen.size());
+    for (size_t s = 0; s < chosen.size(); ++s) {
+        output[s] = fill(handle.openGroup(chosen[s]), nodes[s], num_threads);
+    }
+    output.names() = Rcpp::wrap(chosen);
+    return output;
+}
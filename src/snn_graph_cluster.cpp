@@ -0,0 +1,19 @@
+#include "Rcpp.h"
+#include "kanaval/snn_graph_cluster.hpp"
+
+//[[Rcpp::export(rng=false)]]
+SEXP verify_clusters_(std::string path, int version, double tolerance, int num_threads) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    kanaval::snn_graph_cluster::VerifyOptions opt;
+    opt.tolerance = tolerance;
+    opt.search.num_threads = num_threads;
+    auto res = kanaval::snn_graph_cluster::verify(handle, version, opt);
+
+    return Rcpp::List::create(
+        Rcpp::Named("skipped") = res.skipped,
+        Rcpp::Named("consistent") = res.consistent,
+        Rcpp::Named("modularity") = res.modularity,
+        Rcpp::Named("best_merge_gain") = res.best_merge_gain,
+        Rcpp::Named("best_merge") = Rcpp::IntegerVector::create(res.merge_first, res.merge_second)
+    );
+}
@@ -1,9 +1,56 @@
 #include "Rcpp.h"
 #include "kanaval/validate.hpp"
+#include "object_store.h"
+#include "kanaval/progress.hpp"
 
 //[[Rcpp::export(rng=false)]]
-SEXP validate_(std::string path, bool embedded, int version) {
-    H5::H5File handle(path, H5F_ACC_RDONLY);
-    kanaval::validate(handle, embedded, version);
-    return R_NilValue;
+SEXP validate_(std::string path, bool embedded, int version, SEXP registry, bool profile, bool completed_only, Rcpp::StringVector headers) {
+    const kanaval::cell_labelling::Registry* ptr = NULL;
+    if (!Rf_isNull(registry)) {
+        ptr = Rcpp::XPtr<kanaval::cell_labelling::Registry>(registry).get();
+    }
+
+    kanaval::instrumentation::Context context;
+    kanaval::instrumentation::Context* cptr = (profile ? &context : NULL);
+    std::vector<std::string> checked;
+    if (kanaval::object_store::is_url(path)) {
+        kanaval::object_store::Source source(path, Rcpp::as<std::vector<std::string> >(headers));
+        auto handle = kanaval::object_store::open_hdf5(source);
+        checked = kanaval::validate(handle, embedded, version, ptr, cptr, completed_only);
+        last_fetch_statistics() = source.statistics();
+    } else {
+        auto handle = kanaval::progress::open(path);
+        checked = kanaval::validate(handle, embedded, version, ptr, cptr, completed_only);
+    }
+
+    if (!profile) {
+        if (completed_only) {
+            return Rcpp::StringVector(checked.begin(), checked.end());
+        }
+        return R_NilValue;
+    }
+
+    const auto& steps = context.steps();
+    size_t n = steps.size();
+    Rcpp::StringVector name(n);
+    Rcpp::NumericVector seconds(n), allocated(n), peak(n), chunk_cache(n), metadata_cache(n);
+    for (size_t i = 0; i < n; ++i) {
+        const auto& s = steps[i];
+        name[i] = s.name;
+        seconds[i] = s.seconds;
+        allocated[i] = s.allocated_bytes;
+        peak[i] = s.peak_bytes;
+        chunk_cache[i] = s.chunk_cache_bytes;
+        metadata_cache[i] = s.metadata_cache_bytes;
+    }
+
+    return Rcpp::List::create(
+        Rcpp::Named("step") = name,
+        Rcpp::Named("seconds") = seconds,
+        Rcpp::Named("allocated") = allocated,
+        Rcpp::Named("peak") = peak,
+        Rcpp::Named("chunk_cache") = chunk_cache,
+        Rcpp::Named("metadata_cache") = metadata_cache,
+        Rcpp::Named("overall_peak") = static_cast<double>(context.peak_bytes())
+    );
 }
@@ -0,0 +1,63 @@
+# Minimal stand-in for an S3-compatible object store, serving the files in a directory as objects.
+# Like a pre-signed URL, HEAD requests are rejected and only ranged GETs are allowed.
+# If a token is supplied, every request must also carry an "Authorization: Bearer <token>" header.
+#
+# usage: python3 s3_standin.py <dir> <info_file> [token]
+# The port and process ID are written to <info_file> once the server is listening.
+
+import http.server
+import os
+import re
+import sys
+
+root = sys.argv[1]
+info = sys.argv[2]
+token = sys.argv[3] if len(sys.argv) > 3 else None
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    def log_message(self, *args):
+        pass
+
+    def reply(self, code, headers={}, body=b""):
+        self.send_response(code)
+        for k, v in headers.items():
+            self.send_header(k, v)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_HEAD(self):
+        self.reply(403)
+
+    def do_GET(self):
+        if token is not None and self.headers.get("Authorization") != "Bearer " + token:
+            self.reply(403)
+            return
+
+        # Objects are addressed as /<bucket>/<key>.
+        path = os.path.join(root, self.path.lstrip("/").split("/", 1)[-1])
+        if not os.path.isfile(path):
+            self.reply(404)
+            return
+
+        size = os.path.getsize(path)
+        m = re.match(r"bytes=(\d+)-(\d+)$", self.headers.get("Range", ""))
+        if not m:
+            self.reply(403)
+            return
+
+        start, end = int(m.group(1)), min(int(m.group(2)), size - 1)
+        if start >= size:
+            self.reply(416, { "Content-Range": "bytes */" + str(size) })
+            return
+
+        with open(path, "rb") as handle:
+            handle.seek(start)
+            body = handle.read(end - start + 1)
+        self.reply(206, { "Content-Range": "bytes %d-%d/%d" % (start, end, size) }, body)
+
+server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+with open(info + ".tmp", "w") as handle:
+    handle.write("%d %d\n" % (server.server_address[1], os.getpid()))
+os.rename(info + ".tmp", info)
+server.serve_forever()